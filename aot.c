@@ -0,0 +1,217 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "aot.h"
+#include "regvm.h"
+#include "parser.h"
+
+char* aot_is_target; /* aot_is_target[loc]: is the op at reg_code[loc] the target of a jump (does it need a label)? */
+
+/* the C operators of the binary register ops (for two ints, the result is an int) */
+const char* c_operator(unsigned char op)
+{
+    switch (op) {
+        case rop_add: case rop_fadd: return "+";
+        case rop_sub: case rop_fsub: return "-";
+        case rop_mul: case rop_fmul: return "*";
+        case rop_div: case rop_fdiv: return "/";
+        case rop_mod: return "%";
+        case rop_shl: return "<<";
+        case rop_and: case rop_iand: return "&&";
+        case rop_or: case rop_ior: return "||";
+        case rop_eq: case rop_ieq: case rop_jeq: return "==";
+        case rop_neq: case rop_ineq: case rop_jne: return "!=";
+        case rop_less: case rop_ilt: case rop_jlt: return "<";
+        case rop_leq: case rop_ile: case rop_jle: return "<=";
+        case rop_greater: case rop_igt: case rop_jgt: return ">";
+        default: return ">="; /* rop_geq, rop_ige, rop_jge */
+    }
+}
+
+/* the index of the procedure that starts at a location */
+int aot_proc_at(unsigned int loc)
+{
+    for (int k = 0; k < num_of_reg_procs; k++) {
+        if (reg_proc_starts[k] == loc) {
+            return k;
+        }
+    }
+    printf("internal error: call to %u, which is not the start of a procedure\n", loc);
+    exit(EXIT_FAILURE);
+}
+
+/* write the C statement of the op at reg_code[loc] */
+void emit_c_op(FILE* out, unsigned int loc)
+{
+    unsigned char op = reg_code[loc];
+    int* arg = reg_code + loc + 1;
+    if (aot_is_target[loc]) {
+        fprintf(out, "L%u:\n", loc);
+    }
+    fprintf(out, "    ");
+    switch (op) {
+        case rop_mov:
+            fprintf(out, "DATA(%i) = DATA(%i);\n", arg[0], arg[1]);
+            break;
+        /* ints wrap around (as they do on the VM) instead of overflowing */
+        case rop_add: case rop_sub: case rop_mul:
+            fprintf(out, "DATA(%i).i = (int) ((unsigned int) DATA(%i).i %s DATA(%i).i);\n", arg[0], arg[1], c_operator(op), arg[2]);
+            break;
+        case rop_shl:
+            fprintf(out, "DATA(%i).i = (int) ((unsigned int) DATA(%i).i << DATA(%i).i);\n", arg[0], arg[1], arg[2]);
+            break;
+        case rop_div:
+            fprintf(out, "if (DATA(%i).i == 0) division_by_zero();\n", arg[2]);
+            fprintf(out, "    DATA(%i).i = DATA(%i).i / DATA(%i).i;\n", arg[0], arg[1], arg[2]);
+            break;
+        case rop_fdiv:
+            fprintf(out, "if (DATA(%i).f == 0) division_by_zero();\n", arg[2]);
+            fprintf(out, "    DATA(%i).f = DATA(%i).f / DATA(%i).f;\n", arg[0], arg[1], arg[2]);
+            break;
+        case rop_mod: case rop_iand: case rop_ior: case rop_ieq: case rop_ineq:
+        case rop_ilt: case rop_ile: case rop_igt: case rop_ige:
+            fprintf(out, "DATA(%i).i = DATA(%i).i %s DATA(%i).i;\n", arg[0], arg[1], c_operator(op), arg[2]);
+            break;
+        case rop_fadd: case rop_fsub: case rop_fmul:
+            fprintf(out, "DATA(%i).f = DATA(%i).f %s DATA(%i).f;\n", arg[0], arg[1], c_operator(op), arg[2]);
+            break;
+        case rop_and: case rop_or: case rop_eq: case rop_neq:
+        case rop_less: case rop_leq: case rop_greater: case rop_geq:
+            fprintf(out, "DATA(%i).i = DATA(%i).f %s DATA(%i).f;\n", arg[0], arg[1], c_operator(op), arg[2]);
+            break;
+        case rop_neg:
+            fprintf(out, "DATA(%i).i = (int) -(unsigned int) DATA(%i).i;\n", arg[0], arg[1]);
+            break;
+        case rop_fneg:
+            fprintf(out, "DATA(%i).f = -DATA(%i).f;\n", arg[0], arg[1]);
+            break;
+        case rop_conv_to_float:
+            fprintf(out, "DATA(%i).f = DATA(%i).i;\n", arg[0], arg[1]);
+            break;
+        case rop_conv_to_int:
+            fprintf(out, "DATA(%i).i = DATA(%i).f;\n", arg[0], arg[1]);
+            break;
+        case rop_load_elem:
+            fprintf(out, "DATA(%i) = DATA(%i + DATA(%i).i * %i);\n", arg[0], arg[2], arg[1], arg[3]);
+            break;
+        case rop_store_elem:
+            fprintf(out, "DATA(%i + DATA(%i).i * %i) = DATA(%i);\n", arg[1], arg[0], arg[2], arg[3]);
+            break;
+        case rop_jmp:
+            fprintf(out, "goto L%i;\n", arg[0]);
+            break;
+        case rop_jtrue: case rop_jfalse:
+            fprintf(out, "if (%sDATA(%i).f) goto L%i;\n", op == rop_jfalse ? "!" : "", arg[0], arg[1]);
+            break;
+        case rop_ijtrue: case rop_ijfalse:
+            fprintf(out, "if (%sDATA(%i).i) goto L%i;\n", op == rop_ijfalse ? "!" : "", arg[0], arg[1]);
+            break;
+        case rop_jlt: case rop_jle: case rop_jgt: case rop_jge: case rop_jeq: case rop_jne:
+            fprintf(out, "if (DATA(%i).i %s DATA(%i).i) goto L%i;\n", arg[0], c_operator(op), arg[1], arg[2]);
+            break;
+        case rop_call:
+            fprintf(out, "CALL(proc_%i);\n", aot_proc_at(arg[0]));
+            break;
+        case rop_return:
+            fprintf(out, "return;\n");
+            break;
+        case rop_save:
+            fprintf(out, "SAVE(%i, %i);\n", arg[0], arg[1]);
+            break;
+        case rop_restore:
+            fprintf(out, "RESTORE(%i, %i);\n", arg[0], arg[1]);
+            break;
+        case rop_clear:
+            fprintf(out, "memset(&DATA(%i), 0, %i);\n", arg[0], arg[1]);
+            break;
+        case rop_printint:
+            fprintf(out, "printf(\"%%i\", DATA(%i).i);\n", arg[0]);
+            break;
+        case rop_printfloat:
+            fprintf(out, "printf(\"%%f\", DATA(%i).f);\n", arg[0]);
+            break;
+        case rop_printchar:
+            fprintf(out, "printf(\"%%c\", DATA(%i).i);\n", arg[0]);
+            break;
+        case rop_println:
+            fprintf(out, "printf(\"\\n\");\n");
+            break;
+        case rop_halt:
+            fprintf(out, "exit(EXIT_SUCCESS);\n");
+            break;
+        default:
+            printf("internal error: unknown register op %i\n", op);
+            exit(EXIT_FAILURE);
+    }
+}
+
+void emit_c(FILE* out)
+{
+    aot_is_target = calloc(reg_code_size + 1, 1);
+    unsigned char* init = calloc(reg_data_size + 4, 1);
+    if (aot_is_target == NULL || init == NULL) {
+        printf("calloc() failed\n");
+        exit(EXIT_FAILURE);
+    }
+    for (unsigned int loc = 0; loc < reg_code_size; loc += rop_size(reg_code[loc])) {
+        unsigned char op = reg_code[loc];
+        if (op == rop_jmp) {
+            aot_is_target[reg_code[loc + 1]] = 1;
+        }
+        else if (op >= rop_jtrue && op <= rop_ijfalse) {
+            aot_is_target[reg_code[loc + 2]] = 1;
+        }
+        else if (op >= rop_jlt && op <= rop_jne) {
+            aot_is_target[reg_code[loc + 3]] = 1;
+        }
+    }
+
+    fprintf(out, "/* translated from %s */\n", sourcefile);
+    fprintf(out, "#include <stdio.h>\n#include <stdlib.h>\n#include <string.h>\n\n");
+    fprintf(out, "#define RETURN_STACK_SIZE %i /* the call depth limit of the VM */\n", RETURN_STACK_SIZE);
+    fprintf(out, "#define SAVE_STACK_SIZE %i\n\n", SAVE_STACK_SIZE);
+    fprintf(out, "typedef union { int i; float f; } slot_t;\n\n");
+    /* the register file: the variables start out as 0, and the constants are stored as ints (their bits) */
+    reg_init_data(init);
+    /* (a program without variables or constants still gets a register, since C has no empty arrays) */
+    fprintf(out, "static slot_t data[%u] = {", reg_data_size == 0 ? 1 : (reg_data_size + 3) / 4);
+    int first = 1;
+    for (unsigned int addr = 0; addr < reg_data_size; addr += 4) {
+        int bits;
+        memcpy(&bits, init + addr, 4);
+        if (bits != 0) {
+            fprintf(out, "%s\n    [%u] = { %i }", first ? "" : ",", addr / 4, bits);
+            first = 0;
+        }
+    }
+    fprintf(out, "%s};\n", first ? " { 0 } " : "\n");
+    fprintf(out, "static int depth; /* number of procedures being called */\n");
+    fprintf(out, "static unsigned char saves[SAVE_STACK_SIZE]; /* the frames saved by recursive calls */\n");
+    fprintf(out, "static int saved;\n\n");
+    fprintf(out, "#define DATA(addr) (*(slot_t*) ((unsigned char*) data + (addr)))\n");
+    fprintf(out, "#define CALL(proc) { if (depth == RETURN_STACK_SIZE) too_many_calls(); depth++; proc(); depth--; }\n");
+    fprintf(out, "#define SAVE(addr, size) { if (saved + (size) > SAVE_STACK_SIZE) frames_too_large(); memcpy(saves + saved, &DATA(addr), size); saved += (size); }\n");
+    fprintf(out, "#define RESTORE(addr, size) { saved -= (size); memcpy(&DATA(addr), saves + saved, size); }\n\n");
+    fprintf(out, "static void too_many_calls(void)\n{\n");
+    fprintf(out, "    printf(\"Error: too many nested calls (call depth limit %%i)\\n\", RETURN_STACK_SIZE);\n    exit(EXIT_FAILURE);\n}\n\n");
+    fprintf(out, "static void frames_too_large(void)\n{\n");
+    fprintf(out, "    printf(\"Error: too many nested calls (their frames take more than %%i bytes)\\n\", SAVE_STACK_SIZE);\n    exit(EXIT_FAILURE);\n}\n\n");
+    fprintf(out, "static void division_by_zero(void)\n{\n");
+    fprintf(out, "    printf(\"Error: division by zero\\n\");\n    exit(EXIT_FAILURE);\n}\n\n");
+    for (int k = 0; k < num_of_reg_procs; k++) {
+        fprintf(out, "static void proc_%i(void); /* %s */\n", k, reg_proc_names[k]);
+    }
+
+    for (int k = 0; k < num_of_reg_procs; k++) {
+        unsigned int start = reg_proc_starts[k];
+        unsigned int end = k + 1 < num_of_reg_procs ? reg_proc_starts[k + 1] : reg_code_size;
+        fprintf(out, "\n/* %s */\nstatic void proc_%i(void)\n{\n", reg_proc_names[k], k);
+        for (unsigned int loc = start; loc < end; loc += rop_size(reg_code[loc])) {
+            emit_c_op(out, loc);
+        }
+        fprintf(out, "}\n");
+    }
+    fprintf(out, "\nint main(void)\n{\n    proc_0();\n    return 0;\n}\n");
+    free(aot_is_target);
+    free(init);
+}
@@ -0,0 +1,25 @@
+#ifndef AOT_H
+#define AOT_H
+
+#include <stdio.h>
+
+/*
+Ahead-of-time backend (--emit-c, --aot): translates the register code (see regvm.h) into a standalone C program,
+which the system's C compiler turns into a native executable that prints exactly what the VM would print
+between BEGINNING OF OUTPUT and END OF OUTPUT.
+
+The C program holds
+    the register file  as a static array, with the constants already in place;
+    each procedure     as a function (the code that runs first is proc_0(), called by main()),
+                       and each register op as a C statement on fixed addresses of the register file, e.g.
+                           add  @x, @y, @K1       ->    DATA(0).i = (int) ((unsigned int) DATA(4).i + DATA(12).i);
+    the jump targets   as labels (L<location in the register code>).
+A call is a C call, guarded by a count of the procedures being called so that a runaway recursion fails
+like it does on the VM (after RETURN_STACK_SIZE nested calls, the same limit as the VM's); a recursive call saves
+the frame of the caller on a save stack of its own, as the VM does. The translated procedures keep nothing in their
+C frames, which take a few dozen bytes, so the usual 8MB C stack holds as many nested calls as the limit allows.
+*/
+
+void emit_c(FILE*); /* write the C program translated from the register code */
+
+#endif
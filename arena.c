@@ -0,0 +1,83 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+
+#define ARENA_ALIGN 8 /* enough for pointers, ints, floats and doubles */
+
+void arena_init(Arena* arena, size_t block_size)
+{
+    arena->head = NULL;
+    arena->spare = NULL;
+    arena->block_size = block_size;
+}
+
+void* arena_alloc(Arena* arena, size_t size)
+{
+    size = (size + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1);
+    ArenaBlock* block = arena->head;
+    if (block == NULL || block->size - block->used < size) {
+        if (arena->spare != NULL && arena->spare->size >= size) {
+            /* a block that was released */
+            block = arena->spare;
+            arena->spare = block->next;
+        }
+        else {
+            size_t block_size = size > arena->block_size ? size : arena->block_size;
+            block = malloc(sizeof (ArenaBlock) + block_size);
+            if (block == NULL) {
+                printf("malloc() failed for arena\n");
+                exit(EXIT_FAILURE);
+            }
+            block->size = block_size;
+        }
+        block->next = arena->head;
+        block->used = 0;
+        arena->head = block;
+    }
+    void* p = block->data + block->used;
+    block->used += size;
+    memset(p, 0, size);
+    return p;
+}
+
+ArenaMark arena_mark(Arena* arena)
+{
+    return (ArenaMark) {arena->head, arena->head == NULL ? 0 : arena->head->used};
+}
+
+void arena_release(Arena* arena, ArenaMark mark)
+{
+    /* the blocks started since the mark are spare */
+    while (arena->head != mark.block) {
+        ArenaBlock* block = arena->head;
+        arena->head = block->next;
+        block->next = arena->spare;
+        arena->spare = block;
+    }
+    if (mark.block != NULL) {
+        mark.block->used = mark.used;
+    }
+}
+
+void arena_reset(Arena* arena)
+{
+    arena_release(arena, (ArenaMark) {NULL, 0});
+}
+
+void free_blocks(ArenaBlock* block)
+{
+    while (block != NULL) {
+        ArenaBlock* next = block->next;
+        free(block);
+        block = next;
+    }
+}
+
+void arena_free(Arena* arena)
+{
+    free_blocks(arena->head);
+    free_blocks(arena->spare);
+    arena->head = NULL;
+    arena->spare = NULL;
+}
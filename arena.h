@@ -0,0 +1,48 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/*
+An arena (region) allocator: memory is handed out by bumping a pointer through large blocks,
+and everything allocated from an arena is freed at once.
+The compiler allocates all of its data from arenas:
+    * the nodes of the syntax tree and the intermediate representation (ast_arena), which all live until
+      the code has been generated,
+    * the nodes of the symbol table (symtab_arena), a region for each scope, released when the scope is closed,
+    * the text of the interned names (name_arena), which lives until the next compilation.
+Releasing memory (to a mark, or all of it with arena_reset()) keeps the blocks for the allocations that follow,
+so once the arenas are as large as the compilation needs, compiling again doesn't call malloc() or free() at all.
+*/
+
+typedef struct ArenaBlock ArenaBlock;
+typedef struct Arena Arena;
+typedef struct ArenaMark ArenaMark;
+
+struct ArenaBlock {
+    ArenaBlock* next; /* the block allocated before this one (or the next spare block) */
+    size_t size;      /* number of bytes in data */
+    size_t used;      /* number of bytes handed out */
+    char data[];
+};
+
+struct Arena {
+    ArenaBlock* head;  /* the block currently being allocated from */
+    ArenaBlock* spare; /* the blocks released, to be used again */
+    size_t block_size; /* size of each new block (larger requests get a block of their own) */
+};
+
+/* the state of an arena at some point: releasing to it frees what was allocated since */
+struct ArenaMark {
+    ArenaBlock* block;
+    size_t used;
+};
+
+void arena_init(Arena*, size_t); /* start an empty arena that allocates blocks of (at least) the given size */
+void* arena_alloc(Arena*, size_t); /* allocate zero-filled memory (8-byte aligned) */
+ArenaMark arena_mark(Arena*); /* the current state of the arena */
+void arena_release(Arena*, ArenaMark); /* free everything allocated since the mark (keeping the blocks) */
+void arena_reset(Arena*); /* free everything allocated from the arena (keeping the blocks) */
+void arena_free(Arena*); /* free everything allocated from the arena, and its blocks (it can then be used again) */
+
+#endif
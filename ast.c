@@ -0,0 +1,219 @@
+#include <limits.h>
+#include "ast.h"
+
+Arena ast_arena = {NULL, NULL, 1 << 16};
+
+int is_integral(Type t)
+{
+    return t == TK_INT || t == TK_CHAR;
+}
+
+Expr* new_expr(char kind, Type type)
+{
+    Expr* e = arena_alloc(&ast_arena, sizeof (Expr));
+    e->kind = kind;
+    e->type = type;
+    return e;
+}
+
+Expr* ast_const_int(int i, Type type)
+{
+    Expr* e = new_expr(EX_CONST, type);
+    e->value.i = i;
+    return e;
+}
+
+Expr* ast_const_float(float f)
+{
+    Expr* e = new_expr(EX_CONST, TK_REAL);
+    e->value.f = f;
+    return e;
+}
+
+Expr* ast_var(int addr, int local, Type type)
+{
+    Expr* e = new_expr(EX_VAR, type);
+    e->addr = addr;
+    e->local = local;
+    return e;
+}
+
+Expr* ast_elem(int addr, int local, int elt_size, Expr* index, Type elt_type)
+{
+    if (index->kind == EX_CONST) {
+        /* the address of the element is known (or its offset in the frame) */
+        return ast_var(addr + index->value.i * elt_size, local, elt_type);
+    }
+    Expr* e = new_expr(EX_ELEM, elt_type);
+    e->addr = addr;
+    e->local = local;
+    e->elt_size = elt_size;
+    e->left = index;
+    return e;
+}
+
+Expr* ast_unary(Type op, Expr* operand)
+{
+    if (operand->kind == EX_CONST) {
+        /* negate the constant instead (ints wrap around, like neg does) */
+        if (operand->type == TK_REAL) {
+            return ast_const_float(-operand->value.f);
+        }
+        return ast_const_int((int) (0u - (unsigned int) operand->value.i), operand->type);
+    }
+    Expr* e = new_expr(EX_UNARY, operand->type);
+    e->op = op;
+    e->left = operand;
+    return e;
+}
+
+Expr* ast_conv(Expr* operand, Type type)
+{
+    if (is_integral(operand->type) == is_integral(type)) {
+        return operand;
+    }
+    if (operand->kind == EX_CONST) {
+        if (type == TK_REAL) {
+            return ast_const_float(operand->value.i);
+        }
+        /* (only if it fits, since converting a float that doesn't is undefined) */
+        if (operand->value.f > (float) INT_MIN && operand->value.f < (float) INT_MAX) {
+            return ast_const_int(operand->value.f, TK_INT);
+        }
+    }
+    Expr* e = new_expr(EX_CONV, type);
+    e->left = operand;
+    return e;
+}
+
+/* the expression with the type of a result (e.g., a char operand of + that is the result of the +, which is an int) */
+Expr* with_type(Expr* e, Type type)
+{
+    if (e->type == type) {
+        return e;
+    }
+    Expr* copy = new_expr(e->kind, type);
+    *copy = *e;
+    copy->type = type;
+    return copy;
+}
+
+/* the k for which n = 2^k, or -1 if n is not a power of 2 (greater than 1) */
+int log2_exact(int n)
+{
+    if (n <= 1 || (n & (n - 1)) != 0) {
+        return -1;
+    }
+    int k = 0;
+    while (n > 1) {
+        n >>= 1;
+        k++;
+    }
+    return k;
+}
+
+/* Return the constant result of left op right, or NULL if it is better left to run time
+(division by zero, and INT_MIN / -1, which overflows). */
+Expr* fold_constants(Type op, Type type, Expr* left, Expr* right)
+{
+    int ints = is_integral(left->type);
+    /* ints wrap around like the ops do (by computing with unsigned ints) */
+    unsigned int a = left->value.i, b = right->value.i;
+    float x = left->value.f, y = right->value.f;
+    int i;
+    if (op == TK_PLUS) {
+        return ints ? ast_const_int(a + b, type) : ast_const_float(x + y);
+    }
+    else if (op == TK_MINUS) {
+        return ints ? ast_const_int(a - b, type) : ast_const_float(x - y);
+    }
+    else if (op == TK_MULT) {
+        return ints ? ast_const_int(a * b, type) : ast_const_float(x * y);
+    }
+    else if (op == TK_DIV || op == TK_MOD) {
+        if (ints ? b == 0 || ((int) a == INT_MIN && (int) b == -1) : y == 0) {
+            return NULL;
+        }
+        if (op == TK_MOD) {
+            return ast_const_int((int) a % (int) b, type);
+        }
+        return ints ? ast_const_int((int) a / (int) b, type) : ast_const_float(x / y);
+    }
+    else if (op == TK_LEFTSHIFT) {
+        return ast_const_int(a << b, type);
+    }
+    else if (op == TK_OR) {
+        i = ints ? a || b : x || y;
+    }
+    else if (op == TK_AND) {
+        i = ints ? a && b : x && y;
+    }
+    else if (op == TK_EQ) {
+        i = ints ? a == b : x == y;
+    }
+    else if (op == TK_NEQ) {
+        i = ints ? a != b : x != y;
+    }
+    else if (op == TK_LESS) {
+        i = ints ? (int) a < (int) b : x < y;
+    }
+    else if (op == TK_LESS_EQ) {
+        i = ints ? (int) a <= (int) b : x <= y;
+    }
+    else if (op == TK_GREATER) {
+        i = ints ? (int) a > (int) b : x > y;
+    }
+    else {
+        i = ints ? (int) a >= (int) b : x >= y;
+    }
+    return ast_const_int(i, TK_INT);
+}
+
+/* is e the constant c? */
+int is_const(Expr* e, int c)
+{
+    if (e->kind != EX_CONST) {
+        return 0;
+    }
+    return is_integral(e->type) ? e->value.i == c : e->value.f == c;
+}
+
+Expr* ast_binary(Type op, Type type, Expr* left, Expr* right)
+{
+    if (left->kind == EX_CONST && right->kind == EX_CONST) {
+        Expr* folded = fold_constants(op, type, left, right);
+        if (folded != NULL) {
+            return folded;
+        }
+    }
+    int ints = is_integral(left->type);
+    /* x + 0, 0 + x, x - 0 (for floats, x + 0 is not always x: -0.0 + 0 is 0.0), x * 1, 1 * x, x / 1 */
+    if ((ints && (op == TK_PLUS || op == TK_MINUS) && is_const(right, 0)) || ((op == TK_MULT || op == TK_DIV) && is_const(right, 1))) {
+        return with_type(left, type);
+    }
+    if ((ints && op == TK_PLUS && is_const(left, 0)) || (op == TK_MULT && is_const(left, 1))) {
+        return with_type(right, type);
+    }
+    /* x * 2^k, 2^k * x  =>  x << k (for ints) */
+    if (ints && op == TK_MULT) {
+        if (right->kind == EX_CONST && log2_exact(right->value.i) > 0) {
+            return ast_binary(TK_LEFTSHIFT, type, left, ast_const_int(log2_exact(right->value.i), TK_INT));
+        }
+        if (left->kind == EX_CONST && log2_exact(left->value.i) > 0) {
+            return ast_binary(TK_LEFTSHIFT, type, right, ast_const_int(log2_exact(left->value.i), TK_INT));
+        }
+    }
+    Expr* e = new_expr(EX_BINARY, type);
+    e->op = op;
+    e->left = left;
+    e->right = right;
+    return e;
+}
+
+Stmt* ast_stmt(char kind, int line)
+{
+    Stmt* s = arena_alloc(&ast_arena, sizeof (Stmt));
+    s->kind = kind;
+    s->line = line;
+    return s;
+}
@@ -0,0 +1,119 @@
+#ifndef AST_H
+#define AST_H
+
+#include "tokenizer.h"
+#include "symtab.h"
+#include "arena.h"
+
+/*
+Syntax tree built by the parser (see parser.h) and lowered to the intermediate representation (see ir.h).
+
+The parser has already checked the types: every expression knows its type (TK_INT, TK_CHAR or TK_REAL),
+the operands of a binary operator have been converted to a common type with EX_CONV nodes (as combine() requires),
+and so have the values assigned to variables and passed to procedures.
+Global variables are known by their address in the data array; the params and locals of a procedure
+(and its hidden switch variables) are local: known by their offset in the procedure's frame, which is created
+for each call (see codegen.h).
+
+All nodes are allocated from ast_arena, and are freed all at once after the code has been generated
+(the arena keeps its blocks for the next compilation).
+
+Constant subtrees are folded as the tree is built (see ast_binary()), e.g. (1 + 2) * -5 is a single
+constant -15, and so are identities such as x * 1 and x + 0; a constant index into an array is turned into
+a plain variable at the address of the element.
+*/
+
+// TokenTypes:  TK_ID, TK_INT, TK_REAL, TK_STR, TK_CHAR, TK_ARR, TK_FUNC,
+typedef TokenType Type;
+
+typedef struct Expr Expr;
+typedef struct Stmt Stmt;
+typedef struct Proc Proc;
+typedef struct Program Program;
+
+enum {
+    EX_CONST,  /* value */
+    EX_VAR,    /* the variable at addr */
+    EX_ELEM,   /* the element left (the index) of the array at addr, with elements of elt_size bytes */
+    EX_UNARY,  /* op left, where op is TK_MINUS */
+    EX_BINARY, /* left op right, where op is one of + - * / % || && == != < <= > >= or << (for multiplying by 2^k) */
+    EX_CONV,   /* left converted to type */
+};
+
+struct Expr {
+    char kind;        /* EX_* */
+    Type type;        /* TK_INT, TK_CHAR or TK_REAL */
+    Type op;          /* the operator (EX_UNARY, EX_BINARY) */
+    union {
+        int i;
+        float f;
+    } value;          /* EX_CONST */
+    int addr;         /* EX_VAR, EX_ELEM */
+    char local;       /* EX_VAR, EX_ELEM: is addr an offset in the frame (rather than an address in the data array)? */
+    int elt_size;     /* EX_ELEM */
+    Expr* left;
+    Expr* right;
+};
+
+enum {
+    ST_BLOCK,     /* body, a list of statements (linked through next) */
+    ST_ASSIGN,    /* target = expr, where target is an EX_VAR or EX_ELEM (expr already has the type of target) */
+    ST_IF,        /* if (expr) body else else_body (else_body may be NULL) */
+    ST_WHILE,     /* while (expr) body */
+    ST_DO,        /* do body while (expr) */
+    ST_SWITCH,    /* switch (expr) body, where body is a list of ST_CASE and ST_DEFAULT;
+                     the value of expr is kept in the (hidden) local int variable at offset addr of the frame */
+    ST_CASE,      /* case expr: body (if it matches, run body and leave the switch) */
+    ST_DEFAULT,   /* default: body */
+    ST_CALL,      /* call proc with args (already converted to the types of the parameters) */
+    ST_RETURN,
+    ST_PRINT,     /* print expr */
+    ST_PRINT_STR, /* print str */
+};
+
+struct Stmt {
+    char kind;        /* ST_* */
+    int line;
+    Expr* target;
+    Expr* expr;
+    Stmt* body;
+    Stmt* else_body;
+    int addr;
+    Proc* proc;
+    Expr** args;
+    int num_of_args;
+    const char* str;
+    Stmt* next;       /* the next statement in a list */
+};
+
+struct Proc {
+    Node* entry;      /* the procedure's entry in the symbol table */
+    int num_of_params;
+    Type param_types[12];
+    int param_addrs[12]; /* their offsets in the frame */
+    int frame_size;   /* number of bytes of the frame: the params, then the locals */
+    Stmt* body;       /* an ST_BLOCK */
+    Proc* next;       /* the next procedure in the program */
+};
+
+struct Program {
+    Stmt* init;       /* the initializers of the global variables, in order (an ST_BLOCK) */
+    Proc* procs;      /* the procedures, in order of definition */
+    Proc* main;
+};
+
+extern Arena ast_arena;
+
+/* constructors (the nodes are allocated from ast_arena) */
+Expr* ast_const_int(int, Type);
+Expr* ast_const_float(float);
+Expr* ast_var(int, int, Type); /* address (or offset in the frame), local?, type */
+Expr* ast_elem(int, int, int, Expr*, Type); /* address of the array (or offset in the frame), local?, elt size, index, elt type */
+Expr* ast_unary(Type, Expr*); /* folds constants */
+Expr* ast_conv(Expr*, Type); /* converts an expression to a type (returns it as it is if no conversion is needed) */
+Expr* ast_binary(Type, Type, Expr*, Expr*); /* given the operator and the type of the result; folds constants and identities */
+Stmt* ast_stmt(char, int); /* a statement of a given kind at a given line, with all of its fields empty */
+
+int is_integral(Type); /* is the type int or char (i.e., held as an int)? */
+
+#endif
@@ -0,0 +1,20 @@
+#!/bin/sh
+# Compare the VM's engines on the programs in the test folder:
+# the time per run of each engine, and the number of ops executed by the stack VM and by the register VM.
+# usage: bench/bench.sh [runs per program]   (run from the directory that contains the project)
+
+RUNS=${1:-2000}
+gcc -O2 -o bench/vm vm.c stack.c symtab.c tokenizer.c lexscan.c intern.c parser.c ast.c ir.c codegen.c regvm.c jit.c aot.c image.c cache.c output.c arena.c optimizer.c || exit 1
+
+printf "%-24s %14s %14s %14s %14s %12s %12s\n" "program" "switch (us)" "threaded (us)" "register (us)" "jit (us)" "stack ops" "reg ops"
+for f in test/*.c; do
+    case $f in test/error_*) continue ;; esac
+    sw=$(./bench/vm --engine=switch --repeat=$RUNS --time $f 2>&1 >/dev/null | sed 's/.*(\(.*\) us per run)/\1/')
+    th=$(./bench/vm --engine=threaded --repeat=$RUNS --time $f 2>&1 >/dev/null | sed 's/.*(\(.*\) us per run)/\1/')
+    rg=$(./bench/vm --engine=register --repeat=$RUNS --time $f 2>&1 >/dev/null | sed 's/.*(\(.*\) us per run)/\1/')
+    jt=$(./bench/vm --jit --repeat=$RUNS --time $f 2>&1 >/dev/null | sed 's/.*(\(.*\) us per run)/\1/')
+    so=$(./bench/vm --engine=switch --profile $f 2>&1 >/dev/null | sed -n 's/^\([0-9]*\) ops executed.*/\1/p')
+    ro=$(./bench/vm --engine=register --profile $f 2>&1 >/dev/null | sed -n 's/^\([0-9]*\) ops executed.*/\1/p')
+    printf "%-24s %14s %14s %14s %14s %12s %12s\n" "$f" "$sw" "$th" "$rg" "$jt" "$so" "$ro"
+done
+rm -f bench/vm
@@ -0,0 +1,81 @@
+/*
+Micro-benchmark of the VM's number formatting (format_int() and format_float() in output.c) against snprintf(),
+on the same values, after checking that both give the same text for each of them.
+usage (from the directory that contains the project):
+    gcc -O2 -I. bench/format_bench.c output.c -o bench/format_bench && ./bench/format_bench [values]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "output.h"
+
+double now(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+int main(int argc, char* argv[])
+{
+    int n = argc > 1 ? atoi(argv[1]) : 1000000;
+    int* ints = malloc(n * sizeof (int));
+    float* floats = malloc(n * sizeof (float));
+    if (ints == NULL || floats == NULL) {
+        printf("malloc() failed\n");
+        exit(EXIT_FAILURE);
+    }
+    /* values like the ones programs print: small and large ints, and floats of all magnitudes */
+    srand(1);
+    for (int i = 0; i < n; i++) {
+        int r = rand();
+        ints[i] = i % 4 == 0 ? r : i % 4 == 1 ? -r : r % 1000;
+        floats[i] = i % 3 == 0 ? (float) r / 1000 : i % 3 == 1 ? (float) r / RAND_MAX : -(float) r * 1000;
+    }
+
+    char a[OUTPUT_FLOAT_MAX + 1], b[OUTPUT_FLOAT_MAX + 1];
+    for (int i = 0; i < n; i++) {
+        a[format_int(a, ints[i])] = '\0';
+        snprintf(b, sizeof b, "%i", ints[i]);
+        if (strcmp(a, b) != 0) {
+            printf("Error: format_int(%i) gives %s\n", ints[i], a);
+            exit(EXIT_FAILURE);
+        }
+        a[format_float(a, floats[i])] = '\0';
+        snprintf(b, sizeof b, "%f", floats[i]);
+        if (strcmp(a, b) != 0) {
+            printf("Error: format_float(%s) gives %s\n", b, a);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    /* the lengths are summed up so that the calls can't be optimized away */
+    long total = 0;
+    double t0 = now();
+    for (int i = 0; i < n; i++) {
+        total += snprintf(a, sizeof a, "%i", ints[i]);
+    }
+    double t1 = now();
+    for (int i = 0; i < n; i++) {
+        total += format_int(a, ints[i]);
+    }
+    double t2 = now();
+    for (int i = 0; i < n; i++) {
+        total += snprintf(a, sizeof a, "%f", floats[i]);
+    }
+    double t3 = now();
+    for (int i = 0; i < n; i++) {
+        total += format_float(a, floats[i]);
+    }
+    double t4 = now();
+
+    printf("%i values (%ld chars)\n", n, total);
+    printf("%-8s %14s %14s %9s\n", "", "snprintf (ns)", "format (ns)", "speedup");
+    printf("%-8s %14.1f %14.1f %8.1fx\n", "%i", (t1 - t0) / n, (t2 - t1) / n, (t1 - t0) / (t2 - t1));
+    printf("%-8s %14.1f %14.1f %8.1fx\n", "%f", (t3 - t2) / n, (t4 - t3) / n, (t3 - t2) / (t4 - t3));
+    free(ints);
+    free(floats);
+    return 0;
+}
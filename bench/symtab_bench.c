@@ -0,0 +1,248 @@
+/*
+Micro-benchmark of the symbol table (symtab.c) against the one it replaced (a stack of tables, one per scope,
+with 27 buckets by first letter and a strcmp() chain in each), on the same declarations and lookups,
+after checking that both find the same declaration for each lookup.
+The workload is like a large program: globals, then procedures with nested blocks that declare locals (which
+shadow some of the globals), and lookups of locals of every open scope and of globals. The names are v0, v1...,
+so they all have the same first letter.
+usage (from the directory that contains the project):
+    gcc -O2 -I. bench/symtab_bench.c symtab.c intern.c arena.c -o bench/symtab_bench && ./bench/symtab_bench [globals] [locals] [depth]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "symtab.h"
+#include "intern.h"
+
+#define OLD_TABLE_SIZE 27
+#define OLD_STACK_SIZE 100
+
+typedef struct OldNode OldNode;
+
+struct OldNode {
+    const char* name;
+    int scope;
+    OldNode* next;
+};
+
+OldNode** old_tables[OLD_STACK_SIZE];
+int old_top = -1;
+
+int old_h(const char* name)
+{
+    return name[0] == '_' ? 26 : name[0] - 'a';
+}
+
+void old_push(void)
+{
+    if (old_top + 1 >= OLD_STACK_SIZE) {
+        printf("Too many symbol tables on the symbol table stack (max: 100)\n");
+        exit(EXIT_FAILURE);
+    }
+    old_tables[++old_top] = calloc(OLD_TABLE_SIZE, sizeof (OldNode*));
+    if (old_tables[old_top] == NULL) {
+        printf("calloc() failed\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+void old_pop(void)
+{
+    OldNode** table = old_tables[old_top--];
+    for (int i = 0; i < OLD_TABLE_SIZE; i++) {
+        OldNode* node = table[i];
+        while (node != NULL) {
+            OldNode* next = node->next;
+            free(node);
+            node = next;
+        }
+    }
+    free(table);
+}
+
+OldNode* old_search_table(OldNode** table, const char* name)
+{
+    for (OldNode* node = table[old_h(name)]; node != NULL; node = node->next) {
+        if (strcmp(node->name, name) == 0) {
+            return node;
+        }
+    }
+    return NULL;
+}
+
+OldNode* old_search(const char* name)
+{
+    OldNode* node = NULL;
+    for (int i = old_top; i >= 0 && node == NULL; i--) {
+        node = old_search_table(old_tables[i], name);
+    }
+    return node;
+}
+
+void old_install(const char* name)
+{
+    OldNode** table = old_tables[old_top];
+    if (old_search_table(table, name) != NULL) {
+        printf("Error: '%s' already declared\n", name);
+        exit(EXIT_FAILURE);
+    }
+    OldNode* node = malloc(sizeof (OldNode));
+    if (node == NULL) {
+        printf("malloc() failed\n");
+        exit(EXIT_FAILURE);
+    }
+    node->name = name;
+    node->scope = old_top;
+    node->next = table[old_h(name)];
+    table[old_h(name)] = node;
+}
+
+double now(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+int globals, locals, depth, procs;
+unsigned int* ids;  /* ids[i]: the interned name of vi */
+long num_of_lookups;
+
+/* the name looked up: a local of one of the open scopes (1 to d), or a global (or a local that shadows it) */
+int name_to_look_up(int d, int k)
+{
+    int scope = k % (d + 1);
+    return scope == 0 ? (k * 7919) % globals : globals + (scope - 1) * locals + locals / 8 + (k * 31) % (locals - locals / 8);
+}
+
+/* the workload, run with the new table (check: compare each lookup with the old table, which runs alongside) */
+long run_new(int check)
+{
+    long total = 0;
+    push_scope();
+    if (check) {
+        old_push();
+    }
+    for (int i = 0; i < globals; i++) {
+        install_id(ids[i]);
+        if (check) {
+            old_install(name_of(ids[i]));
+        }
+    }
+    for (int p = 0; p < procs; p++) {
+        for (int d = 1; d <= depth; d++) {
+            push_scope();
+            if (check) {
+                old_push();
+            }
+            /* the first locals of each scope shadow globals */
+            for (int i = 0; i < locals; i++) {
+                int v = i < locals / 8 ? (p * locals + i) % globals : globals + (d - 1) * locals + i;
+                install_id(ids[v]);
+                if (check) {
+                    old_install(name_of(ids[v]));
+                }
+            }
+            for (int k = 0; k < 4 * locals; k++) {
+                int v = name_to_look_up(d, k);
+                Node* node = search_id(ids[v]);
+                total += node->scope;
+                if (check && (node->scope != old_search(name_of(ids[v]))->scope || node->id != ids[v])) {
+                    printf("Error: the lookup of %s gives scope %i (instead of %i)\n", name_of(ids[v]), node->scope,
+                        old_search(name_of(ids[v]))->scope);
+                    exit(EXIT_FAILURE);
+                }
+            }
+        }
+        for (int d = depth; d >= 1; d--) {
+            pop_scope();
+            if (check) {
+                old_pop();
+            }
+        }
+    }
+    pop_scope();
+    if (check) {
+        old_pop();
+    }
+    return total;
+}
+
+long run_old(void)
+{
+    long total = 0;
+    old_push();
+    for (int i = 0; i < globals; i++) {
+        old_install(name_of(ids[i]));
+    }
+    for (int p = 0; p < procs; p++) {
+        for (int d = 1; d <= depth; d++) {
+            old_push();
+            for (int i = 0; i < locals; i++) {
+                int v = i < locals / 8 ? (p * locals + i) % globals : globals + (d - 1) * locals + i;
+                old_install(name_of(ids[v]));
+            }
+            for (int k = 0; k < 4 * locals; k++) {
+                total += old_search(name_of(ids[name_to_look_up(d, k)]))->scope;
+            }
+        }
+        for (int d = depth; d >= 1; d--) {
+            old_pop();
+        }
+    }
+    old_pop();
+    return total;
+}
+
+int main(int argc, char* argv[])
+{
+    globals = argc > 1 ? atoi(argv[1]) : 2000;
+    locals = argc > 2 ? atoi(argv[2]) : 200;
+    depth = argc > 3 ? atoi(argv[3]) : 6;
+    procs = 100;
+    if (globals < 1 || locals < 8 || depth < 1 || depth >= OLD_STACK_SIZE) {
+        printf("usage: symtab_bench [globals (>= 1)] [locals (>= 8)] [depth (1 to 99)]\n");
+        exit(EXIT_FAILURE);
+    }
+    int n = globals + depth * locals;
+    ids = malloc(n * sizeof (unsigned int));
+    if (ids == NULL) {
+        printf("malloc() failed\n");
+        exit(EXIT_FAILURE);
+    }
+    char name[16];
+    for (int i = 0; i < n; i++) {
+        ids[i] = intern(name, sprintf(name, "v%i", i));
+    }
+    num_of_lookups = (long) procs * depth * 4 * locals;
+
+    /*
+    The globals are declared in a scope of their own, closed at the end of each run, so the runs start from
+    empty tables (and the scopes are numbered alike in both: 0 is left empty).
+    First check the new table against the old one.
+    */
+    symtab_init();
+    old_push();
+    run_new(1);
+
+    /* the scopes found are summed up so that the lookups can't be optimized away */
+    double t0 = now();
+    long old_total = run_old();
+    double t1 = now();
+    long new_total = run_new(0);
+    double t2 = now();
+    old_pop();
+    if (old_total != new_total) {
+        printf("Error: the totals differ (%ld, %ld)\n", old_total, new_total);
+        exit(EXIT_FAILURE);
+    }
+
+    printf("%i names, %i procedures of %i nested scopes of %i locals, %ld lookups\n",
+        n, procs, depth, locals, num_of_lookups);
+    printf("%-12s %14s %14s %9s\n", "", "old (ms)", "new (ms)", "speedup");
+    printf("%-12s %14.1f %14.1f %8.1fx\n", "all", (t1 - t0) / 1e6, (t2 - t1) / 1e6, (t1 - t0) / (t2 - t1));
+    free(ids);
+    return 0;
+}
@@ -0,0 +1,123 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cache.h"
+#include "image.h"
+#include "optimizer.h"
+#include "codegen.h"
+#include "tokenizer.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/stat.h>
+#include <unistd.h>
+#define CACHE_POSIX
+#endif
+
+unsigned long long cache_key(void)
+{
+    int version[2] = {IMAGE_VERSION, CODEGEN_VERSION};
+    int options = use_peephole | use_superinstructions << 1;
+    unsigned long long hash = FNV_OFFSET;
+    read_all(); /* (a streamed source has to be read to its end first) */
+    hash = fnv1a(hash, buf, buf_size);
+    hash = fnv1a(hash, version, sizeof version);
+    hash = fnv1a(hash, &options, sizeof options);
+    return hash != 0 ? hash : 1; /* (0 is the key of images that aren't in a cache) */
+}
+
+/* the path of a file in a cache directory (to be freed) */
+char* cache_path(const char* dir, const char* name)
+{
+    char* path = malloc(strlen(dir) + strlen(name) + 2);
+    if (path == NULL) {
+        printf("malloc() failed\n");
+        exit(EXIT_FAILURE);
+    }
+    sprintf(path, "%s/%s", dir, name);
+    return path;
+}
+
+/* the counts of a cache directory: the hits and the misses so far (0 and 0 if there are none yet) */
+void read_counts(const char* dir, unsigned long long counts[2])
+{
+    char* path = cache_path(dir, "stats");
+    FILE* f = fopen(path, "rb");
+    counts[0] = counts[1] = 0;
+    if (f != NULL) {
+        if (fread(counts, sizeof (unsigned long long), 2, f) != 2) {
+            counts[0] = counts[1] = 0; /* (not a record of counts: start again) */
+        }
+        fclose(f);
+    }
+    free(path);
+}
+
+/* count a hit (1) or a miss (0): rewrite the record of counts, through a temporary file like the entries */
+void cache_count(const char* dir, int hit)
+{
+    unsigned long long counts[2];
+    read_counts(dir, counts);
+    counts[hit ? 0 : 1]++;
+    char name[64];
+#ifdef CACHE_POSIX
+    sprintf(name, "stats.%ld.tmp", (long) getpid());
+#else
+    sprintf(name, "stats.tmp");
+#endif
+    char* temp = cache_path(dir, name);
+    char* path = cache_path(dir, "stats");
+    FILE* f = fopen(temp, "wb");
+    int ok = f != NULL && fwrite(counts, sizeof (unsigned long long), 2, f) == 2;
+    ok = f != NULL && fclose(f) == 0 && ok;
+    if (!ok || rename(temp, path) != 0) {
+        fprintf(stderr, "cache: can't count in %s\n", path);
+        remove(temp);
+    }
+    free(temp);
+    free(path);
+}
+
+int cache_lookup(const char* dir, unsigned long long key)
+{
+    char name[32];
+    sprintf(name, "%016llx.img", key);
+    char* path = cache_path(dir, name);
+#ifdef CACHE_POSIX
+    mkdir(dir, 0777); /* (it may exist already) */
+#endif
+    int loaded = map_image(path);
+    if (loaded == 1 && image_key != key) {
+        unload_image();
+        loaded = 0;
+    }
+    free(path);
+    cache_count(dir, loaded == 1);
+    return loaded == 1;
+}
+
+void cache_store(const char* dir, unsigned long long key)
+{
+    char name[64];
+    sprintf(name, "%016llx.img", key);
+    char* path = cache_path(dir, name);
+    /* a temporary file of this process, so that no other process writes to it at the same time */
+#ifdef CACHE_POSIX
+    sprintf(name, "%016llx.%ld.tmp", key, (long) getpid());
+#else
+    sprintf(name, "%016llx.tmp", key);
+#endif
+    char* temp = cache_path(dir, name);
+    if (!write_image(temp, key) || rename(temp, path) != 0) {
+        fprintf(stderr, "cache: can't write %s\n", path);
+        remove(temp);
+    }
+    free(path);
+    free(temp);
+}
+
+void cache_print_stats(const char* dir)
+{
+    unsigned long long counts[2];
+    read_counts(dir, counts);
+    fprintf(stderr, "cache: %llu hits, %llu misses in %s\n", counts[0], counts[1], dir);
+}
@@ -0,0 +1,34 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+/*
+Compile cache (--cache=<dir>): the images (see image.h) of the programs compiled so far, kept in a directory
+and looked up by the contents of the source, so that running the same program again skips the tokenizer,
+the parser, the IR and the backends altogether.
+
+The key of a program is a 64-bit hash (FNV-1a) of the source read by read_file(), of the version of the compiler
+(IMAGE_VERSION and CODEGEN_VERSION, see codegen.h) and of the options that change the code generated
+(--no-peephole, --no-super). Its image is <dir>/<key>.img.
+    + An entry that can't be loaded (truncated, corrupt, i.e. its checksum doesn't match, written by another
+      version...) or whose image has another key is a miss: the program is compiled and the entry replaced.
+    + An entry is written to a temporary file, which is then renamed to its name. A rename is atomic, so
+      processes that compile the same program at the same time never see a partly written entry
+      (the last one to finish wins, and every one of them writes the same image anyway).
+    + The hits and misses so far are counted in <dir>/stats, a record of two 64-bit counts. Every lookup
+      rewrites it like an entry (through a temporary file and a rename), so it never grows and is never
+      seen partly written; lookups at the same time may lose a count, though (the last rename wins).
+*/
+
+/* the key of the source read by read_file() */
+unsigned long long cache_key(void);
+
+/* load the image of a key from a cache directory (and count a hit) and return 1, or count a miss and return 0 */
+int cache_lookup(const char*, unsigned long long);
+
+/* store the image of the program just compiled under a key (a cache that can't be written is only reported) */
+void cache_store(const char*, unsigned long long);
+
+/* print the counts of hits and misses of a cache directory so far (on stderr) */
+void cache_print_stats(const char*);
+
+#endif
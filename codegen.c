@@ -0,0 +1,412 @@
+#include "codegen.h"
+
+int* code;                 /* code array */
+int* stack_need;           /* stack growth of each straight-line run of code (see codegen.h) */
+unsigned int entry_point;  /* where the code that runs first starts */
+LineEntry* line_table;     /* source lines of the code (see codegen.h) */
+int num_of_lines = 0;
+int line_table_capacity = 0;
+
+const char* op_names[NUM_OPS] = {
+    "push", "fpush", "pushi", "fpushi", "pop", "fpop",
+    "neg", "fneg", "dup", "exch", "remove",
+    "add", "fadd", "sub", "fsub", "mul", "fmul", "div", "fdiv", "mod", "shl",
+    "and", "or", "eq", "neq", "less", "leq", "greater", "geq",
+    "fand", "for", "feq", "fneq", "fless", "fleq", "fgreater", "fgeq",
+    "iand", "ior", "ieq", "ineq", "ilt", "ile", "igt", "ige",
+    "conv_to_float", "conv_to_int",
+    "jmp", "jfalse", "jtrue",
+    "ijfalse", "ijtrue",
+    "call", "return",
+    "put", "fput", "get", "fget",
+    "printint", "printfloat", "printchar", "println",
+    "halt",
+    "push_local", "pop_local",
+    "local_addr",
+    "enter",
+    "storei",
+    "inc",
+    "add_var", "mul_var",
+    "elem_addr", "load_elem", "fload_elem",
+    "jlt", "jle", "jgt", "jge", "jeq", "jne",
+    "jlt_var_imm", "jle_var_imm", "jgt_var_imm", "jge_var_imm",
+    "storei_local", "inc_local",
+    "add_local", "mul_local",
+    "local_elem_addr", "load_local_elem",
+    "fload_local_elem",
+    "jlt_local_imm", "jle_local_imm",
+    "jgt_local_imm", "jge_local_imm",
+};
+unsigned int ip = 0;       /* instruction pointer */
+unsigned int code_capacity = 0;
+
+/* make room for the next word of the code array */
+void grow_code(void)
+{
+    if (ip == code_capacity) {
+        code_capacity = code_capacity ? 2 * code_capacity : 100000;
+        code = realloc(code, code_capacity * sizeof (int));
+        if (code == NULL) {
+            printf("realloc() failed for code array\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+void gen_op(unsigned char op)
+{
+    grow_code();
+    code[ip++] = op;
+}
+
+void gen_addr(int addr)
+{
+    /* write the given integer to the next word of the code array */
+    grow_code();
+    code[ip++] = addr;
+}
+
+void gen_addr_rel(int addr, unsigned int loc)
+{
+    code[loc] = addr;
+}
+
+void gen_int(int i)
+{
+    gen_addr(i);
+}
+
+void gen_float(float f)
+{
+    /* write the bits of the given float to the next word of the code array */
+    grow_code();
+    memcpy(code + ip++, &f, sizeof f);
+}
+
+/* record that the code from the current location on comes from a source line */
+void gen_line(int line)
+{
+    if (num_of_lines > 0 && line_table[num_of_lines - 1].loc == ip) {
+        line_table[num_of_lines - 1].line = line; /* the previous line generated no code */
+        return;
+    }
+    if (num_of_lines > 0 && line_table[num_of_lines - 1].line == line) {
+        return;
+    }
+    if (num_of_lines == line_table_capacity) {
+        line_table_capacity = line_table_capacity ? 2 * line_table_capacity : 64;
+        line_table = realloc(line_table, line_table_capacity * sizeof (LineEntry));
+        if (line_table == NULL) {
+            printf("realloc() failed\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    line_table[num_of_lines].loc = ip;
+    line_table[num_of_lines].line = line;
+    num_of_lines++;
+}
+
+int line_of(unsigned int loc)
+{
+    /* the last entry that starts at or before loc */
+    int lo = 0, hi = num_of_lines - 1, line = 0;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        if (line_table[mid].loc <= loc) {
+            line = line_table[mid].line;
+            lo = mid + 1;
+        }
+        else {
+            hi = mid - 1;
+        }
+    }
+    return line;
+}
+
+int op_size(unsigned char op)
+{
+    switch (op) {
+        case op_push: case op_fpush: case op_pushi: case op_fpushi: case op_pop: case op_fpop:
+        case op_jmp: case op_jfalse: case op_jtrue: case op_ijfalse: case op_ijtrue:
+        case op_push_local: case op_pop_local: case op_local_addr: case op_enter:
+        case op_add_var: case op_mul_var: case op_add_local: case op_mul_local:
+        case op_jlt: case op_jle: case op_jgt: case op_jge: case op_jeq: case op_jne:
+            return 2; /* op + address/value */
+        case op_call: case op_storei: case op_inc: case op_elem_addr: case op_load_elem: case op_fload_elem:
+        case op_storei_local: case op_inc_local: case op_local_elem_addr: case op_load_local_elem: case op_fload_local_elem:
+            return 3; /* op + 2 arguments */
+        case op_jlt_var_imm: case op_jle_var_imm: case op_jgt_var_imm: case op_jge_var_imm:
+        case op_jlt_local_imm: case op_jle_local_imm: case op_jgt_local_imm: case op_jge_local_imm:
+            return 4; /* op + address + value + offset */
+        default:
+            return 1;
+    }
+}
+
+int op_effect(unsigned char op)
+{
+    switch (op) {
+        case op_push: case op_fpush: case op_pushi: case op_fpushi: case op_dup: case op_push_local: case op_local_addr:
+            return 1;
+        case op_pop: case op_fpop: case op_pop_local: case op_remove: case op_jfalse: case op_jtrue: case op_ijfalse: case op_ijtrue:
+        case op_add: case op_fadd: case op_sub: case op_fsub: case op_mul: case op_fmul: case op_div: case op_fdiv: case op_mod: case op_shl:
+        case op_and: case op_or: case op_eq: case op_neq: case op_less: case op_leq: case op_greater: case op_geq:
+        case op_iand: case op_ior: case op_ieq: case op_ineq: case op_ilt: case op_ile: case op_igt: case op_ige:
+        case op_printint: case op_printfloat: case op_printchar:
+            return -1;
+        case op_put: case op_fput:
+        case op_jlt: case op_jle: case op_jgt: case op_jge: case op_jeq: case op_jne:
+            return -2;
+        /* (a call drops its args, but that doesn't matter: runs of code end at calls, see compute_stack_need()) */
+        default:
+            return 0;
+    }
+}
+
+int op_is_branch(unsigned char op)
+{
+    return op_is_jump(op) || op == op_call || op == op_return || op == op_halt;
+}
+
+int op_is_jump(unsigned char op)
+{
+    switch (op) {
+        case op_jmp: case op_jfalse: case op_jtrue: case op_ijfalse: case op_ijtrue:
+        case op_jlt: case op_jle: case op_jgt: case op_jge: case op_jeq: case op_jne:
+        case op_jlt_var_imm: case op_jle_var_imm: case op_jgt_var_imm: case op_jge_var_imm:
+        case op_jlt_local_imm: case op_jle_local_imm: case op_jgt_local_imm: case op_jge_local_imm:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+void compute_stack_need(void)
+{
+    /* An op never has more items on the stack while it executes than before or after it,
+    so the most a run of code pushes is the largest running total of the ops' effects.
+    Runs end at branches, so walk the code backward and restart the total after every branch. */
+    int* starts = malloc(ip * sizeof (int)); /* the position of each op */
+    stack_need = malloc(ip * sizeof (int));
+    if (starts == NULL || stack_need == NULL) {
+        printf("malloc() failed\n");
+        exit(EXIT_FAILURE);
+    }
+    int n = 0;
+    for (unsigned int i = 0; i < ip; i += op_size(code[i])) {
+        starts[n++] = i;
+    }
+    int need = 0; /* need of the op after the current one */
+    for (int k = n - 1; k >= 0; k--) {
+        unsigned char op = code[starts[k]];
+        if (op_is_branch(op)) {
+            need = 0;
+        }
+        else {
+            need += op_effect(op);
+            if (need < 0) {
+                need = 0;
+            }
+        }
+        stack_need[starts[k]] = need;
+    }
+    free(starts);
+}
+
+/* Jumps and calls to blocks that haven't been placed yet are filled in once all of the code has been generated */
+typedef struct {
+    unsigned int loc;   /* location of the offset (or the address, for a call) in the code array */
+    unsigned int instr; /* location of the jump (or call) */
+    Block* target;
+} Fixup;
+
+Fixup* block_fixups;
+int num_of_block_fixups;
+int block_fixups_capacity;
+
+/* temps on the stack, to check that they are used in the right order */
+int* temps;
+int num_of_temps;
+
+void add_fixup(unsigned int instr, Block* target)
+{
+    if (num_of_block_fixups == block_fixups_capacity) {
+        block_fixups_capacity = block_fixups_capacity ? 2 * block_fixups_capacity : 64;
+        block_fixups = realloc(block_fixups, block_fixups_capacity * sizeof (Fixup));
+        if (block_fixups == NULL) {
+            printf("realloc() failed\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    block_fixups[num_of_block_fixups].loc = ip;
+    block_fixups[num_of_block_fixups].instr = instr;
+    block_fixups[num_of_block_fixups].target = target;
+    num_of_block_fixups++;
+    gen_addr(0);
+}
+
+/* write a jump op to a block */
+void gen_jump(unsigned char op, Block* target)
+{
+    unsigned int instr = ip;
+    gen_op(op);
+    add_fixup(instr, target);
+}
+
+/* the temp is used: it must be the one on top of the stack */
+void use_temp(int t)
+{
+    if (num_of_temps == 0 || temps[num_of_temps - 1] != t) {
+        printf("internal error: t%i is not on top of the stack\n", t);
+        exit(EXIT_FAILURE);
+    }
+    num_of_temps--;
+}
+
+void define_temp(int t)
+{
+    if (t >= 0) {
+        temps[num_of_temps++] = t;
+    }
+}
+
+void gen_instr(IRInstr* instr, IRFunc* func, Block* block)
+{
+    Block* next = block->id + 1 < func->num_of_blocks ? func->blocks[block->id + 1] : NULL;
+    int real = instr->type == TK_REAL;
+    /* the temps it uses are on top of the stack (the last one on top) */
+    if (instr->kind == IR_CALL) {
+        for (int i = instr->num_of_args - 1; i >= 0; i--) {
+            use_temp(instr->args[i]);
+        }
+    }
+    else {
+        if (instr->b >= 0) {
+            use_temp(instr->b);
+        }
+        if (instr->a >= 0) {
+            use_temp(instr->a);
+        }
+    }
+    switch (instr->kind) {
+        case IR_CONST:
+            gen_op(real ? op_fpushi : op_pushi);
+            gen_int(instr->imm);
+            break;
+        case IR_LOAD:
+            gen_op(instr->local ? op_push_local : real ? op_fpush : op_push);
+            gen_addr(instr->imm);
+            break;
+        case IR_STORE:
+            gen_op(instr->local ? op_pop_local : real ? op_fpop : op_pop);
+            gen_addr(instr->imm);
+            break;
+        case IR_PARAM:
+            /* no op: the call has moved the arg into the frame */
+            break;
+        case IR_ELEM_ADDR:
+            /* multiply the index and the elt size to get the offset, and add the addr of the array */
+            gen_op(op_pushi);
+            gen_int(instr->imm2);
+            gen_op(op_mul);
+            gen_op(instr->local ? op_local_addr : op_pushi);
+            gen_addr(instr->imm);
+            gen_op(op_add);
+            break;
+        case IR_GET:
+            gen_op(real ? op_fget : op_get);
+            break;
+        case IR_PUT:
+            gen_op(real ? op_fput : op_put);
+            break;
+        case IR_UNARY:
+        case IR_BINARY:
+        case IR_PRINT:
+            gen_op(instr->op);
+            break;
+        case IR_PRINTLN:
+            gen_op(op_println);
+            break;
+        case IR_CALL:
+            /* | call <procaddr> <n> |  (the args are on the stack, the last one on top) */
+            gen_jump(op_call, instr->func->blocks[0]);
+            gen_int(instr->num_of_args);
+            break;
+        case IR_JUMP:
+            if (instr->target != next) {
+                gen_jump(op_jmp, instr->target);
+            }
+            break;
+        case IR_BRANCH:
+            if (instr->target == next) {
+                gen_jump(real ? op_jfalse : op_ijfalse, instr->target2);
+            }
+            else {
+                gen_jump(real ? op_jtrue : op_ijtrue, instr->target);
+                if (instr->target2 != next) {
+                    gen_jump(op_jmp, instr->target2);
+                }
+            }
+            break;
+        case IR_RETURN:
+            gen_op(op_return);
+            break;
+        case IR_HALT:
+            gen_op(op_halt);
+            break;
+    }
+    define_temp(instr->dst);
+}
+
+void codegen(void)
+{
+    code = NULL; /* (it grows as the code is generated) */
+    code_capacity = 0;
+    ip = 0;
+    entry_point = 0; /* ir_funcs[0] comes first */
+    num_of_block_fixups = 0;
+    num_of_lines = 0;
+    for (int f = 0; f < num_of_ir_funcs; f++) {
+        IRFunc* func = ir_funcs[f];
+        temps = malloc((func->num_of_temps + 1) * sizeof (int));
+        if (temps == NULL) {
+            printf("malloc() failed\n");
+            exit(EXIT_FAILURE);
+        }
+        for (int i = 0; i < func->num_of_blocks; i++) {
+            Block* block = func->blocks[i];
+            block->loc = ip;
+            num_of_temps = 0;
+            if (i == 0 && func->entry != NULL) {
+                /* a procedure starts with a frame of its own */
+                gen_line(0);
+                gen_op(op_enter);
+                gen_int(func->frame_size);
+            }
+            for (int j = 0; j < block->num_of_instrs; j++) {
+                gen_line(block->instrs[j].line);
+                gen_instr(&block->instrs[j], func, block);
+            }
+            if (num_of_temps != 0) {
+                printf("internal error: temps left on the stack at the end of a block\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+        if (func->entry != NULL) {
+            func->entry->addr = func->blocks[0]->loc; /* where the procedure starts */
+        }
+        free(temps);
+    }
+    for (int i = 0; i < num_of_block_fixups; i++) {
+        Fixup* fix = &block_fixups[i];
+        if (code[fix->instr] == op_call) {
+            gen_addr_rel(fix->target->loc, fix->loc);
+        }
+        else {
+            gen_addr_rel(fix->target->loc - fix->instr, fix->loc);
+        }
+    }
+    free(block_fixups);
+    block_fixups = NULL;
+    block_fixups_capacity = 0;
+}
@@ -0,0 +1,102 @@
+#ifndef CODEGEN_H
+#define CODEGEN_H
+
+#include "ir.h"
+
+/*
+Backend for the stack VM (see vm.c): generates the code array from the IR (see ir.h).
+
+Since the temps of the IR are used like the items of a stack, each of them simply stays on the operand stack
+from the op that computes it to the op that uses it, e.g.
+    t0 = load @y; t1 = load @z; t2 = const 1; t3 = t1 add t2; t4 = t0 mul t3; store @x, t4
+becomes
+    push @y; push @z; pushi 1; add; mul; pop @x
+The blocks are laid out in order, so a jump to the next block needs no op at all, and a branch needs
+a single jfalse or jtrue when one of its targets is the next block.
+
+Each call of a procedure has a frame of its own for its params and locals (so procedures can be recursive):
+the frames are stacked in the data array, from the end of the globals (dp) on, and the VM keeps two registers,
+fp (the start of the frame of the running procedure) and the end of that frame.
+A call leaves its args on the stack, and call <proc> <n> pushes the return address and fp onto a return stack
+of its own, starts a new frame at the end of the current one and moves the n args into its first slots
+(so the callee's IR_PARAMs need no op at all), and jumps to the procedure. The procedure starts with
+enter <size>, which makes the frame size bytes long (the locals, after the params, all 0); locals are read and
+written at offsets from fp (push_local, pop_local), and return pops the return address and fp back
+(the operand stack is left alone).
+    | params | locals |  <-- a frame, fp points at the first param
+*/
+
+#define FRAME_AREA_SIZE (1 << 20) /* number of bytes of the data array after the globals, for the frames */
+#define CALL_STACK_SIZE (FRAME_AREA_SIZE / 4) /* number of calls of the stack VM in progress at once (enough for
+                                               frames of a word or more to fill the frame area) */
+/* the version of the code generated: bump it whenever a change to the compiler (the parser, the IR, a backend or
+the optimizer) changes the code generated for some program, so that the images in compile caches are replaced */
+#define CODEGEN_VERSION 1
+
+enum {
+    op_push, op_fpush, op_pushi, op_fpushi, op_pop, op_fpop,
+    op_neg, op_fneg, op_dup, op_exch, op_remove,
+    op_add, op_fadd, op_sub, op_fsub, op_mul, op_fmul, op_div, op_fdiv, op_mod, op_shl,
+    op_and, op_or, op_eq, op_neq, op_less, op_leq, op_greater, op_geq,
+    op_fand, op_for, op_feq, op_fneq, op_fless, op_fleq, op_fgreater, op_fgeq,
+    op_iand, op_ior, op_ieq, op_ineq, op_ilt, op_ile, op_igt, op_ige, /* the same for two ints (no conversions needed) */
+    op_conv_to_float, op_conv_to_int,
+    op_jmp, op_jfalse, op_jtrue, 
+    op_ijfalse, op_ijtrue, /* test an int condition instead of a float one */
+    op_call, op_return,
+    op_put, op_fput, op_get, op_fget,
+    op_printint, op_printfloat, op_printchar, op_println,
+    op_halt,
+    op_push_local, op_pop_local,               /* push, pop (for ints and floats alike) of the variable at an offset in the frame */
+    op_local_addr,                             /* push the address (in the data array) of an offset in the frame */
+    op_enter,                                  /* start the frame of a procedure (arg: its size) */
+    /* superinstructions: never generated by codegen(), but fused from common sequences of the ops above (see optimizer.h) */
+    op_storei,                                 /* storei a k          = pushi k; pop a                             */
+    op_inc,                                    /* inc a k             = push a; pushi k; add; pop a                */
+    op_add_var, op_mul_var,                    /* add_var a           = push a; add                                */
+    op_elem_addr, op_load_elem, op_fload_elem, /* load_elem base size = pushi size; mul; pushi base; add; get      */
+    op_jlt, op_jle, op_jgt, op_jge,            /* jge off             = ilt; ijfalse off                           */
+    op_jeq, op_jne,
+    op_jlt_var_imm, op_jle_var_imm,            /* jge_var_imm a k off = push a; pushi k; ilt; ijfalse off          */
+    op_jgt_var_imm, op_jge_var_imm,
+    op_storei_local, op_inc_local,             /* the same for a local variable (at an offset in the frame), */
+    op_add_local, op_mul_local,                /* e.g. add_local off = push_local off; add                         */
+    op_local_elem_addr, op_load_local_elem,    /* load_local_elem off size = pushi size; mul; local_addr off; add; get */
+    op_fload_local_elem,
+    op_jlt_local_imm, op_jle_local_imm,
+    op_jgt_local_imm, op_jge_local_imm,
+    NUM_OPS
+};
+
+extern const char* op_names[NUM_OPS]; /* op_names[op]: the name of an op (e.g., for printing instructions) */
+
+extern unsigned int ip; /* instruction pointer */
+extern int* code; /* code array: a list of operations and their parameters, one per (native-endian) word */
+extern int* stack_need; /* stack_need[i]: how many items the code starting at code[i] may push before it branches */
+extern unsigned int entry_point; /* location of the code that runs first */
+
+/* The line table: the code from line_table[k].loc up to line_table[k+1].loc comes from line_table[k].line
+of the source (0 for code that doesn't come from any statement, e.g. the call to main). */
+typedef struct {
+    unsigned int loc;
+    int line;
+} LineEntry;
+
+extern LineEntry* line_table;
+extern int num_of_lines;
+
+void gen_op(unsigned char); /* write a specified operation (1 word) to the code array */ 
+void gen_addr(int); /* write a specified address (1 word) to the code array */
+void gen_addr_rel(int, unsigned int); /* same as gen_addr, but input a location in the code array to write to */
+void gen_int(int); /* write an int to the code array */
+void gen_float(float); /* write a float to the code array */
+int op_size(unsigned char); /* number of words taken by an op and its argument in the code array */
+int op_effect(unsigned char); /* change in the number of items on the stack after executing an op */
+int op_is_branch(unsigned char); /* does the op (possibly) continue somewhere other than the next op? */
+int op_is_jump(unsigned char); /* is the op's last argument an offset to jump by (relative to the op)? */
+void compute_stack_need(void); /* fill in stack_need for the code generated so far */
+int line_of(unsigned int); /* the source line of the op at a location of the code array (see line_table) */
+
+void codegen(void); /* generate the code array from the IR in ir_funcs (sets ip to its size) */
+
+#endif
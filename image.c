@@ -0,0 +1,367 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "image.h"
+#include "parser.h"
+#include "codegen.h"
+#include "regvm.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define IMAGE_MMAP
+#endif
+
+unsigned char* image_data;
+unsigned long long image_key;
+const char* image_error;
+unsigned char* image;   /* the image loaded */
+size_t image_size;
+
+unsigned long long fnv1a(unsigned long long hash, const void* bytes, size_t size)
+{
+    const unsigned char* p = bytes;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= p[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+/* the sections of an image, in order (see image.h) */
+size_t section_sizes(ImageHeader* h, size_t sizes[7])
+{
+    sizes[0] = h->code_size * sizeof (int);
+    sizes[1] = h->code_size * sizeof (int);
+    sizes[2] = h->reg_code_size * sizeof (int);
+    sizes[3] = h->num_of_procs * sizeof (unsigned int);
+    sizes[4] = h->num_of_lines * sizeof (LineEntry);
+    sizes[5] = h->reg_data_size;
+    sizes[6] = h->names_size;
+    size_t total = sizeof (ImageHeader);
+    for (int i = 0; i < 7; i++) {
+        total += (sizes[i] + 3) & ~(size_t) 3;
+    }
+    return total;
+}
+
+/* the checksum of the sections of an image */
+unsigned long long image_checksum(const void* sections[7], size_t sizes[7])
+{
+    unsigned long long hash = FNV_OFFSET;
+    for (int i = 0; i < 7; i++) {
+        hash = fnv1a(hash, sections[i], sizes[i]);
+    }
+    return hash;
+}
+
+/* write a section and its padding; return 0 if it can't be written */
+int write_section(FILE* out, const void* section, size_t size)
+{
+    static const char padding[4];
+    size_t padded = (size + 3) & ~(size_t) 3;
+    return fwrite(section, 1, size, out) == size && fwrite(padding, 1, padded - size, out) == padded - size;
+}
+
+int write_image(const char* path, unsigned long long key)
+{
+    ImageHeader h;
+    memset(&h, 0, sizeof h);
+    memcpy(h.magic, IMAGE_MAGIC, 4);
+    h.version = IMAGE_VERSION;
+    h.code_size = ip;
+    h.dp = dp;
+    h.entry_point = entry_point;
+    h.reg_code_size = reg_code_size;
+    h.reg_data_size = reg_data_size;
+    h.num_of_procs = num_of_reg_procs;
+    h.num_of_lines = num_of_lines;
+    h.key = key;
+    for (int k = 0; k < num_of_reg_procs; k++) {
+        h.names_size += strlen(reg_proc_names[k]) + 1;
+    }
+    unsigned char* data = calloc(reg_data_size + 1, 1);
+    char* names = malloc(h.names_size + 1);
+    if (data == NULL || names == NULL) {
+        printf("malloc() failed\n");
+        exit(EXIT_FAILURE);
+    }
+    reg_init_data(data);
+    size_t n = 0;
+    for (int k = 0; k < num_of_reg_procs; k++) {
+        strcpy(names + n, reg_proc_names[k]);
+        n += strlen(reg_proc_names[k]) + 1;
+    }
+
+    const void* sections[7] = {code, stack_need, reg_code, reg_proc_starts, line_table, data, names};
+    size_t sizes[7];
+    section_sizes(&h, sizes);
+    h.checksum = image_checksum(sections, sizes);
+
+    FILE* out = fopen(path, "wb");
+    int ok = out != NULL;
+    if (ok) {
+        ok = write_section(out, &h, sizeof h);
+        for (int i = 0; i < 7; i++) {
+            ok = ok && write_section(out, sections[i], sizes[i]);
+        }
+        ok = fclose(out) == 0 && ok;
+    }
+    free(data);
+    free(names);
+    return ok;
+}
+
+void unmap_image(void)
+{
+#ifdef IMAGE_MMAP
+    munmap(image, image_size);
+#else
+    free(image);
+#endif
+    image = NULL;
+}
+
+/* reject the image mapped */
+int invalid_image(const char* why)
+{
+    unmap_image();
+    image_error = why;
+    return 0;
+}
+
+/* is_op[loc]: does an op start at a location of the code array being checked? */
+unsigned char* is_op;
+unsigned int is_op_size;
+
+/* does a jump or a call to a location land on an op? */
+int lands_on_op(unsigned int target)
+{
+    return target < is_op_size && is_op[target];
+}
+
+void start_check(unsigned int size)
+{
+    is_op = calloc(size + 1, 1);
+    if (is_op == NULL) {
+        printf("calloc() failed\n");
+        exit(EXIT_FAILURE);
+    }
+    is_op_size = size;
+}
+
+/* Check the stack code of an image: every op is known and whole, every jump and call lands on an op,
+and the last op doesn't continue past the end. Return why it can't be run, or NULL. */
+const char* check_stack_code(const int* code, unsigned int size, unsigned int entry)
+{
+    start_check(size);
+    const char* error = NULL;
+    unsigned int loc = 0;
+    unsigned char op = op_halt;
+    while (loc < size) {
+        if ((unsigned int) code[loc] >= NUM_OPS) {
+            error = "invalid op";
+            break;
+        }
+        op = code[loc];
+        is_op[loc] = 1;
+        loc += op_size(op);
+    }
+    if (error == NULL && loc != size) {
+        error = "truncated op";
+    }
+    if (error == NULL && op != op_jmp && op != op_return && op != op_halt) {
+        error = "code runs past its end";
+    }
+    for (loc = 0; loc < size && error == NULL; loc += op_size(code[loc])) {
+        op = code[loc];
+        /* (a jump is by an offset from the op, its last argument; a call is to an absolute location) */
+        if (op_is_jump(op) && !lands_on_op(loc + (unsigned int) code[loc + op_size(op) - 1])) {
+            error = "jump out of the code";
+        }
+        if (op == op_call && !lands_on_op(code[loc + 1])) {
+            error = "call out of the code";
+        }
+    }
+    if (error == NULL && !lands_on_op(entry)) {
+        error = "bad entry point";
+    }
+    free(is_op);
+    return error;
+}
+
+/* the same for the register code (whose targets are absolute), given the starts of its procedures */
+const char* check_reg_code(const int* code, unsigned int size, const unsigned int* starts, unsigned int num_of_starts)
+{
+    start_check(size);
+    const char* error = NULL;
+    unsigned int loc = 0;
+    unsigned char op = rop_halt;
+    while (loc < size) {
+        if ((unsigned int) code[loc] >= NUM_ROPS) {
+            error = "invalid register op";
+            break;
+        }
+        op = code[loc];
+        is_op[loc] = 1;
+        loc += rop_size(op);
+    }
+    if (error == NULL && loc != size) {
+        error = "truncated register op";
+    }
+    if (error == NULL && op != rop_jmp && op != rop_return && op != rop_halt) {
+        error = "register code runs past its end";
+    }
+    for (loc = 0; loc < size && error == NULL; loc += rop_size(code[loc])) {
+        op = code[loc];
+        /* (the target of a jump or a call is its last argument) */
+        if ((op == rop_jmp || op == rop_call || (op >= rop_jtrue && op <= rop_ijfalse) || (op >= rop_jlt && op <= rop_jne))
+                && !lands_on_op(code[loc + rop_size(op) - 1])) {
+            error = "register jump out of the code";
+        }
+    }
+    for (unsigned int k = 0; k < num_of_starts && error == NULL; k++) {
+        if (!lands_on_op(starts[k])) {
+            error = "corrupt procedure table";
+        }
+    }
+    free(is_op);
+    return error;
+}
+
+int map_image(const char* path)
+{
+#ifdef IMAGE_MMAP
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0) {
+        return -1;
+    }
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+    image_size = st.st_size;
+    if (image_size < sizeof (ImageHeader)) {
+        close(fd);
+        image_error = "too short";
+        return 0;
+    }
+    image = mmap(NULL, image_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (image == MAP_FAILED) {
+        image = NULL;
+        return -1;
+    }
+#else
+    /* no mmap: read the whole file instead */
+    FILE* in = fopen(path, "rb");
+    if (in == NULL) {
+        return -1;
+    }
+    fseek(in, 0, SEEK_END);
+    image_size = ftell(in);
+    rewind(in);
+    if (image_size < sizeof (ImageHeader)) {
+        fclose(in);
+        image_error = "too short";
+        return 0;
+    }
+    image = malloc(image_size);
+    if (image == NULL) {
+        printf("malloc() failed for the image\n");
+        exit(EXIT_FAILURE);
+    }
+    size_t read = fread(image, 1, image_size, in);
+    fclose(in);
+    if (read != image_size) {
+        return invalid_image("can't be read");
+    }
+#endif
+
+    ImageHeader* h = (ImageHeader*) image;
+    if (memcmp(h->magic, IMAGE_MAGIC, 4) != 0) {
+        return invalid_image("bad magic number");
+    }
+    if (h->version != IMAGE_VERSION) {
+        return invalid_image("written by another version, or on a machine with another byte order");
+    }
+    size_t sizes[7];
+    if (section_sizes(h, sizes) != image_size) {
+        return invalid_image("truncated or corrupt");
+    }
+    unsigned char* sections[7];
+    unsigned char* p = image + sizeof (ImageHeader);
+    for (int i = 0; i < 7; i++) {
+        sections[i] = p;
+        p += (sizes[i] + 3) & ~(size_t) 3;
+    }
+    if (image_checksum((const void**) sections, sizes) != h->checksum) {
+        return invalid_image("corrupt (bad checksum)");
+    }
+    if (h->entry_point >= h->code_size || h->num_of_procs == 0 || h->dp > h->reg_data_size
+            || h->names_size == 0 || sections[6][h->names_size - 1] != '\0') {
+        return invalid_image("corrupt header");
+    }
+    /* the engines decode the code without checking it, so it's checked once here */
+    const char* error = check_stack_code((int*) sections[0], h->code_size, h->entry_point);
+    if (error == NULL) {
+        error = check_reg_code((int*) sections[2], h->reg_code_size, (unsigned int*) sections[3], h->num_of_procs);
+    }
+    if (error != NULL) {
+        return invalid_image(error);
+    }
+
+    /* the code is run straight from the image */
+    code = (int*) sections[0];
+    stack_need = (int*) sections[1];
+    ip = h->code_size;
+    dp = h->dp;
+    entry_point = h->entry_point;
+    reg_code = (int*) sections[2];
+    reg_code_size = h->reg_code_size;
+    reg_data_size = h->reg_data_size;
+    reg_proc_starts = (unsigned int*) sections[3];
+    num_of_reg_procs = h->num_of_procs;
+    line_table = (LineEntry*) sections[4];
+    num_of_lines = h->num_of_lines;
+    image_data = sections[5];
+    reg_proc_names = malloc(num_of_reg_procs * sizeof (char*));
+    if (reg_proc_names == NULL) {
+        printf("malloc() failed\n");
+        exit(EXIT_FAILURE);
+    }
+    /* (the names section ends with a '\0', so the names that are missing are empty) */
+    const char* name = (const char*) sections[6];
+    const char* end = name + h->names_size - 1;
+    for (int k = 0; k < num_of_reg_procs; k++) {
+        reg_proc_names[k] = name;
+        if (name < end) {
+            name += strlen(name) + 1;
+        }
+    }
+    image_key = h->key;
+    return 1;
+}
+
+void load_image(const char* path)
+{
+    int loaded = map_image(path);
+    if (loaded < 0) {
+        printf("Error: can't open %s\n", path);
+        exit(EXIT_FAILURE);
+    }
+    if (loaded == 0) {
+        printf("Error: %s is not a valid image (%s)\n", path, image_error);
+        exit(EXIT_FAILURE);
+    }
+}
+
+void unload_image(void)
+{
+    unmap_image();
+    free((void*) reg_proc_names);
+    image_data = NULL;
+}
@@ -0,0 +1,70 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include <stddef.h>
+
+/*
+Compiled program images (--emit-image, --run-image): everything the VM needs to run a program,
+so that it can be run again without tokenizing, parsing or lowering the source.
+
+An image is a header followed by its sections, each one starting at a 4-byte aligned offset:
+    code          code_size words: the code array of the stack VM (after optimize())
+    stack_need    code_size words: stack_need of that code (see codegen.h)
+    reg_code      reg_code_size words: the register code (see regvm.h)
+    proc_starts   num_of_procs words: reg_proc_starts
+    lines         num_of_lines (loc, line) pairs: the line table of the code array (see codegen.h)
+    data          reg_data_size bytes: the initial register file (whose first dp bytes are the globals of the
+                  stack VM, all 0, followed by the constants and the frames of the register code)
+    names         names_size bytes: the names of the procedures, each one followed by '\0'
+The words are in the byte order of the machine that wrote the image, so an image is only loaded
+by a build with the same IMAGE_VERSION on a machine with the same byte order.
+The header holds a checksum (FNV-1a) of the sections, so an image that was changed after it was written
+(a bit flipped, a word overwritten) is rejected as corrupt when it's loaded.
+
+--run-image maps the file read-only and runs the code straight from the mapping (only the data array is copied).
+The engines decode the code without checking it, so both code arrays are checked when the image is loaded:
+every op must be known and whole, every jump, call, procedure start and the entry point must land on an op,
+and the last op must not continue past the end of its array. The other operands (the addresses of variables and
+registers, the sizes, stack_need) are not checked: beyond its code, an image is trusted input, like the VM itself (the checksum only catches accidental changes).
+*/
+
+#define IMAGE_MAGIC   "VMIM"
+#define IMAGE_VERSION 5 /* bump whenever the format, or the meaning of any op, changes */
+
+typedef struct {
+    char magic[4];                /* IMAGE_MAGIC */
+    unsigned int version;         /* IMAGE_VERSION */
+    unsigned int code_size;
+    unsigned int dp;
+    unsigned int entry_point;
+    unsigned int reg_code_size;
+    unsigned int reg_data_size;
+    unsigned int num_of_procs;
+    unsigned int num_of_lines;
+    unsigned int names_size;
+    unsigned long long key;       /* the cache key of the source it was compiled from (see cache.h), or 0 */
+    unsigned long long checksum;  /* of the sections, in order (without their padding) */
+} ImageHeader;
+
+/* the 64-bit FNV-1a hash of some bytes, continuing from a hash (start from FNV_OFFSET) */
+#define FNV_OFFSET 0xcbf29ce484222325ULL
+unsigned long long fnv1a(unsigned long long, const void*, size_t);
+
+extern unsigned char* image_data; /* the data section of the image loaded (or NULL) */
+extern unsigned long long image_key; /* the key of the image loaded */
+
+/* write the program just compiled to an image file, with a given key; return 0 if the file can't be written */
+int write_image(const char*, unsigned long long);
+
+/* Map an image file and point the code arrays, stack_need, the line table and the procedures of the register code
+at its sections. Return 1 on success, 0 if the file isn't a valid image for this build (why is then in image_error)
+and -1 if it can't be opened. */
+int map_image(const char*);
+extern const char* image_error;
+
+/* the same, but exit with an error unless the image was loaded */
+void load_image(const char*);
+
+void unload_image(void);
+
+#endif
@@ -0,0 +1,102 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "intern.h"
+#include "arena.h"
+
+#define NAME_NONE 0xFFFFFFFFu /* an empty slot of the hash table */
+
+typedef struct {
+    const char* text;    /* in name_arena */
+    unsigned int length;
+    unsigned int hash;
+} Name;
+
+Arena name_arena = {NULL, NULL, 1 << 16};
+Name* names = NULL;           /* names[id] */
+unsigned int num_of_names = 0;
+unsigned int names_capacity = 0;
+unsigned int* name_slots = NULL; /* the hash table: the id of the name in each slot, or NAME_NONE */
+unsigned int num_of_name_slots = 0; /* (a power of 2) */
+
+unsigned int hash_name(const char* text, unsigned int length)
+{
+    unsigned int hash = 2166136261u;
+    for (unsigned int i = 0; i < length; i++) {
+        hash ^= (unsigned char) text[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/* make the hash table twice as large (or create it), and put every name back in it */
+void grow_name_slots(void)
+{
+    num_of_name_slots = num_of_name_slots == 0 ? 1024 : 2 * num_of_name_slots;
+    free(name_slots);
+    name_slots = malloc(num_of_name_slots * sizeof (unsigned int));
+    if (name_slots == NULL) {
+        printf("malloc() failed\n");
+        exit(EXIT_FAILURE);
+    }
+    memset(name_slots, 0xFF, num_of_name_slots * sizeof (unsigned int));
+    unsigned int mask = num_of_name_slots - 1;
+    for (unsigned int id = 0; id < num_of_names; id++) {
+        unsigned int slot = names[id].hash & mask;
+        while (name_slots[slot] != NAME_NONE) {
+            slot = (slot + 1) & mask;
+        }
+        name_slots[slot] = id;
+    }
+}
+
+unsigned int intern(const char* text, unsigned int length)
+{
+    if (2 * (num_of_names + 1) > num_of_name_slots) {
+        grow_name_slots();
+    }
+    unsigned int hash = hash_name(text, length);
+    unsigned int mask = num_of_name_slots - 1;
+    unsigned int slot = hash & mask;
+    /* linear probing: the name is either in the run of slots that starts at its hash, or not interned yet */
+    while (name_slots[slot] != NAME_NONE) {
+        Name* name = &names[name_slots[slot]];
+        if (name->hash == hash && name->length == length && memcmp(name->text, text, length) == 0) {
+            return name_slots[slot];
+        }
+        slot = (slot + 1) & mask;
+    }
+    if (num_of_names == names_capacity) {
+        names_capacity = names_capacity == 0 ? 1024 : 2 * names_capacity;
+        Name* temp = realloc(names, names_capacity * sizeof (Name));
+        if (temp == NULL) {
+            printf("realloc() failed\n");
+            exit(EXIT_FAILURE);
+        }
+        names = temp;
+    }
+    char* copy = arena_alloc(&name_arena, length + 1); /* (zero-filled, so the copy ends with a '\0') */
+    memcpy(copy, text, length);
+    names[num_of_names] = (Name) {copy, length, hash};
+    name_slots[slot] = num_of_names;
+    return num_of_names++;
+}
+
+const char* name_of(unsigned int id)
+{
+    return names[id].text;
+}
+
+unsigned int length_of(unsigned int id)
+{
+    return names[id].length;
+}
+
+void intern_reset(void)
+{
+    if (num_of_name_slots != 0) {
+        memset(name_slots, 0xFF, num_of_name_slots * sizeof (unsigned int));
+        arena_reset(&name_arena);
+    }
+    num_of_names = 0;
+}
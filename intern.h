@@ -0,0 +1,29 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+/*
+The table of interned names: every distinct identifier (and string literal) in the source is stored once,
+and known by a 32-bit id from then on (the ids are 0, 1, 2... in the order the names are first seen).
+Tokens carry ids rather than text, and the symbol tables compare ids rather than strings: two names are the same
+if and only if their ids are.
+
+The ids are found by hashing (FNV-1a) into an open-addressing table of ids, which is doubled when it gets
+half full. The text of the names is kept in an arena (see arena.h), so it never moves: the pointer returned by
+name_of() stays valid until the table is reset for another compilation (or the VM exits). Names can be of any length.
+*/
+
+/* the id of a name of a given length (that doesn't have to be followed by a '\0'), interned if it's new */
+unsigned int intern(const char*, unsigned int);
+
+/* the text of an interned name (followed by a '\0') */
+const char* name_of(unsigned int);
+
+/* the length of an interned name */
+unsigned int length_of(unsigned int);
+
+/* forget every name (at the start of a compilation), keeping the memory of the table and the arena */
+void intern_reset(void);
+
+extern unsigned int num_of_names; /* number of names interned so far */
+
+#endif
@@ -0,0 +1,432 @@
+#include "ir.h"
+#include "codegen.h"
+
+IRFunc** ir_funcs;
+int num_of_ir_funcs;
+
+IRFunc* cur_func;    /* the function being lowered */
+Block* cur_block;    /* the block being lowered (NULL right after a terminator) */
+int switch_addr;     /* offset in the frame of the value of the innermost switch being lowered */
+Block* switch_end;   /* the block after the innermost switch being lowered */
+int cur_line;        /* the source line of the statement being lowered */
+
+int ir_is_terminator(char kind)
+{
+    return kind == IR_JUMP || kind == IR_BRANCH || kind == IR_RETURN || kind == IR_HALT;
+}
+
+IRFunc* new_func(const char* name, Node* entry)
+{
+    IRFunc* f = arena_alloc(&ast_arena, sizeof (IRFunc));
+    f->name = name;
+    f->entry = entry;
+    return f;
+}
+
+Block* new_block(void)
+{
+    Block* b = arena_alloc(&ast_arena, sizeof (Block));
+    b->id = -1; /* not placed yet */
+    return b;
+}
+
+/* place a block after the ones already in the current function, and continue lowering into it */
+void start_block(Block* b)
+{
+    if (cur_func->num_of_blocks == cur_func->capacity) {
+        cur_func->capacity = cur_func->capacity ? 2 * cur_func->capacity : 16;
+        Block** blocks = arena_alloc(&ast_arena, cur_func->capacity * sizeof (Block*));
+        if (cur_func->num_of_blocks > 0) {
+            memcpy(blocks, cur_func->blocks, cur_func->num_of_blocks * sizeof (Block*));
+        }
+        cur_func->blocks = blocks;
+    }
+    b->id = cur_func->num_of_blocks;
+    cur_func->blocks[cur_func->num_of_blocks++] = b;
+    cur_block = b;
+}
+
+/* append an instruction to the current block (code that follows a terminator goes into a new, unreachable block) */
+IRInstr* emit_ir(char kind, Type type)
+{
+    if (cur_block == NULL) {
+        start_block(new_block());
+    }
+    Block* b = cur_block;
+    if (b->num_of_instrs == b->capacity) {
+        b->capacity = b->capacity ? 2 * b->capacity : 8;
+        IRInstr* instrs = arena_alloc(&ast_arena, b->capacity * sizeof (IRInstr));
+        if (b->num_of_instrs > 0) {
+            memcpy(instrs, b->instrs, b->num_of_instrs * sizeof (IRInstr));
+        }
+        b->instrs = instrs;
+    }
+    IRInstr* instr = &b->instrs[b->num_of_instrs++];
+    memset(instr, 0, sizeof (IRInstr));
+    instr->kind = kind;
+    instr->type = is_integral(type) ? TK_INT : type;
+    instr->dst = instr->a = instr->b = -1;
+    instr->line = cur_line;
+    if (ir_is_terminator(kind)) {
+        cur_block = NULL;
+    }
+    return instr;
+}
+
+int new_temp(void)
+{
+    return cur_func->num_of_temps++;
+}
+
+/* the stack VM op that computes left op right (for operands of a given type) */
+unsigned char binary_op(Type op, Type type)
+{
+    int ints = is_integral(type);
+    switch (op) {
+        case TK_PLUS:       return ints ? op_add : op_fadd;
+        case TK_MINUS:      return ints ? op_sub : op_fsub;
+        case TK_MULT:       return ints ? op_mul : op_fmul;
+        case TK_DIV:        return ints ? op_div : op_fdiv;
+        case TK_MOD:        return op_mod;
+        case TK_LEFTSHIFT:  return op_shl;
+        case TK_OR:         return ints ? op_ior : op_or;
+        case TK_AND:        return ints ? op_iand : op_and;
+        case TK_EQ:         return ints ? op_ieq : op_eq;
+        case TK_NEQ:        return ints ? op_ineq : op_neq;
+        case TK_LESS:       return ints ? op_ilt : op_less;
+        case TK_LESS_EQ:    return ints ? op_ile : op_leq;
+        case TK_GREATER:    return ints ? op_igt : op_greater;
+        default:            return ints ? op_ige : op_geq;
+    }
+}
+
+/* lower an expression, and return the temp that holds its value */
+int lower_expr(Expr* e)
+{
+    IRInstr* instr;
+    int a, b;
+    switch (e->kind) {
+        case EX_CONST:
+            instr = emit_ir(IR_CONST, e->type);
+            instr->imm = e->value.i; /* (the bits of a float) */
+            break;
+        case EX_VAR:
+            instr = emit_ir(IR_LOAD, e->type);
+            instr->imm = e->addr;
+            instr->local = e->local;
+            break;
+        case EX_ELEM:
+            a = lower_expr(e->left);
+            instr = emit_ir(IR_ELEM_ADDR, TK_INT);
+            instr->a = a;
+            instr->imm = e->addr;
+            instr->local = e->local;
+            instr->imm2 = e->elt_size;
+            instr->dst = new_temp();
+            a = instr->dst;
+            instr = emit_ir(IR_GET, e->type);
+            instr->a = a;
+            break;
+        case EX_UNARY:
+            a = lower_expr(e->left);
+            instr = emit_ir(IR_UNARY, e->type);
+            instr->op = e->type == TK_REAL ? op_fneg : op_neg;
+            instr->a = a;
+            break;
+        case EX_CONV:
+            a = lower_expr(e->left);
+            instr = emit_ir(IR_UNARY, e->type);
+            instr->op = e->type == TK_REAL ? op_conv_to_float : op_conv_to_int;
+            instr->a = a;
+            break;
+        default: /* EX_BINARY */
+            a = lower_expr(e->left);
+            b = lower_expr(e->right);
+            instr = emit_ir(IR_BINARY, e->type);
+            instr->op = binary_op(e->op, e->left->type);
+            instr->a = a;
+            instr->b = b;
+            break;
+    }
+    instr->dst = new_temp();
+    return instr->dst;
+}
+
+/* end the current block with a jump to another one */
+void jump_to(Block* target)
+{
+    IRInstr* instr = emit_ir(IR_JUMP, TK_INT);
+    instr->target = target;
+}
+
+void branch(int cond, Type type, Block* if_true, Block* if_false)
+{
+    IRInstr* instr = emit_ir(IR_BRANCH, type);
+    instr->a = cond;
+    instr->target = if_true;
+    instr->target2 = if_false;
+}
+
+IRFunc* func_of(Proc* proc)
+{
+    for (int f = 1; f < num_of_ir_funcs; f++) {
+        if (ir_funcs[f]->entry == proc->entry) {
+            return ir_funcs[f];
+        }
+    }
+    printf("internal error: procedure '%s' was not lowered\n", proc->entry->name);
+    exit(EXIT_FAILURE);
+}
+
+void lower_stmt(Stmt* s)
+{
+    IRInstr* instr;
+    Block *then_block, *else_block, *end_block, *body_block;
+    int a, b;
+    if (s->kind != ST_BLOCK) {
+        cur_line = s->line;
+    }
+    switch (s->kind) {
+        case ST_BLOCK:
+            for (Stmt* t = s->body; t != NULL; t = t->next) {
+                lower_stmt(t);
+            }
+            break;
+        case ST_ASSIGN:
+            if (s->target->kind == EX_VAR) {
+                a = lower_expr(s->expr);
+                instr = emit_ir(IR_STORE, s->target->type);
+                instr->a = a;
+                instr->imm = s->target->addr;
+                instr->local = s->target->local;
+            }
+            else {
+                a = lower_expr(s->target->left);
+                instr = emit_ir(IR_ELEM_ADDR, TK_INT);
+                instr->a = a;
+                instr->imm = s->target->addr;
+                instr->local = s->target->local;
+                instr->imm2 = s->target->elt_size;
+                instr->dst = new_temp();
+                a = instr->dst;
+                b = lower_expr(s->expr);
+                instr = emit_ir(IR_PUT, s->target->type);
+                instr->a = a;
+                instr->b = b;
+            }
+            break;
+        case ST_IF:
+            then_block = new_block();
+            end_block = new_block();
+            else_block = s->else_body != NULL ? new_block() : end_block;
+            a = lower_expr(s->expr);
+            branch(a, s->expr->type, then_block, else_block);
+            start_block(then_block);
+            lower_stmt(s->body);
+            jump_to(end_block);
+            if (s->else_body != NULL) {
+                start_block(else_block);
+                lower_stmt(s->else_body);
+                jump_to(end_block);
+            }
+            start_block(end_block);
+            break;
+        case ST_WHILE:
+            then_block = new_block(); /* the condition */
+            body_block = new_block();
+            end_block = new_block();
+            jump_to(then_block);
+            start_block(then_block);
+            a = lower_expr(s->expr);
+            branch(a, s->expr->type, body_block, end_block);
+            start_block(body_block);
+            lower_stmt(s->body);
+            jump_to(then_block);
+            start_block(end_block);
+            break;
+        case ST_DO:
+            body_block = new_block();
+            end_block = new_block();
+            jump_to(body_block);
+            start_block(body_block);
+            lower_stmt(s->body);
+            cur_line = s->line;
+            a = lower_expr(s->expr);
+            branch(a, s->expr->type, body_block, end_block);
+            start_block(end_block);
+            break;
+        case ST_SWITCH: {
+            int outer_addr = switch_addr;
+            Block* outer_end = switch_end;
+            switch_addr = s->addr;
+            switch_end = new_block();
+            a = lower_expr(s->expr);
+            instr = emit_ir(IR_STORE, TK_INT);
+            instr->a = a;
+            instr->imm = s->addr;
+            instr->local = 1;
+            for (Stmt* t = s->body; t != NULL; t = t->next) {
+                lower_stmt(t);
+            }
+            jump_to(switch_end);
+            start_block(switch_end);
+            switch_addr = outer_addr;
+            switch_end = outer_end;
+            break;
+        }
+        case ST_CASE:
+            /* if the value of the switch matches, run the statement and leave the switch */
+            then_block = new_block();
+            else_block = new_block();
+            a = lower_expr(ast_var(switch_addr, 1, TK_INT));
+            b = lower_expr(s->expr);
+            instr = emit_ir(IR_BINARY, TK_INT);
+            instr->op = op_ieq;
+            instr->a = a;
+            instr->b = b;
+            instr->dst = new_temp();
+            branch(instr->dst, TK_INT, then_block, else_block);
+            start_block(then_block);
+            lower_stmt(s->body);
+            jump_to(switch_end);
+            start_block(else_block);
+            break;
+        case ST_DEFAULT:
+            lower_stmt(s->body);
+            jump_to(switch_end);
+            break;
+        case ST_CALL: {
+            int* args = arena_alloc(&ast_arena, (s->num_of_args + 1) * sizeof (int));
+            for (int i = 0; i < s->num_of_args; i++) {
+                args[i] = lower_expr(s->args[i]);
+            }
+            instr = emit_ir(IR_CALL, TK_INT);
+            instr->func = func_of(s->proc);
+            /* (a procedure can only call the ones defined before it, and itself: so only a call of itself is recursive) */
+            instr->imm = instr->func == cur_func;
+            instr->args = args;
+            instr->num_of_args = s->num_of_args;
+            break;
+        }
+        case ST_RETURN:
+            emit_ir(IR_RETURN, TK_INT);
+            break;
+        case ST_PRINT:
+            a = lower_expr(s->expr);
+            instr = emit_ir(IR_PRINT, s->expr->type);
+            instr->op = s->expr->type == TK_INT ? op_printint : s->expr->type == TK_REAL ? op_printfloat : op_printchar;
+            instr->a = a;
+            emit_ir(IR_PRINTLN, TK_INT);
+            break;
+        case ST_PRINT_STR:
+            for (int i = 0; s->str[i] != '\0'; i++) {
+                a = lower_expr(ast_const_int(s->str[i], TK_CHAR));
+                instr = emit_ir(IR_PRINT, TK_CHAR);
+                instr->op = op_printchar;
+                instr->a = a;
+            }
+            emit_ir(IR_PRINTLN, TK_INT);
+            break;
+    }
+}
+
+void ir_lower(Program* program)
+{
+    num_of_ir_funcs = 1;
+    for (Proc* p = program->procs; p != NULL; p = p->next) {
+        num_of_ir_funcs++;
+    }
+    ir_funcs = arena_alloc(&ast_arena, num_of_ir_funcs * sizeof (IRFunc*));
+    ir_funcs[0] = new_func("<start>", NULL);
+    int f = 1;
+    for (Proc* p = program->procs; p != NULL; p = p->next) {
+        ir_funcs[f] = new_func(p->entry->name, p->entry);
+        ir_funcs[f]->frame_size = p->frame_size;
+        ir_funcs[f]->num_of_params = p->num_of_params;
+        f++;
+    }
+
+    /* the code that runs first: initialize the globals, call main, halt */
+    cur_func = ir_funcs[0];
+    start_block(new_block());
+    lower_stmt(program->init);
+    cur_line = 0;
+    IRInstr* instr = emit_ir(IR_CALL, TK_INT);
+    instr->func = func_of(program->main);
+    emit_ir(IR_HALT, TK_INT);
+
+    f = 1;
+    for (Proc* p = program->procs; p != NULL; p = p->next) {
+        cur_func = ir_funcs[f++];
+        start_block(new_block());
+        cur_line = 0;
+        /* the args are passed by the call (into the first slots of the frame) */
+        for (int i = 0; i < p->num_of_params; i++) {
+            instr = emit_ir(IR_PARAM, p->param_types[i]);
+            instr->imm = p->param_addrs[i];
+            instr->local = 1;
+        }
+        lower_stmt(p->body);
+        emit_ir(IR_RETURN, TK_INT);
+    }
+}
+
+/* print a temp */
+void print_temp(int t)
+{
+    printf("t%i", t);
+}
+
+void ir_print(void)
+{
+    for (int f = 0; f < num_of_ir_funcs; f++) {
+        IRFunc* func = ir_funcs[f];
+        printf("%s:\n", func->name);
+        for (int i = 0; i < func->num_of_blocks; i++) {
+            Block* b = func->blocks[i];
+            printf("  B%i:\n", b->id);
+            for (int j = 0; j < b->num_of_instrs; j++) {
+                IRInstr* instr = &b->instrs[j];
+                printf("    ");
+                if (instr->dst >= 0) {
+                    print_temp(instr->dst);
+                    printf(" = ");
+                }
+                switch (instr->kind) {
+                    case IR_CONST:
+                        if (instr->type == TK_REAL) {
+                            float f;
+                            memcpy(&f, &instr->imm, sizeof f);
+                            printf("const %f", f);
+                        }
+                        else {
+                            printf("const %i", instr->imm);
+                        }
+                        break;
+                    case IR_LOAD:      printf("load @%s%i", instr->local ? "fp+" : "", instr->imm); break;
+                    case IR_STORE:     printf("store @%s%i, t%i", instr->local ? "fp+" : "", instr->imm, instr->a); break;
+                    case IR_ELEM_ADDR: printf("elem_addr %s%i + t%i * %i", instr->local ? "fp+" : "", instr->imm, instr->a, instr->imm2); break;
+                    case IR_GET:       printf("get [t%i]", instr->a); break;
+                    case IR_PUT:       printf("put [t%i], t%i", instr->a, instr->b); break;
+                    case IR_UNARY:     printf("%s t%i", op_names[instr->op], instr->a); break;
+                    case IR_BINARY:    printf("t%i %s t%i", instr->a, op_names[instr->op], instr->b); break;
+                    case IR_PRINT:     printf("%s t%i", op_names[instr->op], instr->a); break;
+                    case IR_PRINTLN:   printf("println"); break;
+                    case IR_PARAM:     printf("param @fp+%i", instr->imm); break;
+                    case IR_CALL:
+                        printf("call %s(", instr->func->name);
+                        for (int i = 0; i < instr->num_of_args; i++) {
+                            printf(i > 0 ? ", t%i" : "t%i", instr->args[i]);
+                        }
+                        printf(instr->imm ? ") (recursive)" : ")");
+                        break;
+                    case IR_JUMP:      printf("jump B%i", instr->target->id); break;
+                    case IR_BRANCH:    printf("branch t%i, B%i, B%i", instr->a, instr->target->id, instr->target2->id); break;
+                    case IR_RETURN:    printf("return"); break;
+                    case IR_HALT:      printf("halt"); break;
+                }
+                printf("\n");
+            }
+        }
+    }
+}
@@ -0,0 +1,107 @@
+#ifndef IR_H
+#define IR_H
+
+#include "ast.h"
+
+/*
+Intermediate representation: a linear, three-address code in basic blocks, lowered from the syntax tree (see ast.h)
+and handed to a backend (see codegen.h) that generates the code array.
+
+Each function (the procedures, plus the code that runs first: the initializers of the global variables,
+the call to main and the halt) is a list of basic blocks. A block is a list of instructions that ends with
+exactly one terminator (IR_JUMP, IR_BRANCH, IR_RETURN or IR_HALT), and control only enters it at the top.
+
+Values are held in temporaries (temps), numbered from 0 in each function. Every temp is defined once and
+used once, by a later instruction of the same block, and temps are used in the reverse order of their
+definitions (i.e., like the items of a stack), because they come from the evaluation of expression trees.
+Variables live in the data array (globals) or in the frame of the procedure (locals, see ast.h), and are only
+read and written with IR_LOAD and IR_STORE (or IR_GET and IR_PUT); these, IR_ELEM_ADDR and IR_PARAM are local
+if imm is an offset in the frame rather than an address.
+
+e.g., for x = y * (z + 1);
+    t0 = load @y
+    t1 = load @z
+    t2 = const 1
+    t3 = t1 add t2
+    t4 = t0 mul t3
+    store @x, t4
+
+The operation of IR_UNARY, IR_BINARY and IR_PRINT is given by the stack VM op that performs it (e.g., op_fadd or op_ilt),
+which the lowering has already picked according to the types of the operands.
+*/
+
+enum {
+    IR_CONST,     /* dst = imm (the bits of an int or a float) */
+    IR_LOAD,      /* dst = the variable at address (or offset) imm */
+    IR_STORE,     /* the variable at address (or offset) imm = a */
+    IR_ELEM_ADDR, /* dst = imm + a * imm2 (the address of an array elt, given the address of the array and the elt size;
+                     for a local array, the address of the array is that of the frame + imm) */
+    IR_GET,       /* dst = the value at address a */
+    IR_PUT,       /* the value at address a = b */
+    IR_UNARY,     /* dst = op a */
+    IR_BINARY,    /* dst = a op b */
+    IR_PRINT,     /* op a (printint, printfloat or printchar) */
+    IR_PRINTLN,
+    IR_PARAM,     /* the local variable at offset imm = the next argument passed to the procedure */
+    IR_CALL,      /* call the procedure func with the args (imm: 1 if the call is recursive, i.e., func is active already) */
+    /* terminators */
+    IR_JUMP,      /* continue with the block target */
+    IR_BRANCH,    /* continue with the block target if a is true, otherwise with the block target2 */
+    IR_RETURN,
+    IR_HALT,
+};
+
+typedef struct IRInstr IRInstr;
+typedef struct Block Block;
+typedef struct IRFunc IRFunc;
+
+struct IRInstr {
+    char kind;        /* IR_* */
+    unsigned char op; /* the VM op (IR_UNARY, IR_BINARY, IR_PRINT) */
+    Type type;        /* type of the value defined, stored, loaded or tested: TK_INT (for ints and chars) or TK_REAL */
+    int dst;          /* the temp defined, or -1 */
+    int a, b;         /* temps used */
+    int imm, imm2;
+    char local;       /* is imm an offset in the frame? (IR_LOAD, IR_STORE, IR_ELEM_ADDR, IR_PARAM) */
+    Block* target;
+    Block* target2;
+    IRFunc* func;
+    int* args;
+    int num_of_args;
+    int line;         /* the source line of the statement it was lowered from (0 for none) */
+};
+
+struct Block {
+    int id;           /* index in the function's blocks */
+    IRInstr* instrs;
+    int num_of_instrs;
+    int capacity;
+    int loc;          /* location in the code array (filled in by the stack backend, see codegen.h) */
+    int reg_loc;      /* location in the register code array (filled in by the register backend, see regvm.h) */
+};
+
+struct IRFunc {
+    const char* name;
+    Node* entry;      /* symbol table entry of the procedure (NULL for the code that runs first) */
+    Block** blocks;   /* blocks[0] is the entry; the blocks are laid out in this order */
+    int num_of_blocks;
+    int capacity;
+    int num_of_temps;
+    int frame_size;   /* number of bytes of the frame of a call (see Proc) */
+    int num_of_params;
+    int home;         /* the address of its frame in the register VM (filled in by the register backend, see regvm.h) */
+};
+
+extern IRFunc** ir_funcs; /* ir_funcs[0] runs first; the rest are the procedures, in order */
+extern int num_of_ir_funcs;
+
+/* lower a whole program to the IR (allocated from ast_arena) */
+void ir_lower(Program*);
+
+/* print the IR of every function (for tracing) */
+void ir_print(void);
+
+/* is the kind a terminator? */
+int ir_is_terminator(char);
+
+#endif
@@ -0,0 +1,591 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "jit.h"
+#include "regvm.h"
+#include "output.h"
+
+#if defined(__x86_64__) && (defined(__unix__) || defined(__APPLE__))
+#include <sys/mman.h>
+int jit_available = 1;
+#else
+int jit_available = 0;
+#endif
+
+unsigned int jit_threshold = 10;
+void** jit_native;           /* native address of each compiled op */
+unsigned int* jit_counts;    /* jit_counts[loc]: calls and backedges to reg_code[loc] so far */
+char* jit_proc_state;            /* jit_proc_state[k]: 0 (not compiled yet), 1 (compiled) or -1 (could not be compiled) */
+unsigned int* jit_return_limit;  /* the end of the return stack */
+unsigned int* jit_rsp;       /* the return stack pointer when native code returns */
+
+unsigned char* jit_buf;          /* executable buffer: the entry and exit code, and then the procedures compiled */
+size_t jit_buf_size;
+size_t jit_buf_used;
+size_t jit_exit_code;            /* offset of the exit code in jit_buf */
+
+/* Native jumps (rel32) to ops of the procedure being compiled, to be filled in once all of its ops are placed */
+typedef struct {
+    size_t at;               /* offset of the rel32 in jit_buf */
+    unsigned int target;     /* location of the op in reg_code */
+} JitFixup;
+
+JitFixup* jit_fixups;
+int num_of_jit_fixups;
+size_t* jit_labels;              /* jit_labels[loc - start]: offset in jit_buf of the native code of the op at loc */
+
+void too_many_calls(int); /* (see vm.c) */
+
+/* the helpers called by native code (for what a template can't do by itself) */
+void jit_printint(int i)
+{
+    output_int(i);
+}
+
+void jit_printfloat(float f)
+{
+    output_float(f);
+}
+
+void jit_printchar(int c)
+{
+    OUTPUT_CHAR(c);
+}
+
+void jit_println(void)
+{
+    output_newline();
+}
+
+void jit_division_by_zero(void)
+{
+    printf("Error: division by zero\n");
+    exit(EXIT_FAILURE);
+}
+
+void emit1(int byte)
+{
+    jit_buf[jit_buf_used++] = byte;
+}
+
+void emit2(int b1, int b2)
+{
+    emit1(b1);
+    emit1(b2);
+}
+
+void emit3(int b1, int b2, int b3)
+{
+    emit1(b1);
+    emit1(b2);
+    emit1(b3);
+}
+
+void emit4(int word)
+{
+    memcpy(jit_buf + jit_buf_used, &word, 4);
+    jit_buf_used += 4;
+}
+
+void emit8(void* p)
+{
+    memcpy(jit_buf + jit_buf_used, &p, 8);
+    jit_buf_used += 8;
+}
+
+/* the ModRM byte (and displacement) of the operand [rbx + addr], i.e., the register at addr, with a register number */
+void mem(int reg, int addr)
+{
+    emit1(0x80 | reg << 3 | 3);
+    emit4(addr);
+}
+
+/* registers */
+#define EAX 0
+#define ECX 1
+#define EDX 2
+#define EDI 7
+
+void load(int reg, int addr)        /* mov reg, [rbx + addr] */
+{
+    emit1(0x8B);
+    mem(reg, addr);
+}
+
+void store(int reg, int addr)       /* mov [rbx + addr], reg */
+{
+    emit1(0x89);
+    mem(reg, addr);
+}
+
+void load_xmm(int xmm, int addr)    /* movss xmm, [rbx + addr] */
+{
+    emit3(0xF3, 0x0F, 0x10);
+    mem(xmm, addr);
+}
+
+void store_xmm(int xmm, int addr)   /* movss [rbx + addr], xmm */
+{
+    emit3(0xF3, 0x0F, 0x11);
+    mem(xmm, addr);
+}
+
+/* jump (E9 or 0F 8x) to the op at a location of the procedure being compiled */
+void jump_to_op(int opcode, unsigned int target)
+{
+    if (opcode == 0xE9) {
+        emit1(0xE9);
+    }
+    else {
+        emit2(0x0F, opcode);
+    }
+    jit_fixups[num_of_jit_fixups].at = jit_buf_used;
+    jit_fixups[num_of_jit_fixups].target = target;
+    num_of_jit_fixups++;
+    emit4(0);
+}
+
+/* jmp to an offset of jit_buf */
+void jump_to_offset(size_t offset)
+{
+    emit1(0xE9);
+    emit4(offset - (jit_buf_used + 4));
+}
+
+/* call a C function */
+void call_helper(void* f)
+{
+    emit2(0x48, 0xB8); /* mov rax, f */
+    emit8(f);
+    emit2(0xFF, 0xD0); /* call rax */
+}
+
+/* hand control to the op at loc: native code if it is compiled, otherwise the interpreter */
+void continue_at(unsigned int loc)
+{
+    emit3(0x49, 0x8B, 0x85); /* mov rax, [r13 + loc * 8] */
+    emit4(loc * 8);
+    emit3(0x48, 0x85, 0xC0); /* test rax, rax */
+    emit2(0x74, 0x02);       /* je (over the next jmp) */
+    emit2(0xFF, 0xE0);       /* jmp rax */
+    emit1(0xB8);             /* mov eax, loc */
+    emit4(loc);
+    jump_to_offset(jit_exit_code);
+}
+
+/* set eax to 1 if the condition code holds, 0 otherwise, and store it */
+void store_condition(int setcc, int addr)
+{
+    emit3(0x0F, setcc, 0xC0);    /* setcc al */
+    emit3(0x0F, 0xB6, 0xC0);     /* movzx eax, al */
+    store(EAX, addr);
+}
+
+/* Write the entry code (at offset 0) and the exit code.
+entry(native address, register file, return stack pointer, jit_native) saves the registers it uses, and jumps
+to the native address; the exit code expects the location to continue with in eax, saves the return stack pointer
+in jit_rsp, and returns the location. */
+void write_entry_and_exit(void)
+{
+    jit_buf_used = 0;
+    emit1(0x53);             /* push rbx */
+    emit2(0x41, 0x54);       /* push r12 */
+    emit2(0x41, 0x55);       /* push r13 (the stack is now aligned for calls to helpers) */
+    emit3(0x48, 0x89, 0xF3); /* mov rbx, rsi */
+    emit3(0x49, 0x89, 0xD4); /* mov r12, rdx */
+    emit3(0x49, 0x89, 0xCD); /* mov r13, rcx */
+    emit2(0xFF, 0xE7);       /* jmp rdi */
+    jit_exit_code = jit_buf_used;
+    emit2(0x48, 0xB9);       /* mov rcx, &jit_rsp */
+    emit8(&jit_rsp);
+    emit3(0x4C, 0x89, 0x21); /* mov [rcx], r12 */
+    emit2(0x41, 0x5D);       /* pop r13 */
+    emit2(0x41, 0x5C);       /* pop r12 */
+    emit1(0x5B);             /* pop rbx */
+    emit1(0xC3);             /* ret */
+}
+
+/* Translate the op at reg_code[loc]; return 0 if there is no template for it */
+int translate(unsigned int loc)
+{
+    int* arg = reg_code + loc + 1;
+    unsigned char op = reg_code[loc];
+    switch (op) {
+        case rop_mov:
+            load(EAX, arg[1]);
+            store(EAX, arg[0]);
+            break;
+        case rop_add:
+        case rop_sub:
+        case rop_mul:
+            load(EAX, arg[1]);
+            if (op == rop_mul) {
+                emit2(0x0F, 0xAF); /* imul eax, [b] */
+            }
+            else {
+                emit1(op == rop_add ? 0x03 : 0x2B); /* add/sub eax, [b] */
+            }
+            mem(EAX, arg[2]);
+            store(EAX, arg[0]);
+            break;
+        case rop_div:
+        case rop_mod:
+            load(ECX, arg[2]);
+            if (op == rop_div) {
+                emit2(0x85, 0xC9); /* test ecx, ecx */
+                emit2(0x75, 0x0C); /* jne (over the call) */
+                call_helper(jit_division_by_zero);
+            }
+            load(EAX, arg[1]);
+            emit1(0x99);           /* cdq */
+            emit2(0xF7, 0xF9);     /* idiv ecx */
+            store(op == rop_div ? EAX : EDX, arg[0]);
+            break;
+        case rop_shl:
+            load(ECX, arg[2]);
+            load(EAX, arg[1]);
+            emit2(0xD3, 0xE0);     /* shl eax, cl */
+            store(EAX, arg[0]);
+            break;
+        case rop_fadd:
+        case rop_fsub:
+        case rop_fmul:
+            load_xmm(0, arg[1]);
+            emit3(0xF3, 0x0F, op == rop_fadd ? 0x58 : op == rop_fsub ? 0x5C : 0x59); /* addss/subss/mulss xmm0, [b] */
+            mem(0, arg[2]);
+            store_xmm(0, arg[0]);
+            break;
+        case rop_fdiv:
+            load_xmm(1, arg[2]);
+            emit3(0x0F, 0x57, 0xD2); /* xorps xmm2, xmm2 */
+            emit3(0x0F, 0x2E, 0xCA); /* ucomiss xmm1, xmm2 */
+            emit2(0x7A, 0x0E);       /* jp (over the test and the call: a NaN is not 0) */
+            emit2(0x75, 0x0C);       /* jne (over the call) */
+            call_helper(jit_division_by_zero);
+            load_xmm(0, arg[1]);
+            emit3(0xF3, 0x0F, 0x5E); /* divss xmm0, xmm1 */
+            emit1(0xC1);
+            store_xmm(0, arg[0]);
+            break;
+        case rop_eq:
+        case rop_neq:
+        case rop_less:
+        case rop_leq:
+        case rop_greater:
+        case rop_geq:
+            /* a < b and a <= b are compared as b > a and b >= a (so that unordered operands give 0) */
+            load_xmm(0, op == rop_less || op == rop_leq ? arg[2] : arg[1]);
+            emit2(0x0F, 0x2E);       /* ucomiss xmm0, [the other one] */
+            mem(0, op == rop_less || op == rop_leq ? arg[1] : arg[2]);
+            if (op == rop_eq) {
+                emit3(0x0F, 0x94, 0xC0); /* sete al */
+                emit3(0x0F, 0x9B, 0xC1); /* setnp cl */
+                emit2(0x20, 0xC8);       /* and al, cl */
+                emit3(0x0F, 0xB6, 0xC0); /* movzx eax, al */
+                store(EAX, arg[0]);
+            }
+            else if (op == rop_neq) {
+                emit3(0x0F, 0x95, 0xC0); /* setne al */
+                emit3(0x0F, 0x9A, 0xC1); /* setp cl */
+                emit2(0x08, 0xC8);       /* or al, cl */
+                emit3(0x0F, 0xB6, 0xC0); /* movzx eax, al */
+                store(EAX, arg[0]);
+            }
+            else {
+                store_condition(op == rop_greater || op == rop_less ? 0x97 : 0x93, arg[0]); /* seta/setae */
+            }
+            break;
+        case rop_iand:
+        case rop_ior:
+            load(EAX, arg[1]);
+            load(ECX, arg[2]);
+            emit2(0x85, 0xC0);       /* test eax, eax */
+            emit3(0x0F, 0x95, 0xC0); /* setne al */
+            emit2(0x85, 0xC9);       /* test ecx, ecx */
+            emit3(0x0F, 0x95, 0xC1); /* setne cl */
+            emit2(op == rop_iand ? 0x20 : 0x08, 0xC8); /* and/or al, cl */
+            emit3(0x0F, 0xB6, 0xC0); /* movzx eax, al */
+            store(EAX, arg[0]);
+            break;
+        case rop_ieq:
+        case rop_ineq:
+        case rop_ilt:
+        case rop_ile:
+        case rop_igt:
+        case rop_ige: {
+            static const unsigned char setcc[] = {0x94, 0x95, 0x9C, 0x9E, 0x9F, 0x9D};
+            load(EAX, arg[1]);
+            emit1(0x3B);             /* cmp eax, [b] */
+            mem(EAX, arg[2]);
+            store_condition(setcc[op - rop_ieq], arg[0]);
+            break;
+        }
+        case rop_neg:
+            load(EAX, arg[1]);
+            emit2(0xF7, 0xD8);       /* neg eax */
+            store(EAX, arg[0]);
+            break;
+        case rop_fneg:
+            load(EAX, arg[1]);
+            emit1(0x35);             /* xor eax, the sign bit */
+            emit4(0x80000000);
+            store(EAX, arg[0]);
+            break;
+        case rop_conv_to_float:
+            emit3(0xF3, 0x0F, 0x2A); /* cvtsi2ss xmm0, [a] */
+            mem(0, arg[1]);
+            store_xmm(0, arg[0]);
+            break;
+        case rop_conv_to_int:
+            emit3(0xF3, 0x0F, 0x2C); /* cvttss2si eax, [a] */
+            mem(EAX, arg[1]);
+            store(EAX, arg[0]);
+            break;
+        case rop_load_elem:
+        case rop_store_elem: {
+            int index = op == rop_load_elem ? arg[1] : arg[0];
+            int base = op == rop_load_elem ? arg[2] : arg[1];
+            int size = op == rop_load_elem ? arg[3] : arg[2];
+            load(EAX, index);
+            emit2(0x69, 0xC0);       /* imul eax, eax, size */
+            emit4(size);
+            emit3(0x48, 0x63, 0xC0); /* movsxd rax, eax */
+            if (op == rop_load_elem) {
+                emit3(0x8B, 0x8C, 0x03); /* mov ecx, [rbx + rax + base] */
+                emit4(base);
+                store(ECX, arg[0]);
+            }
+            else {
+                load(ECX, arg[3]);
+                emit3(0x89, 0x8C, 0x03); /* mov [rbx + rax + base], ecx */
+                emit4(base);
+            }
+            break;
+        }
+        case rop_jmp:
+            jump_to_op(0xE9, arg[0]);
+            break;
+        case rop_ijtrue:
+        case rop_ijfalse:
+            load(EAX, arg[0]);
+            emit2(0x85, 0xC0);       /* test eax, eax */
+            jump_to_op(op == rop_ijtrue ? 0x85 : 0x84, arg[1]); /* jne/je */
+            break;
+        case rop_jtrue:
+            /* true unless it is 0 (a NaN is true) */
+            load_xmm(0, arg[0]);
+            emit3(0x0F, 0x57, 0xC9); /* xorps xmm1, xmm1 */
+            emit3(0x0F, 0x2E, 0xC1); /* ucomiss xmm0, xmm1 */
+            jump_to_op(0x85, arg[1]); /* jne */
+            jump_to_op(0x8A, arg[1]); /* jp */
+            break;
+        case rop_jfalse:
+            load_xmm(0, arg[0]);
+            emit3(0x0F, 0x57, 0xC9); /* xorps xmm1, xmm1 */
+            emit3(0x0F, 0x2E, 0xC1); /* ucomiss xmm0, xmm1 */
+            emit2(0x7A, 0x06);       /* jp (over the je) */
+            jump_to_op(0x84, arg[1]); /* je */
+            break;
+        case rop_jlt:
+        case rop_jle:
+        case rop_jgt:
+        case rop_jge:
+        case rop_jeq:
+        case rop_jne: {
+            static const unsigned char jcc[] = {0x8C, 0x8E, 0x8F, 0x8D, 0x84, 0x85};
+            load(EAX, arg[0]);
+            emit1(0x3B);             /* cmp eax, [b] */
+            mem(EAX, arg[1]);
+            jump_to_op(jcc[op - rop_jlt], arg[2]);
+            break;
+        }
+        case rop_call:
+            emit2(0x48, 0xB8);       /* mov rax, jit_return_limit */
+            emit8(jit_return_limit);
+            emit3(0x49, 0x39, 0xC4); /* cmp r12, rax */
+            emit2(0x72, 0x11);       /* jb (over the call) */
+            emit1(0xBF);             /* mov edi, RETURN_STACK_SIZE */
+            emit4(RETURN_STACK_SIZE);
+            call_helper(too_many_calls);
+            emit3(0x41, 0xC7, 0x04); /* mov dword [r12], the return address */
+            emit1(0x24);
+            emit4(loc + 2);
+            emit3(0x49, 0x83, 0xC4); /* add r12, 4 */
+            emit1(0x04);
+            continue_at(arg[0]);
+            break;
+        case rop_return:
+            emit3(0x49, 0x83, 0xEC); /* sub r12, 4 */
+            emit1(0x04);
+            emit3(0x41, 0x8B, 0x04); /* mov eax, [r12] */
+            emit1(0x24);
+            emit3(0x49, 0x8B, 0x4C); /* mov rcx, [r13 + rax * 8] */
+            emit2(0xC5, 0x00);
+            emit3(0x48, 0x85, 0xC9); /* test rcx, rcx */
+            emit2(0x74, 0x02);       /* je (over the next jmp) */
+            emit2(0xFF, 0xE1);       /* jmp rcx */
+            jump_to_offset(jit_exit_code);
+            break;
+        case rop_save:
+        case rop_restore:
+        case rop_clear:
+            emit3(0x48, 0x8D, 0xBB); /* lea rdi, [rbx + base] */
+            emit4(arg[0]);
+            if (op == rop_clear) {
+                emit2(0x31, 0xF6);   /* xor esi, esi */
+                emit1(0xBA);         /* mov edx, size */
+                emit4(arg[1]);
+                call_helper(memset);
+            }
+            else {
+                emit1(0xBE);         /* mov esi, size */
+                emit4(arg[1]);
+                call_helper(op == rop_save ? (void*) save_frame : (void*) restore_frame);
+            }
+            break;
+        case rop_printint:
+        case rop_printchar:
+            load(EDI, arg[0]);
+            call_helper(op == rop_printint ? (void*) jit_printint : (void*) jit_printchar);
+            break;
+        case rop_printfloat:
+            load_xmm(0, arg[0]);
+            call_helper(jit_printfloat);
+            break;
+        case rop_println:
+            call_helper(jit_println);
+            break;
+        case rop_halt:
+            emit1(0xB8);             /* mov eax, JIT_HALT */
+            emit4(JIT_HALT);
+            jump_to_offset(jit_exit_code);
+            break;
+        default:
+            return 0;
+    }
+    return 1;
+}
+
+#ifdef MAP_ANONYMOUS
+/* compile the k-th procedure of the register code */
+void compile(int k)
+{
+    unsigned int start = reg_proc_starts[k];
+    unsigned int end = k + 1 < num_of_reg_procs ? reg_proc_starts[k + 1] : reg_code_size;
+    /* a template takes at most 64 bytes per word of register code */
+    if (jit_buf_used + 64 * (size_t) (end - start) > jit_buf_size) {
+        jit_proc_state[k] = -1;
+        return;
+    }
+    if (mprotect(jit_buf, jit_buf_size, PROT_READ | PROT_WRITE) != 0) {
+        jit_proc_state[k] = -1;
+        return;
+    }
+    jit_labels = malloc((end - start + 1) * sizeof (size_t));
+    jit_fixups = malloc((end - start + 1) * sizeof (JitFixup));
+    if (jit_labels == NULL || jit_fixups == NULL) {
+        printf("malloc() failed\n");
+        exit(EXIT_FAILURE);
+    }
+    num_of_jit_fixups = 0;
+    for (unsigned int loc = start; loc < end; loc += rop_size(reg_code[loc])) {
+        jit_labels[loc - start] = jit_buf_used;
+        if (translate(loc)) {
+            jit_native[loc] = jit_buf + jit_labels[loc - start];
+        }
+        else {
+            /* let the interpreter run it (native code can't be entered here, but can jump here to stop) */
+            emit1(0xB8);         /* mov eax, loc */
+            emit4(loc);
+            jump_to_offset(jit_exit_code);
+        }
+    }
+    for (int i = 0; i < num_of_jit_fixups; i++) {
+        int rel = jit_labels[jit_fixups[i].target - start] - (jit_fixups[i].at + 4);
+        memcpy(jit_buf + jit_fixups[i].at, &rel, 4);
+    }
+    free(jit_labels);
+    free(jit_fixups);
+    if (mprotect(jit_buf, jit_buf_size, PROT_READ | PROT_EXEC) != 0) {
+        printf("mprotect() failed\n");
+        exit(EXIT_FAILURE);
+    }
+    jit_proc_state[k] = 1;
+}
+#else
+void compile(int k)
+{
+    jit_proc_state[k] = -1;
+}
+#endif
+
+void jit_init(unsigned int* limit)
+{
+    jit_return_limit = limit;
+    jit_native = calloc(reg_code_size + 1, sizeof (void*));
+    jit_counts = calloc(reg_code_size + 1, sizeof (unsigned int));
+    jit_proc_state = calloc(num_of_reg_procs + 1, 1);
+    if (jit_native == NULL || jit_counts == NULL || jit_proc_state == NULL) {
+        printf("calloc() failed\n");
+        exit(EXIT_FAILURE);
+    }
+#ifdef MAP_ANONYMOUS
+    jit_buf_size = (4096 + 64 * (size_t) reg_code_size + 4095) & ~(size_t) 4095;
+    jit_buf = mmap(NULL, jit_buf_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (jit_buf == MAP_FAILED) {
+        jit_buf = NULL;
+        jit_available = 0;
+        return;
+    }
+    write_entry_and_exit();
+    if (mprotect(jit_buf, jit_buf_size, PROT_READ | PROT_EXEC) != 0) {
+        jit_available = 0;
+    }
+#endif
+}
+
+void jit_count(unsigned int loc)
+{
+    if (++jit_counts[loc] != jit_threshold || !jit_available) {
+        return;
+    }
+    /* find the procedure that contains loc */
+    int k = num_of_reg_procs - 1;
+    while (reg_proc_starts[k] > loc) {
+        k--;
+    }
+    if (jit_proc_state[k] == 0) {
+        compile(k);
+    }
+}
+
+typedef unsigned int (*Entry)(void*, unsigned char*, unsigned int*, void**);
+
+unsigned int jit_run(unsigned int loc, unsigned char* data, unsigned int** rsp)
+{
+    unsigned int next = ((Entry) (void*) jit_buf)(jit_native[loc], data, *rsp, jit_native);
+    *rsp = jit_rsp;
+    return next;
+}
+
+void jit_print_stats(void)
+{
+    fprintf(stderr, "jit: %zu bytes of native code\n", jit_buf_used);
+    for (int k = 0; k < num_of_reg_procs; k++) {
+        if (jit_proc_state[k] != 0) {
+            fprintf(stderr, "jit: '%s' %s\n", reg_proc_names[k], jit_proc_state[k] == 1 ? "compiled" : "could not be compiled");
+        }
+    }
+}
+
+void jit_free(void)
+{
+#ifdef MAP_ANONYMOUS
+    if (jit_buf != NULL) {
+        munmap(jit_buf, jit_buf_size);
+    }
+#endif
+    free(jit_native);
+    free(jit_counts);
+    free(jit_proc_state);
+}
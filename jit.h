@@ -0,0 +1,41 @@
+#ifndef JIT_H
+#define JIT_H
+
+/*
+A template JIT for the register VM (see regvm.h), on x86-64 (--jit).
+
+The register code is interpreted (see run_jit() in vm.c) and every call and every loop backedge (a jump or branch
+backwards) is counted at its target. Once a target has been reached jit_threshold times, the whole procedure
+that contains it is translated into native code, one template per op, in an mmap'd buffer.
+
+Since the state of the register VM is entirely in memory (the register file, the return and save stacks), native code
+can be entered at any op of a compiled procedure (in particular, in the middle of a loop), and can hand control back
+to the interpreter at any op, just by giving it the location of that op. So
+    + the interpreter enters native code whenever it jumps, calls or returns to a compiled op;
+    + native code calls and returns through jit_native[], the native address of each compiled op,
+      and hands control back to the interpreter when the target is not compiled;
+    + an op that has no template (the logical and/or of two floats) is left to the interpreter:
+      native code stops right before it.
+Native code keeps the address of the register file in rbx, the return stack pointer in r12 and jit_native in r13.
+*/
+
+#define JIT_HALT 0xFFFFFFFFu /* returned by jit_run() when the program halts */
+
+extern int jit_available;        /* can native code be generated on this machine? */
+extern unsigned int jit_threshold; /* number of calls or backedges to a location before its procedure is compiled */
+extern void** jit_native;        /* jit_native[loc]: native code of the register op at reg_code[loc] (or NULL) */
+
+/* prepare to compile the register code (given the end of the return stack, to check for overflow) */
+void jit_init(unsigned int*);
+
+/* count a call or backedge to a location, and compile its procedure if it is hot enough */
+void jit_count(unsigned int);
+
+/* Run native code from the compiled op at a location, given the register file and the return stack pointer
+(which is updated); return the location of the op the interpreter should continue with, or JIT_HALT */
+unsigned int jit_run(unsigned int, unsigned char*, unsigned int**);
+
+void jit_print_stats(void); /* print the procedures compiled (on stderr) */
+void jit_free(void);
+
+#endif
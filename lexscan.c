@@ -0,0 +1,179 @@
+#include <stddef.h>
+#include "lexscan.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define LEX_X86
+#endif
+
+const char* lex_isa_names[3] = {"scalar", "sse2", "avx2"};
+int lex_max_isa = LEX_AVX2;
+int lex_isa = -1;
+
+/* the classes of chars, one char at a time (c is an unsigned char) */
+#define BLANK(c) ((c) == ' ' || ((c) >= '\t' && (c) <= '\r' && (c) != '\n'))
+#define DIGIT(c) ((c) >= '0' && (c) <= '9')
+#define WORD(c)  ((((c) | 0x20) >= 'a' && ((c) | 0x20) <= 'z') || DIGIT(c) || (c) == '_')
+#define NOT_EOL(c)  ((c) != '\n' && (c) != '\0')
+#define NOT_STAR(c) ((c) != '*' && (c) != '\0')
+
+/* a function that skips the chars of a class, one at a time */
+#define SCALAR_SKIP(name, in_class)                              \
+const char* name##_scalar(const char* p, const char* end)        \
+{                                                                \
+    while (p < end && in_class(*(const unsigned char*) p)) {     \
+        p++;                                                     \
+    }                                                            \
+    return p;                                                    \
+}
+
+SCALAR_SKIP(skip_blanks, BLANK)
+SCALAR_SKIP(skip_word, WORD)
+SCALAR_SKIP(skip_digits, DIGIT)
+SCALAR_SKIP(find_eol, NOT_EOL)
+SCALAR_SKIP(find_star, NOT_STAR)
+
+size_t count_lines_scalar(const char* p, const char* end, const char** last)
+{
+    size_t n = 0;
+    for (; p < end; p++) {
+        if (*p == '\n') {
+            n++;
+            *last = p + 1;
+        }
+    }
+    return n;
+}
+
+#ifdef LEX_X86
+
+/*
+The classes of chars, 16 at a time: each byte of the result is 0xFF if the char is in the class, and 0 otherwise.
+The comparisons are signed, so chars of 128 and more (negative) are never in a range of ASCII chars.
+*/
+#define SET16(c) _mm_set1_epi8(c)
+#define RANGE16(c, lo, hi) _mm_and_si128(_mm_cmpgt_epi8(c, SET16((lo) - 1)), _mm_cmpgt_epi8(SET16((hi) + 1), c))
+#define BLANK16(c) _mm_or_si128(_mm_cmpeq_epi8(c, SET16(' ')), \
+                                _mm_andnot_si128(_mm_cmpeq_epi8(c, SET16('\n')), RANGE16(c, '\t', '\r')))
+#define WORD16(c)  _mm_or_si128(_mm_or_si128(RANGE16(_mm_or_si128(c, SET16(0x20)), 'a', 'z'), RANGE16(c, '0', '9')), \
+                                _mm_cmpeq_epi8(c, SET16('_')))
+#define DIGIT16(c) RANGE16(c, '0', '9')
+#define NOT_EOL16(c)  _mm_xor_si128(_mm_or_si128(_mm_cmpeq_epi8(c, SET16('\n')), _mm_cmpeq_epi8(c, SET16(0))), SET16(-1))
+#define NOT_STAR16(c) _mm_xor_si128(_mm_or_si128(_mm_cmpeq_epi8(c, SET16('*')), _mm_cmpeq_epi8(c, SET16(0))), SET16(-1))
+
+/* a function that skips the chars of a class, 16 at a time (and the last few chars, one at a time) */
+#define SSE2_SKIP(name, in_class)                                                           \
+const char* name##_sse2(const char* p, const char* end)                                     \
+{                                                                                           \
+    while (end - p >= 16) {                                                                 \
+        __m128i c = _mm_loadu_si128((const __m128i*) p);                                    \
+        unsigned int out = ~_mm_movemask_epi8(in_class##16(c)) & 0xFFFF;                    \
+        if (out != 0) {                                                                     \
+            return p + __builtin_ctz(out);                                                  \
+        }                                                                                   \
+        p += 16;                                                                            \
+    }                                                                                       \
+    return name##_scalar(p, end);                                                           \
+}
+
+SSE2_SKIP(skip_blanks, BLANK)
+SSE2_SKIP(skip_word, WORD)
+SSE2_SKIP(skip_digits, DIGIT)
+SSE2_SKIP(find_eol, NOT_EOL)
+SSE2_SKIP(find_star, NOT_STAR)
+
+size_t count_lines_sse2(const char* p, const char* end, const char** last)
+{
+    size_t n = 0;
+    while (end - p >= 16) {
+        unsigned int nl = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*) p), SET16('\n')));
+        if (nl != 0) {
+            n += __builtin_popcount(nl);
+            *last = p + 32 - __builtin_clz(nl);
+        }
+        p += 16;
+    }
+    return n + count_lines_scalar(p, end, last);
+}
+
+/* the same, 32 at a time (AVX2 has no "less than": a < b is b > a) */
+#define SET32(c) _mm256_set1_epi8(c)
+#define RANGE32(c, lo, hi) _mm256_and_si256(_mm256_cmpgt_epi8(c, SET32((lo) - 1)), _mm256_cmpgt_epi8(SET32((hi) + 1), c))
+#define BLANK32(c) _mm256_or_si256(_mm256_cmpeq_epi8(c, SET32(' ')), \
+                                   _mm256_andnot_si256(_mm256_cmpeq_epi8(c, SET32('\n')), RANGE32(c, '\t', '\r')))
+#define WORD32(c)  _mm256_or_si256(_mm256_or_si256(RANGE32(_mm256_or_si256(c, SET32(0x20)), 'a', 'z'), RANGE32(c, '0', '9')), \
+                                   _mm256_cmpeq_epi8(c, SET32('_')))
+#define DIGIT32(c) RANGE32(c, '0', '9')
+#define NOT_EOL32(c)  _mm256_xor_si256(_mm256_or_si256(_mm256_cmpeq_epi8(c, SET32('\n')), _mm256_cmpeq_epi8(c, SET32(0))), SET32(-1))
+#define NOT_STAR32(c) _mm256_xor_si256(_mm256_or_si256(_mm256_cmpeq_epi8(c, SET32('*')), _mm256_cmpeq_epi8(c, SET32(0))), SET32(-1))
+
+/* (compiled for AVX2 whatever the flags of the build, but only called if the machine has it) */
+#define AVX2_SKIP(name, in_class)                                                           \
+__attribute__((target("avx2")))                                                             \
+const char* name##_avx2(const char* p, const char* end)                                     \
+{                                                                                           \
+    while (end - p >= 32) {                                                                 \
+        __m256i c = _mm256_loadu_si256((const __m256i*) p);                                 \
+        unsigned int out = ~(unsigned int) _mm256_movemask_epi8(in_class##32(c));           \
+        if (out != 0) {                                                                     \
+            return p + __builtin_ctz(out);                                                  \
+        }                                                                                   \
+        p += 32;                                                                            \
+    }                                                                                       \
+    return name##_sse2(p, end);                                                             \
+}
+
+AVX2_SKIP(skip_blanks, BLANK)
+AVX2_SKIP(skip_word, WORD)
+AVX2_SKIP(skip_digits, DIGIT)
+AVX2_SKIP(find_eol, NOT_EOL)
+AVX2_SKIP(find_star, NOT_STAR)
+
+__attribute__((target("avx2")))
+size_t count_lines_avx2(const char* p, const char* end, const char** last)
+{
+    size_t n = 0;
+    while (end - p >= 32) {
+        unsigned int nl = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*) p), SET32('\n')));
+        if (nl != 0) {
+            n += __builtin_popcount(nl);
+            *last = p + 32 - __builtin_clz(nl);
+        }
+        p += 32;
+    }
+    return n + count_lines_sse2(p, end, last);
+}
+
+#endif
+
+const char* (*lex_skip_blanks)(const char*, const char*);
+const char* (*lex_skip_word)(const char*, const char*);
+const char* (*lex_skip_digits)(const char*, const char*);
+const char* (*lex_find_eol)(const char*, const char*);
+const char* (*lex_find_star)(const char*, const char*);
+size_t (*lex_count_lines)(const char*, const char*, const char**);
+
+#define USE(isa)                               \
+    lex_skip_blanks = skip_blanks_##isa;       \
+    lex_skip_word = skip_word_##isa;           \
+    lex_skip_digits = skip_digits_##isa;       \
+    lex_find_eol = find_eol_##isa;             \
+    lex_find_star = find_star_##isa;           \
+    lex_count_lines = count_lines_##isa;
+
+void lex_init(void)
+{
+    lex_isa = LEX_SCALAR;
+    USE(scalar)
+#ifdef LEX_X86
+    if (lex_max_isa >= LEX_SSE2) {
+        lex_isa = LEX_SSE2; /* (SSE2 is part of x86-64) */
+        USE(sse2)
+    }
+    __builtin_cpu_init();
+    if (lex_max_isa >= LEX_AVX2 && __builtin_cpu_supports("avx2")) {
+        lex_isa = LEX_AVX2;
+        USE(avx2)
+    }
+#endif
+}
@@ -0,0 +1,49 @@
+#ifndef LEXSCAN_H
+#define LEXSCAN_H
+
+#include <stddef.h>
+
+/*
+Block scanning for the tokenizer: rather than going through next_char() one char at a time, the tokenizer
+finds the end of a run of chars of the same class (blanks, the chars of an identifier, digits, the body of a
+comment) with one of these functions, and then updates its line, column and count of chars at once.
+
+Each function takes the chars from p up to end and returns the first one that is not in its class (or end).
+There are three versions of each, picked once at runtime by lex_init():
+    scalar  one char at a time (any machine)
+    sse2    16 chars at a time (any x86-64)
+    avx2    32 chars at a time (x86-64 machines that have AVX2)
+Each char of a block is classified with a few comparisons, and the position of the first char that is out of
+the class is the number of trailing zeros of the inverted mask of the comparisons. The last, partial block is
+always scanned by the scalar version, so nothing past end is ever read (end can be the end of a mapped file).
+*/
+
+#define LEX_SCALAR 0
+#define LEX_SSE2   1
+#define LEX_AVX2   2
+
+extern const char* lex_isa_names[3];
+extern int lex_max_isa; /* the best instruction set that lex_init() may pick (--scan=<isa>; AVX2 by default) */
+extern int lex_isa;     /* the one it picked (-1 until lex_init() is called) */
+
+void lex_init(void);
+
+/* skip blanks: ' ', '\t', '\v', '\f' and '\r' (but not '\n', which is a token) */
+extern const char* (*lex_skip_blanks)(const char*, const char*);
+
+/* skip the chars of an identifier or keyword: letters, digits and '_' */
+extern const char* (*lex_skip_word)(const char*, const char*);
+
+/* skip digits */
+extern const char* (*lex_skip_digits)(const char*, const char*);
+
+/* find the end of a // comment: the next '\n' or '\0' */
+extern const char* (*lex_find_eol)(const char*, const char*);
+
+/* find the next '*' or '\0' in a slash-star comment */
+extern const char* (*lex_find_star)(const char*, const char*);
+
+/* count the '\n's from p up to end; if there are any, set *last to the char after the last one */
+extern size_t (*lex_count_lines)(const char*, const char*, const char**);
+
+#endif
@@ -0,0 +1,460 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "parser.h"
+#include "codegen.h"
+#include "optimizer.h"
+
+int use_peephole = 1;
+int use_superinstructions = 1;
+int print_stats = 0;
+
+/* The code being rewritten: the instructions of code[0..ip) are decoded into at[] and copied (or replaced) into out[] */
+int num_of_instrs;      /* number of instructions in the code array */
+unsigned int* at;       /* at[k]: location of the k-th instruction in the code array (at[num_of_instrs] = ip) */
+char* is_target;        /* is_target[loc]: can the instruction at code[loc] be reached from somewhere other than the previous one? */
+int* out;               /* the rewritten code */
+unsigned int out_ip;    /* number of words in out */
+unsigned int* new_loc;  /* new_loc[loc]: where the instruction at code[loc] (or whatever replaced it) starts in out */
+unsigned int instr_start; /* location in out of the instruction being emitted */
+unsigned int* fixups;   /* locations in out of the jump offsets and call addresses that still hold the old (absolute) target */
+unsigned int* fixup_instrs; /* fixup_instrs[f]: location in out of the instruction that fixups[f] belongs to */
+int num_of_fixups;
+
+/* the op and the arguments of the j-th instruction after the k-th one */
+#define OP(j)     code[at[k+(j)]]
+#define ARG(j, a) code[at[k+(j)]+1+(a)]
+
+void *opt_malloc(size_t size)
+{
+    void *p = malloc(size);
+    if (p == NULL) {
+        printf("malloc() failed\n");
+        exit(EXIT_FAILURE);
+    }
+    return p;
+}
+
+/* find the instructions and the locations that can be jumped to */
+void decode(void)
+{
+    at = opt_malloc((ip + 1) * sizeof (unsigned int));
+    is_target = calloc(ip + 1, 1);
+    if (is_target == NULL) {
+        printf("calloc() failed\n");
+        exit(EXIT_FAILURE);
+    }
+    num_of_instrs = 0;
+    for (unsigned int loc = 0; loc < ip; loc += op_size(code[loc])) {
+        at[num_of_instrs++] = loc;
+        unsigned char op = code[loc];
+        if (op_is_jump(op)) {
+            is_target[loc + code[loc + op_size(op) - 1]] = 1;
+        }
+        else if (op == op_call) {
+            is_target[code[loc + 1]] = 1;
+            is_target[loc + op_size(op)] = 1; /* (returned to) */
+        }
+    }
+    at[num_of_instrs] = ip;
+}
+
+/* can the n instructions starting from the k-th one be replaced (i.e., only the first one can be jumped to)? */
+int can_fuse(int k, int n)
+{
+    if (k + n > num_of_instrs) {
+        return 0;
+    }
+    for (int j = 0; j < n; j++) {
+        if (j > 0 && is_target[at[k+j]]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* emit an argument */
+void emit(int word)
+{
+    out[out_ip++] = word;
+}
+
+/* emit an op (i.e., start a new instruction) */
+void emit_op(unsigned char op)
+{
+    instr_start = out_ip;
+    emit(op);
+}
+
+/* emit the offset of a jump (or the address of a call) to the old location target, to be fixed up once the code is rewritten */
+void emit_target(unsigned int target)
+{
+    fixups[num_of_fixups] = out_ip;
+    fixup_instrs[num_of_fixups] = instr_start;
+    num_of_fixups++;
+    emit(target);
+}
+
+/* copy the k-th instruction to out */
+void copy(int k)
+{
+    unsigned char op = OP(0);
+    int size = op_size(op);
+    emit_op(op);
+    for (int a = 0; a < size - 1; a++) {
+        if (op_is_jump(op) && a == size - 2) {
+            emit_target(at[k] + ARG(0, a));
+        }
+        else if (op == op_call && a == 0) {
+            emit_target(ARG(0, a));
+        }
+        else {
+            emit(ARG(0, a));
+        }
+    }
+}
+
+/* Run a rewriting rule over the whole code array. The rule is given the index of an instruction; it either
+returns 0 (no match), or emits a replacement for some instructions starting from that one and returns how many it replaced.
+Return the number of replacements. */
+int rewrite(int (*rule)(int))
+{
+    decode();
+    out = opt_malloc((ip + 1) * sizeof (int));
+    new_loc = opt_malloc((ip + 1) * sizeof (unsigned int));
+    fixups = opt_malloc((num_of_instrs + 1) * sizeof (unsigned int));
+    fixup_instrs = opt_malloc((num_of_instrs + 1) * sizeof (unsigned int));
+    out_ip = 0;
+    num_of_fixups = 0;
+    int count = 0;
+    int k = 0;
+    while (k < num_of_instrs) {
+        unsigned int start = out_ip;
+        int n = rule(k);
+        if (n == 0) {
+            copy(k);
+            n = 1;
+        }
+        else {
+            count++;
+        }
+        /* every replaced instruction now starts where its replacement does */
+        for (int j = 0; j < n; j++) {
+            new_loc[at[k+j]] = start;
+        }
+        k += n;
+    }
+    new_loc[ip] = out_ip;
+
+    /* point jumps and calls to the new locations of their targets */
+    for (int f = 0; f < num_of_fixups; f++) {
+        unsigned int loc = fixups[f];
+        unsigned int instr = fixup_instrs[f];
+        unsigned int target = new_loc[out[loc]];
+        out[loc] = out[instr] == op_call ? target : target - instr;
+    }
+
+    /* the line table follows the code (the entries of code that was removed end up on the code that follows) */
+    int lines = 0;
+    for (int k = 0; k < num_of_lines; k++) {
+        unsigned int moved = new_loc[line_table[k].loc];
+        if (lines > 0 && line_table[lines - 1].loc == moved) {
+            lines--;
+        }
+        line_table[lines].loc = moved;
+        line_table[lines].line = line_table[k].line;
+        lines++;
+    }
+    num_of_lines = lines;
+
+    memcpy(code, out, out_ip * sizeof (int));
+    ip = out_ip;
+    free(out);
+    free(new_loc);
+    free(fixups);
+    free(fixup_instrs);
+    free(at);
+    free(is_target);
+    return count;
+}
+
+/* the jump that is taken when an integer comparison is true (negate: when it is false), or -1 if there is none */
+int compare_jump(unsigned char rel, int negate)
+{
+    switch (rel) {
+        case op_ilt: return negate ? op_jge : op_jlt;
+        case op_ile: return negate ? op_jgt : op_jle;
+        case op_igt: return negate ? op_jle : op_jgt;
+        case op_ige: return negate ? op_jlt : op_jge;
+        case op_ieq: return negate ? op_jne : op_jeq;
+        case op_ineq: return negate ? op_jeq : op_jne;
+        default:     return -1;
+    }
+}
+
+/* the same for comparing a variable with a constant (local: a variable in the frame) */
+int var_imm_jump(unsigned char rel, int negate, int local)
+{
+    switch (compare_jump(rel, negate)) {
+        case op_jlt: return local ? op_jlt_local_imm : op_jlt_var_imm;
+        case op_jle: return local ? op_jle_local_imm : op_jle_var_imm;
+        case op_jgt: return local ? op_jgt_local_imm : op_jgt_var_imm;
+        case op_jge: return local ? op_jge_local_imm : op_jge_var_imm;
+        default:     return -1;
+    }
+}
+
+/* peephole rules (the counts are reported by --stats) */
+enum {
+    PH_UNREACHABLE, PH_EXCH_EXCH, PH_CONV_BELOW, PH_CONV_CONST, PH_NEG_CONST, PH_PUSH_POP, PH_STOREI,
+    PH_CONST_COND, PH_JUMP_TO_JUMP, PH_JUMP_TO_NEXT, NUM_PEEPHOLE_RULES
+};
+const char* peephole_names[NUM_PEEPHOLE_RULES] = {
+    "unreachable code removed", "exch; exch removed", "conversions below a push moved before it",
+    "constants converted", "constants negated", "push x; pop x removed", "pushi; pop fused into storei",
+    "constant conditions resolved", "jumps to jumps threaded", "jumps to the next op removed",
+};
+int peephole_count[NUM_PEEPHOLE_RULES];
+
+/* If the k-th instruction starts a push of a single value that does not depend on the stack
+(a push, optionally followed by a conversion of the pushed value), return the number of its instructions; otherwise 0. */
+int pure_push(int k)
+{
+    if (k >= num_of_instrs || (OP(0) != op_push && OP(0) != op_fpush && OP(0) != op_push_local && OP(0) != op_pushi && OP(0) != op_fpushi)) {
+        return 0;
+    }
+    if (k + 1 < num_of_instrs && (OP(1) == op_conv_to_float || OP(1) == op_conv_to_int)) {
+        return 2;
+    }
+    return 1;
+}
+
+int unconditional(unsigned char op)
+{
+    return op == op_jmp || op == op_return || op == op_halt;
+}
+
+int peephole(int k)
+{
+    int n;
+    /* nothing after a jmp, return or halt is executed until the next location that can be jumped to */
+    if (k > 0 && unconditional(code[at[k-1]]) && !is_target[at[k]]) {
+        n = 1;
+        while (k + n < num_of_instrs && !is_target[at[k+n]]) {
+            n++;
+        }
+        peephole_count[PH_UNREACHABLE]++;
+        return n;
+    }
+    /* exch; exch  =>  (nothing) */
+    if (can_fuse(k, 2) && OP(0) == op_exch && OP(1) == op_exch) {
+        peephole_count[PH_EXCH_EXCH]++;
+        return 2;
+    }
+    /* <push>; exch; conv_to_float; exch  =>  conv_to_float; <push>
+    (combine() converts the item below the top this way, e.g., for the first operand of i < 1.5) */
+    n = pure_push(k);
+    if (n > 0 && can_fuse(k, n + 3) && OP(n) == op_exch
+        && (OP(n+1) == op_conv_to_float || OP(n+1) == op_conv_to_int) && OP(n+2) == op_exch) {
+        emit_op(OP(n+1));
+        for (int j = 0; j < n; j++) {
+            copy(k + j);
+        }
+        peephole_count[PH_CONV_BELOW]++;
+        return n + 3;
+    }
+    /* pushi c; conv_to_float  =>  fpushi (float) c */
+    if (can_fuse(k, 2) && OP(0) == op_pushi && OP(1) == op_conv_to_float) {
+        float f = ARG(0, 0);
+        int bits;
+        memcpy(&bits, &f, sizeof f);
+        emit_op(op_fpushi);
+        emit(bits);
+        peephole_count[PH_CONV_CONST]++;
+        return 2;
+    }
+    /* pushi c; neg  =>  pushi -c (and the same for fpushi; fneg) */
+    if (can_fuse(k, 2) && OP(0) == op_pushi && OP(1) == op_neg) {
+        emit_op(op_pushi);
+        emit((int) (0u - (unsigned int) ARG(0, 0))); /* wraps around like neg does */
+        peephole_count[PH_NEG_CONST]++;
+        return 2;
+    }
+    if (can_fuse(k, 2) && OP(0) == op_fpushi && OP(1) == op_fneg) {
+        float f;
+        int bits;
+        memcpy(&f, &ARG(0, 0), sizeof f);
+        f = -f;
+        memcpy(&bits, &f, sizeof f);
+        emit_op(op_fpushi);
+        emit(bits);
+        peephole_count[PH_NEG_CONST]++;
+        return 2;
+    }
+    /* push x; pop x  =>  (nothing) */
+    if (can_fuse(k, 2) && ((OP(0) == op_push && OP(1) == op_pop) || (OP(0) == op_fpush && OP(1) == op_fpop)
+                           || (OP(0) == op_push_local && OP(1) == op_pop_local))
+        && ARG(0, 0) == ARG(1, 0)) {
+        peephole_count[PH_PUSH_POP]++;
+        return 2;
+    }
+    /* pushi c; pop a  =>  storei a c (the bits are stored as they are, so fpushi c; fpop a is the same) */
+    if (can_fuse(k, 2) && ((OP(0) == op_pushi && OP(1) == op_pop) || (OP(0) == op_fpushi && OP(1) == op_fpop))) {
+        emit_op(op_storei);
+        emit(ARG(1, 0));
+        emit(ARG(0, 0));
+        peephole_count[PH_STOREI]++;
+        return 2;
+    }
+    if (can_fuse(k, 2) && (OP(0) == op_pushi || OP(0) == op_fpushi) && OP(1) == op_pop_local) {
+        emit_op(op_storei_local);
+        emit(ARG(1, 0));
+        emit(ARG(0, 0));
+        peephole_count[PH_STOREI]++;
+        return 2;
+    }
+    /* pushi c; jfalse off  =>  jmp off (if c is false) or nothing (if c is true); and the same for the other conditional jumps */
+    if (can_fuse(k, 2) && (OP(0) == op_pushi || OP(0) == op_fpushi)
+        && (OP(1) == op_jfalse || OP(1) == op_jtrue || OP(1) == op_ijfalse || OP(1) == op_ijtrue)) {
+        int is_false;
+        if (OP(1) == op_jfalse || OP(1) == op_jtrue) {
+            float f;
+            memcpy(&f, &ARG(0, 0), sizeof f); /* the condition is tested as a float, like jfalse does */
+            is_false = f == 0;
+        }
+        else {
+            is_false = ARG(0, 0) == 0;
+        }
+        if (is_false == (OP(1) == op_jfalse || OP(1) == op_ijfalse)) {
+            emit_op(op_jmp);
+            emit_target(at[k+1] + ARG(1, 0));
+        }
+        peephole_count[PH_CONST_COND]++;
+        return 2;
+    }
+    if (k < num_of_instrs && (OP(0) == op_jmp || OP(0) == op_jfalse || OP(0) == op_jtrue || OP(0) == op_ijfalse || OP(0) == op_ijtrue)) {
+        unsigned int target = at[k] + ARG(0, 0);
+        /* a jump to the next op only has to drop the condition (if it has one) */
+        if (target == at[k+1]) {
+            if (OP(0) != op_jmp) {
+                emit_op(op_remove);
+            }
+            peephole_count[PH_JUMP_TO_NEXT]++;
+            return 1;
+        }
+        /* a jump to a jmp can jump to where that jmp goes instead
+        (giving up on loops of jmps, which would never end anyway) */
+        unsigned int final = target;
+        for (int hops = 0; hops < 8 && code[final] == op_jmp; hops++) {
+            unsigned int next = final + code[final + 1];
+            if (next == final || next == at[k]) {
+                break;
+            }
+            final = next;
+        }
+        if (final != target) {
+            emit_op(OP(0));
+            emit_target(final);
+            peephole_count[PH_JUMP_TO_JUMP]++;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int superinstruction(int k)
+{
+    /* (each of these has a local version, for variables in the frame: push_local instead of push, and so on) */
+    int local = k < num_of_instrs && OP(0) == op_push_local;
+    /* push a; pushi k; add; pop a  =>  inc a k */
+    if (can_fuse(k, 4) && (OP(0) == op_push || local) && OP(1) == op_pushi && (OP(2) == op_add || OP(2) == op_sub)
+        && OP(3) == (local ? op_pop_local : op_pop) && ARG(0, 0) == ARG(3, 0)) {
+        emit_op(local ? op_inc_local : op_inc);
+        emit(ARG(0, 0));
+        emit(OP(2) == op_add ? ARG(1, 0) : (int) (0u - (unsigned int) ARG(1, 0))); /* (x - INT_MIN wraps around like sub does) */
+        return 4;
+    }
+    /* pushi size; mul; pushi base; add; get  =>  load_elem base size (local_addr base: load_local_elem) */
+    if (can_fuse(k, 4) && OP(0) == op_pushi && OP(1) == op_mul && (OP(2) == op_pushi || OP(2) == op_local_addr) && OP(3) == op_add) {
+        int n = 4;
+        local = OP(2) == op_local_addr;
+        if (can_fuse(k, 5) && OP(4) == op_get) {
+            emit_op(local ? op_load_local_elem : op_load_elem);
+            n = 5;
+        }
+        else if (can_fuse(k, 5) && OP(4) == op_fget) {
+            emit_op(local ? op_fload_local_elem : op_fload_elem);
+            n = 5;
+        }
+        else {
+            emit_op(local ? op_local_elem_addr : op_elem_addr); /* the address is used by a put instead */
+        }
+        emit(ARG(2, 0));
+        emit(ARG(0, 0));
+        return n;
+    }
+    /* push a; add  =>  add_var a (and the same for mul) */
+    if (can_fuse(k, 2) && (OP(0) == op_push || local) && (OP(1) == op_add || OP(1) == op_mul)) {
+        if (local) {
+            emit_op(OP(1) == op_add ? op_add_local : op_mul_local);
+        }
+        else {
+            emit_op(OP(1) == op_add ? op_add_var : op_mul_var);
+        }
+        emit(ARG(0, 0));
+        return 2;
+    }
+    /* push a; pushi k; ilt; ijfalse off  =>  jge_var_imm a k off */
+    if (can_fuse(k, 4) && (OP(0) == op_push || local) && OP(1) == op_pushi
+        && var_imm_jump(OP(2), 0, local) != -1 && (OP(3) == op_ijfalse || OP(3) == op_ijtrue)) {
+        emit_op(var_imm_jump(OP(2), OP(3) == op_ijfalse, local));
+        emit(ARG(0, 0));
+        emit(ARG(1, 0));
+        emit_target(at[k+3] + ARG(3, 0));
+        return 4;
+    }
+    /* ilt; ijfalse off  =>  jge off */
+    if (can_fuse(k, 2) && compare_jump(OP(0), 0) != -1 && (OP(1) == op_ijfalse || OP(1) == op_ijtrue)) {
+        emit_op(compare_jump(OP(0), OP(1) == op_ijfalse));
+        emit_target(at[k+1] + ARG(1, 0));
+        return 2;
+    }
+    return 0;
+}
+
+/* the number of passes after which the peephole rules give up on reaching a fixpoint */
+#define MAX_PEEPHOLE_PASSES 16
+
+void optimize(void)
+{
+    unsigned int size = ip;
+    if (use_peephole) {
+        int passes = 0, rewrites = 0, n;
+        do {
+            n = rewrite(peephole);
+            rewrites += n;
+            passes++;
+        } while (n > 0 && passes < MAX_PEEPHOLE_PASSES);
+        if (print_stats) {
+            fprintf(stderr, "peephole: %i rewrites in %i passes, code size %u -> %u words (%u bytes saved)\n",
+                    rewrites, passes, size, ip, (size - ip) * (unsigned int) sizeof (int));
+            for (int r = 0; r < NUM_PEEPHOLE_RULES; r++) {
+                if (peephole_count[r] > 0) {
+                    fprintf(stderr, "%10i %s\n", peephole_count[r], peephole_names[r]);
+                }
+            }
+        }
+    }
+    unsigned int peephole_size = ip;
+    if (use_superinstructions) {
+        int fused = rewrite(superinstruction);
+        if (print_stats) {
+            fprintf(stderr, "superinstructions: %i sequences fused, code size %u -> %u words (%u bytes saved)\n",
+                    fused, peephole_size, ip, (peephole_size - ip) * (unsigned int) sizeof (int));
+        }
+    }
+    if (print_stats) {
+        fprintf(stderr, "code size: %u -> %u words (%u -> %u bytes, %u bytes saved)\n", size, ip,
+                size * (unsigned int) sizeof (int), ip * (unsigned int) sizeof (int), (size - ip) * (unsigned int) sizeof (int));
+    }
+}
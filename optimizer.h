@@ -0,0 +1,35 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+/*
+Optimizations over the code array, run after the parser has generated all of the code (see parse()).
+
+First, peephole rules clean up what the parser generates without looking back, e.g.
+    fpushi 1.5; exch; conv_to_float; exch                 =>  conv_to_float; fpushi 1.5    (for i < 1.5)
+    pushi 5; pop x                                        =>  storei x 5                   (for int x = 5;)
+    pushi 2; neg                                          =>  pushi -2
+    push x; pop x                                         =>  (nothing)
+and remove jumps to the next op, jumps to jumps and code that can never be reached.
+They are applied over and over until none of them matches any more.
+
+Even then, the same few sequences of ops come up over and over again, e.g.
+    push i; pushi 1; add; pop i                        for i = i + 1;
+    pushi 4; mul; pushi 16; add; get                   for reading a[<index>] (an int array at address 16)
+    push i; pushi 4; ilt; ijfalse                      for the condition of while (i < 4)
+Running `./a.out --profile <file>` shows which pairs of ops are executed most often.
+The most frequent sequences are fused into single superinstructions (op_inc, op_load_elem, op_jge_var_imm, ...;
+see parser.h), which do the same work with one dispatch; the locals of procedures (push_local...) have their own
+(op_inc_local, op_load_local_elem, op_jge_local_imm, ...).
+
+A sequence is only replaced if none of its ops but the first can be jumped to (or returned to, after a call).
+Since the code shrinks, jump offsets and call addresses are all updated to the new positions of their targets.
+*/
+
+extern int use_peephole; /* apply the peephole rules? (on by default) */
+extern int use_superinstructions; /* fuse common sequences of ops? (on by default) */
+extern int print_stats; /* report the size of the code before and after each optimization on stderr? */
+
+/* run the enabled optimizations over code[0..ip) (ip is updated to the new size of the code) */
+void optimize(void);
+
+#endif
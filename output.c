@@ -0,0 +1,162 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "output.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <errno.h>
+#include <unistd.h>
+#define OUTPUT_WRITE
+#endif
+
+char output_buf[OUTPUT_BUF_SIZE];
+unsigned int output_len = 0;
+int output_line_buffered = 0;
+
+void output_init(void)
+{
+    static int registered = 0;
+    fflush(stdout);
+    if (!registered) {
+        atexit(output_flush);
+        registered = 1;
+    }
+}
+
+void output_flush(void)
+{
+#ifdef OUTPUT_WRITE
+    unsigned int done = 0;
+    while (done < output_len) {
+        ssize_t n = write(STDOUT_FILENO, output_buf + done, output_len - done);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break; /* (like stdio, drop what can't be written) */
+        }
+        done += n;
+    }
+#else
+    fwrite(output_buf, 1, output_len, stdout);
+    fflush(stdout);
+#endif
+    output_len = 0;
+}
+
+/* the decimal digits of 0 to 99, two by two */
+const char digit_pairs[201] =
+    "00010203040506070809" "10111213141516171819" "20212223242526272829" "30313233343536373839" "40414243444546474849"
+    "50515253545556575859" "60616263646566676869" "70717273747576777879" "80818283848586878889" "90919293949596979899";
+
+/* write the decimal digits of n to s; return their number */
+int format_unsigned(char* s, unsigned long long n)
+{
+    char digits[20];
+    char* p = digits + 20; /* the digits are written backwards, two at a time */
+    while (n >= 100) {
+        unsigned int pair = n % 100;
+        n /= 100;
+        p -= 2;
+        memcpy(p, digit_pairs + 2 * pair, 2);
+    }
+    if (n >= 10) {
+        p -= 2;
+        memcpy(p, digit_pairs + 2 * n, 2);
+    }
+    else {
+        *--p = '0' + n;
+    }
+    int len = digits + 20 - p;
+    memcpy(s, p, len);
+    return len;
+}
+
+int format_int(char* s, int i)
+{
+    if (i < 0) {
+        *s = '-';
+        return 1 + format_unsigned(s + 1, -(unsigned int) i);
+    }
+    return format_unsigned(s, i);
+}
+
+/*
+A float is m * 2^e, with an integer m < 2^24. For %f, it has to be rounded to a multiple of 10^-6, i.e.,
+m * 10^6 * 2^e to an integer, and when e < 0, that's m * 10^6 (< 2^44) shifted right by -e, rounded
+to nearest, ties to even, like printf does. Then the quotient by 10^6 is the integer part, and the remainder
+the 6 decimals. Only floats of 2^63 and more (and infinities and NaNs) are left to snprintf().
+*/
+int format_float(char* s, float f)
+{
+    unsigned int bits;
+    memcpy(&bits, &f, 4);
+    int biased = (bits >> 23) & 0xFF;
+    unsigned long long m = bits & 0x7FFFFF;
+    int e;
+    if (biased == 0) {
+        e = -149; /* a subnormal float */
+    }
+    else {
+        m |= 1 << 23;
+        e = biased - 150;
+    }
+    if (biased == 0xFF || e > 39) {
+        return snprintf(s, OUTPUT_FLOAT_MAX, "%f", f);
+    }
+    unsigned long long whole, micros;
+    if (e >= 0) {
+        whole = m << e;
+        micros = 0;
+    }
+    else {
+        unsigned long long scaled = m * 1000000;
+        unsigned long long q = 0;
+        if (-e < 45) { /* (otherwise, scaled < 2^44 is less than half of 2^-e, and the result is 0) */
+            int k = -e;
+            unsigned long long r = scaled & ((1ULL << k) - 1);
+            unsigned long long half = 1ULL << (k - 1);
+            q = scaled >> k;
+            if (r > half || (r == half && (q & 1))) {
+                q++;
+            }
+        }
+        whole = q / 1000000;
+        micros = q % 1000000;
+    }
+    int len = 0;
+    if (bits >> 31) {
+        s[len++] = '-';
+    }
+    len += format_unsigned(s + len, whole);
+    s[len++] = '.';
+    unsigned int hi = micros / 10000, mid = micros / 100 % 100, lo = micros % 100;
+    memcpy(s + len, digit_pairs + 2 * hi, 2);
+    memcpy(s + len + 2, digit_pairs + 2 * mid, 2);
+    memcpy(s + len + 4, digit_pairs + 2 * lo, 2);
+    return len + 6;
+}
+
+void output_int(int i)
+{
+    if (output_len + 11 > OUTPUT_BUF_SIZE) {
+        output_flush();
+    }
+    output_len += format_int(output_buf + output_len, i);
+}
+
+void output_float(float f)
+{
+    if (output_len + OUTPUT_FLOAT_MAX > OUTPUT_BUF_SIZE) {
+        output_flush();
+    }
+    output_len += format_float(output_buf + output_len, f);
+}
+
+void output_newline(void)
+{
+    OUTPUT_CHAR('\n');
+    if (output_line_buffered) {
+        output_flush();
+    }
+}
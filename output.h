@@ -0,0 +1,38 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+/*
+The output of the program being run: the print ops of every engine append their text to a buffer owned by the VM,
+which is written to stdout with write(2) (no stdio locking, and one system call per OUTPUT_BUF_SIZE bytes)
+    + when the buffer is full,
+    + when the program halts,
+    + after every newline, in line-buffered mode (--line-buffered, and by default when stdout is a terminal),
+    + when the VM exits (e.g., on a runtime error, before the error message, which goes through stdio).
+Anything printed with stdio before the program runs is flushed by output_init(), so the order is kept.
+Numbers are converted by format_int() and format_float() (two digits at a time, with no printf),
+which give exactly the same text as printf (see bench/format_bench.c).
+*/
+
+#define OUTPUT_BUF_SIZE 65536
+
+extern char output_buf[OUTPUT_BUF_SIZE];
+extern unsigned int output_len;   /* number of bytes in output_buf */
+extern int output_line_buffered;  /* flush after every newline? */
+
+/* append a char to the output */
+#define OUTPUT_CHAR(c) { if (output_len == OUTPUT_BUF_SIZE) output_flush(); output_buf[output_len++] = (c); }
+
+void output_init(void);  /* flush stdout, and make sure the output is written when the VM exits */
+void output_flush(void); /* write the buffer to stdout */
+
+void output_int(int);     /* like printf("%i") */
+void output_float(float); /* like printf("%f") */
+void output_newline(void);
+
+#define OUTPUT_FLOAT_MAX 64 /* %f of a float takes at most 47 chars: a sign, 39 digits, a point and 6 decimals */
+
+/* write the text of printf("%i") or printf("%f") to a buffer (with no '\0'); return its length */
+int format_int(char*, int);
+int format_float(char*, float);
+
+#endif
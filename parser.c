@@ -1,58 +1,30 @@
 #include "parser.h"
 #include "tokenizer.h"
 #include "symtab.h"
+#include "intern.h"
+#include "ir.h"
+#include "codegen.h"
+#include "regvm.h"
+#include "optimizer.h"
+#include "trace.h"
 
-unsigned int ip = 0;       /* instruction pointer */
+char* sourcefile;          /* path of the source file to compile */
+int trace_level = TRACE_BYTES; /* how much of the compiler's work to print (see trace.h) */
 unsigned int dp = 0;       /* data pointer = number of bytes to later allocate to data array */
-token* toks;               /* list of tokens from tokenizer */
+int frame_size = 0;        /* number of bytes of the frame of the procedure being parsed so far (its params and locals) */
 token curtoken;            /* current token being processed */
-SymbolTableStack symtabs;  /* a stack of symbol tables to work with */
 int inside_switch = 0;     /* indicates whether case and default labels may be used */
-
-void gen_op(unsigned char op)
-{
-    code[ip++] = op;
-}
-
-void gen_addr(int addr)
-{
-    /* write the given integer to the next 4 bytes of the code array */
-    code[ip++] = (addr >> 24) & 0xFF;
-    code[ip++] = (addr >> 16) & 0xFF;
-    code[ip++] = (addr >> 8)  & 0xFF;
-    code[ip++] = addr         & 0xFF;
-}
-
-void gen_addr_rel(int addr, unsigned int loc)
-{
-    code[loc++] = (addr >> 24) & 0xFF;
-    code[loc++] = (addr >> 16) & 0xFF;
-    code[loc++] = (addr >> 8)  & 0xFF;
-    code[loc++] = addr         & 0xFF;
-
-}
-
-void gen_int(int i)
-{
-    gen_addr(i);
-}
-
-void gen_float(float f)
-{
-    /* write the given float to the next 4 bytes of the code array */
-    for (int i = 0; i < 4; i++) {
-        code[ip++] = *((unsigned char*) &f + i);
-    }
-}
+Program program;           /* the syntax tree being built */
+Proc** procs_tail = &program.procs; /* where to append the next procedure */
 
 void gettoken(void)
 {
-    toks++;
+    pop_token();
     /* skip EOL */
-    while (toks[0].type == TK_EOL) {
-        toks++;
+    while (peek_token(0)->type == TK_EOL) {
+        pop_token();
     }
-    curtoken = toks[0]; /* update curtoken */
+    curtoken = *peek_token(0); /* update curtoken */
 }
 
 void match(TokenType t) 
@@ -77,20 +49,16 @@ void error(void)
     exit(EXIT_FAILURE);
 }
 
+
 Type combine(Type type1, Type type2, Type op)
 {
     if (op == TK_PLUS || op == TK_MINUS || op == TK_MULT || op == TK_DIV) {
         if (type1 == TK_INT || type1 == TK_CHAR) {
             if (type2 == TK_INT || type2 == TK_CHAR) {
-                //printf("I (+-*/) I\n");
                 return TK_INT;
             }
             else if (type2 == TK_REAL) {
-                printf("I (+-*/) R -> (i) exchange, (ii) conv to real, (iii) exchange\n");
-                gen_op(op_exch);
-                gen_op(op_conv_to_float);
-                gen_op(op_exch);
-                return TK_REAL;
+                return TK_REAL; /* I op R: the first operand is converted to a real */
             }
             else {
                 printf("type mismatch on line %i in one of these operators: + - * /\n", curtoken.line);
@@ -99,13 +67,10 @@ Type combine(Type type1, Type type2, Type op)
         }
         else if (type1 == TK_REAL) {
             if (type2 == TK_REAL) {
-                //printf("R (+-*/) R\n");
                 return TK_REAL;
             }
             else if (type2 == TK_INT || type2 == TK_CHAR) {
-                printf("R (+-*/) I -> (i) conv to real\n");
-                gen_op(op_conv_to_float);
-                return TK_REAL;
+                return TK_REAL; /* R op I: the second operand is converted to a real */
             }
             else {
                 printf("type mismatch on line %i in one of these operators: + - * /\n", curtoken.line);
@@ -122,42 +87,15 @@ Type combine(Type type1, Type type2, Type op)
             printf("type mismatch on line %i in operator %%\n", curtoken.line);
             exit(EXIT_FAILURE);
         }
+        return TK_INT;
     }
     else {
-        /*  %, ||, &&, ==, !=, <, <=, >, >=   */
-        if (type1 == TK_INT || type1 == TK_CHAR) {
-            if (type2 == TK_INT || type2 == TK_CHAR) {
-                printf("I (||&&==!=<<=>>=) I -> (i) conv to real, (ii) exchange, (iii) conv to real, (iv) exchange\n");
-                gen_op(op_conv_to_float);
-                gen_op(op_exch);
-                gen_op(op_conv_to_float);
-                gen_op(op_exch);
-            }
-            else if (type2 == TK_REAL) {
-                printf("I (||&&==!=<<=>>=) R -> (i) exchange, (ii) conv to real, (iii) exchange\n");
-                gen_op(op_exch);
-                gen_op(op_conv_to_float);
-                gen_op(op_exch);
-            }
-            else {
-                printf("type mismatch on line %i in one of these operators: || && == != < <= > >=\n", curtoken.line);
-                exit(EXIT_FAILURE);
-            }
-        }
-        else if (type1 == TK_REAL) {
-            if (type2 == TK_REAL) {
-                //printf("R (||&&==!=<<=>>=) R\n");
-            }
-            else if (type2 == TK_INT || type2 == TK_CHAR) {
-                printf("R (||&&==!=<<=>>=) I -> (i) conv to real\n");
-                gen_op(op_conv_to_float);
-            }
-            else {
-                printf("type mismatch on line %i in one of these operators: || && == != < <= > >=\n", curtoken.line);
-                exit(EXIT_FAILURE);
-            }
+        /*  ||, &&, ==, !=, <, <=, >, >=  (I R and R I: the int operand is converted to a real) */
+        if (type1 != TK_INT && type1 != TK_CHAR && type1 != TK_REAL) {
+            printf("type mismatch on line %i in one of these operators: || && == != < <= > >=\n", curtoken.line);
+            exit(EXIT_FAILURE);
         }
-        else {
+        if (type2 != TK_INT && type2 != TK_CHAR && type2 != TK_REAL) {
             printf("type mismatch on line %i in one of these operators: || && == != < <= > >=\n", curtoken.line);
             exit(EXIT_FAILURE);
         }
@@ -165,11 +103,40 @@ Type combine(Type type1, Type type2, Type op)
     }
 }
 
+Expr* binary(Type op, Expr* left, Expr* right)
+{
+    Type t = combine(left->type, right->type, op);
+    if (left->type == TK_REAL || right->type == TK_REAL) {
+        left = ast_conv(left, TK_REAL);
+        right = ast_conv(right, TK_REAL);
+    }
+    return ast_binary(op, t, left, right);
+}
+
+void add_stmt(StmtList* list, Stmt* s)
+{
+    if (s == NULL) {
+        return;
+    }
+    if (list->first == NULL) {
+        list->first = s;
+    }
+    else {
+        list->last->next = s;
+    }
+    /* s may be the first of several statements */
+    while (s->next != NULL) {
+        s = s->next;
+    }
+    list->last = s;
+}
+
 void G(void)
 {
+    StmtList init = {NULL, NULL};
     while (curtoken.type != TK_EOF) {
         if (curtoken.type == TK_int || curtoken.type == TK_float || curtoken.type == TK_char) {
-            declaration();
+            add_stmt(&init, declaration());
         }
         else if (curtoken.type == TK_void) {
             procedure_definition();
@@ -179,265 +146,147 @@ void G(void)
         }
     }
     match(TK_EOF);
+    program.init = ast_stmt(ST_BLOCK, 0);
+    program.init->body = init.first;
 }
 
-Type O(void)
+Expr* O(void)
 {
-    Type t1, t2;
-    t1 = A();
+    Expr* e = A();
     while (curtoken.type == TK_OR) {
         gettoken();
-        t2 = A();
-        t1 = combine(t1, t2, TK_OR);
-        printf("or\n");
-        gen_op(op_or);
+        e = binary(TK_OR, e, A());
     }
-    return t1;
+    return e;
 }
 
-Type A(void)
+Expr* A(void)
 {
-    Type t1, t2;
-    t1 = Q();
+    Expr* e = Q();
     while (curtoken.type == TK_AND) {
         gettoken();
-        t2 = Q();
-        t1 = combine(t1, t2, TK_AND);
-        printf("and\n");
-        gen_op(op_and);
+        e = binary(TK_AND, e, Q());
     }
-    return t1;
+    return e;
 }
 
-Type Q(void)
+Expr* Q(void)
 {
-    Type t1, t2;
-    t1 = R();
+    Expr* e = R();
     while (curtoken.type == TK_EQ || curtoken.type == TK_NEQ) {
         int op_type = curtoken.type;
         gettoken();
-        t2 = R();
-        t1 = combine(t1, t2, op_type);
-        printf("eq\n");
-        gen_op(op_eq);
+        e = binary(op_type, e, R());
     }
-    return t1;
+    return e;
 }
 
-Type R(void)
+Expr* R(void)
 {
-    Type t1, t2;
-    t1 = E();
+    Expr* e = E();
     while (curtoken.type == TK_LESS || curtoken.type == TK_LESS_EQ ||
            curtoken.type == TK_GREATER || curtoken.type == TK_GREATER_EQ) {
         int op_type = curtoken.type;
         gettoken();
-        t2 = E();
-        t1 = combine(t1, t2, op_type);
-        if (op_type == TK_LESS) {
-            printf("less\n");
-            gen_op(op_less);
-        }
-        else if (op_type == TK_GREATER) {
-            printf("greater\n");
-            gen_op(op_greater);
-        }
-        else if (op_type == TK_LESS_EQ) {
-            printf("less-eq\n");
-            gen_op(op_leq);
-        }
-        else {
-            printf("greater-eq\n");
-            gen_op(op_geq);
-        }
+        e = binary(op_type, e, E());
     }
-    return t1;
+    return e;
 }
 
-Type E(void)
+Expr* E(void)
 {
-    Type t1, t2;
-    t1 = T();
+    Expr* e = T();
     while (curtoken.type == TK_PLUS || curtoken.type == TK_MINUS) {
         int op_type = curtoken.type;
         gettoken();
-        t2 = T();
-        t1 = combine(t1, t2, op_type);
-        if (op_type == TK_PLUS) {
-            if (t1 == TK_INT) {
-                printf("add\n");
-                gen_op(op_add);
-            }
-            else {
-                printf("fadd\n");
-                gen_op(op_fadd);
-            }
-        }
-        else {
-            if (t1 == TK_INT) {
-                printf("sub\n");
-                gen_op(op_sub);
-            }
-            else {
-                printf("fsub\n");
-                gen_op(op_fsub);
-            }
-        }
+        e = binary(op_type, e, T());
     }
-    return t1;
+    return e;
 }
 
-Type T(void)
+Expr* T(void)
 {
-    Type t1, t2;
-    t1 = F();
+    Expr* e = F();
     while (curtoken.type == TK_MULT || curtoken.type == TK_DIV || curtoken.type == TK_MOD) {
         int op_type = curtoken.type;
         gettoken();
-        t2 = F();
-        t1 = combine(t1, t2, op_type);
-        if (op_type == TK_MULT) {
-            if (t1 == TK_INT) {
-                printf("mul\n");
-                gen_op(op_mul);
-            }
-            else {
-                printf("fmul\n");
-                gen_op(op_fmul);
-            }
-        }
-        else if (op_type == TK_DIV) {
-            if (t1 == TK_INT) {
-                printf("div\n");
-                gen_op(op_div);
-            }
-            else {
-                printf("fdiv\n");
-                gen_op(op_fdiv);
-            }
-        }
-        else {
-            printf("mod\n");
-            gen_op(op_mod);
-        }
+        e = binary(op_type, e, F());
     }
-    return t1;
+    return e;
 }
 
-Type F(void)
+Expr* F(void)
 {
-    Type t;
+    Expr* e;
     if (curtoken.type == TK_PLUS) {
         // F ::= + F
         gettoken();
-        t = F();
+        e = F();
         /* generate no instruction, but check whether the argument is of the right type */
-        if (t != TK_INT && t != TK_CHAR && t != TK_REAL) {
+        if (e->type != TK_INT && e->type != TK_CHAR && e->type != TK_REAL) {
             printf("error: invalid operand type for unary plus (line %i)\n", curtoken.line);
             exit(EXIT_FAILURE);
         }
     }
     else if (curtoken.type == TK_MINUS) {
         // F ::= - F
-        gettoken(); 
-        t = F();
-        if (t == TK_INT || t == TK_CHAR) {
-            printf("neg\n");
-            gen_op(op_neg);
-        }
-        else if (t == TK_REAL) {
-            printf("fneg\n");
-            gen_op(op_fneg);
-        }
-        else {
+        gettoken();
+        e = F();
+        if (e->type != TK_INT && e->type != TK_CHAR && e->type != TK_REAL) {
             printf("error: invalid operand type for unary plus (line %i)\n", curtoken.line);
             exit(EXIT_FAILURE);
         }
+        e = ast_unary(TK_MINUS, e);
     }
     else if (curtoken.type == TK_LPAREN) {
-        // F ::= ( O ) 
+        // F ::= ( O )
         gettoken();
-        t = O();
+        e = O();
         match(TK_RPAREN);
     }
     else if (curtoken.type == TK_INT) {
         // F ::= constant
-        printf("pushi %d\n", curtoken.i); 
-        gen_op(op_pushi);
-        gen_int(curtoken.i); 
+        e = ast_const_int(curtoken.i, TK_INT);
         gettoken();
-        t = TK_INT;
     }
     else if (curtoken.type == TK_REAL) {
         // F ::= constant
-        printf("fpushi %f\n", curtoken.f);
-        gen_op(op_fpushi);
-        gen_float(curtoken.f);
+        e = ast_const_float(curtoken.f);
         gettoken();
-        t = TK_REAL;
     }
     else if (curtoken.type == TK_CHAR) {
         // F ::= constant
-        printf("pushi '%c'\n", curtoken.c);
-        gen_op(op_pushi);
-        gen_int(curtoken.c);
+        e = ast_const_int(curtoken.c, TK_CHAR);
         gettoken();
-        t = TK_CHAR;
     }
     else if (curtoken.type == TK_ID) {
         token id = curtoken; /* save id */
-        Node* entry = search_symtabs(&symtabs, id.text); /* find entry in symtab */
+        Node* entry = search_id(id.id); /* find entry in symtab */
         if (entry == NULL) {
-            printf("error: '%s' undeclared (line: %i, column: %i)\n", id.text, id.line, id.column);
+            printf("error: '%s' undeclared (line: %i, column: %i)\n", name_of(id.id), id.line, id.column);
             exit(EXIT_FAILURE);
         }
-        t = entry->type;
+        Type t = entry->type;
         gettoken();
         /* check for [ ] (array subscripting) */
         if (curtoken.type == TK_LBRAC) {
             gettoken();
-            int index_line = curtoken.line; int index_column = curtoken.column;
-
-            Type itype = O(); /* leave the index on stack */
-            printf("pushi %i\n", entry->size / entry->arrlength); /* leave elt size on the stack */
-            gen_op(op_pushi);
-            gen_int(entry->size / entry->arrlength);
-            printf("mul\n");
-            gen_op(op_mul); /* multiply the index and the elt size to get the offset (relative address) */
-            printf("pushi %i\n", entry->addr); /* push the addr of the array on the stack */
-            gen_op(op_pushi);
-            gen_addr(entry->addr);
-            printf("add\n");
-            gen_op(op_add); /* the absolute addr of the array element is now on stack */
+            Expr* index = O();
             match(TK_RBRAC);
             if (t != TK_ARR) {
-                printf("error: '%s' is not an array (line %i, col %i)\n", id.text, id.line, id.column);
+                printf("error: '%s' is not an array (line %i, col %i)\n", name_of(id.id), id.line, id.column);
                 exit(EXIT_FAILURE);
             }
-            if (itype != TK_INT && itype != TK_CHAR) {
+            if (index->type != TK_INT && index->type != TK_CHAR) {
                 printf("error: array subscript is not an integer\n");
                 exit(EXIT_FAILURE);
             }
-            t = entry->elt_type;
-            if (t == TK_REAL) {
-                printf("fget\n");
-                gen_op(op_fget);
-            }
-            else {
-                printf("get\n");
-                gen_op(op_get);
-            }
+            /* the absolute addr of the array element is the addr of the array + index * elt size */
+            e = ast_elem(entry->addr, entry->scope > 0, entry->size / entry->arrlength, index, entry->elt_type);
         }
         else { // <constant>
-            if (t == TK_INT || t == TK_CHAR) {
-                printf("push '%s' (addr: %i)\n", entry->name, entry->addr);
-                gen_op(op_push);
-                gen_addr(entry->addr);
-            }
-            else if (t == TK_REAL) {
-                printf("fpush '%s' (addr: %i)\n", entry->name, entry->addr);
-                gen_op(op_fpush);
-                gen_addr(entry->addr);
+            if (t == TK_INT || t == TK_CHAR || t == TK_REAL) {
+                e = ast_var(entry->addr, entry->scope > 0, t);
             }
             else {
                 printf("error: invalid type of object '%s' on line %i\n", entry->name, entry->line);
@@ -448,10 +297,10 @@ Type F(void)
     else {
         error();
     }
-    return t;
+    return e;
 }
 
-Type declaration(void)
+Stmt* declaration(void)
 {
     int declaration_type;
 /*    if (curtoken.type == TK_void) {*/
@@ -459,19 +308,25 @@ Type declaration(void)
 /*        declaration_type = -1;*/
 /*    }*/
     if (curtoken.type == TK_char) {
-        printf("declaration type: char\n");
+        if (TRACE(TRACE_IR)) {
+            printf("declaration type: char\n");
+        }
         declaration_type = TK_CHAR;
     }
     else if (curtoken.type == TK_int) {
-        printf("declaration type: int\n");
+        if (TRACE(TRACE_IR)) {
+            printf("declaration type: int\n");
+        }
         declaration_type = TK_INT;
     }
     else if (curtoken.type == TK_float) {
-        printf("declaration type: float\n");    
+        if (TRACE(TRACE_IR)) {
+            printf("declaration type: float\n");
+        }
         declaration_type = TK_REAL;
     }
     else {
-        printf("Unknown type name %s\n", curtoken.text);
+        printf("Unknown type name %s\n", curtoken.type == TK_ID ? name_of(curtoken.id) : "");
         exit(EXIT_FAILURE);
     }
     gettoken();
@@ -481,62 +336,52 @@ Type declaration(void)
         exit(EXIT_FAILURE);
     }
     /* process all declared names (with optional initializations) */
-    init_declarator(declaration_type); /* pass declaration type as argument */
+    StmtList inits = {NULL, NULL};
+    add_stmt(&inits, init_declarator(declaration_type)); /* pass declaration type as argument */
     while (curtoken.type == TK_COMMA) {
         gettoken();
-        init_declarator(declaration_type); /* again, pass declaration type as argument */
+        add_stmt(&inits, init_declarator(declaration_type)); /* again, pass declaration type as argument */
     }
     /* match a semicolon to terminate the declaration (statement) */
     match(TK_SEMICOLON);
+    return inits.first;
 }
 
-void init_declarator(int type)
+Stmt* init_declarator(int type)
 {
     /* process the declared symbol */
     Node* new_entry = declarator(type); /* create new entry in symtab */
+    StmtList assignments = {NULL, NULL};
     if (curtoken.type == TK_ASSIGN) {
+        int line = curtoken.line;
         gettoken();
-        int inits = initializer(new_entry); /* leaves values on the stack */
-        int item_size = 0;
-        if (new_entry->type == TK_ARR) {
-            /* create a pop instruction for each array element that was initialized */
-            item_size = new_entry->size / new_entry->arrlength;
-            for (int i = inits - 1; i >= 0; i--) {
-                if (type == TK_REAL) {
-                    printf("fpop '%s[%d]' (addr: %i)\n", new_entry->name, i, i*item_size + new_entry->addr);
-                    gen_op(op_fpop);
-                }
-                else {
-                    printf("pop '%s[%d]' (addr: %i)\n", new_entry->name, i, i*item_size + new_entry->addr);
-                    gen_op(op_pop);
-                }
-                gen_addr(i*item_size + new_entry->addr);
-            }
-        }
-        else {
-            if (type == TK_REAL) {
-                printf("fpop '%s' (addr: %i)\n", new_entry->name, new_entry->addr);
-                gen_op(op_fpop);
-            }
-            else {
-                printf("pop '%s' (addr: %i)\n", new_entry->name, new_entry->addr); 
-                gen_op(op_pop);
-            }
-            gen_addr(new_entry->addr);
+        Expr** values = arena_alloc(&ast_arena, new_entry->arrlength * sizeof (Expr*));
+        int inits = initializer(new_entry, values);
+        /* assign each value to the variable (or to each array element that was initialized) */
+        int item_size = new_entry->size / new_entry->arrlength;
+        for (int i = 0; i < inits; i++) {
+            Stmt* s = ast_stmt(ST_ASSIGN, line);
+            s->target = ast_var(new_entry->addr + i*item_size, new_entry->scope > 0, type);
+            s->expr = values[i];
+            add_stmt(&assignments, s);
         }
     }
+    return assignments.first;
 }
 
 Node* declarator(int type)
 {
     Node* inserted;
     if (curtoken.type == TK_ID) {
-        /* add the identifier to the symtab (the topmost table) */
-        inserted = install_id(symtabs.table[symtabs.top], curtoken.text);
+        /* add the identifier to the symtab (in the innermost scope) */
+        inserted = install_id(curtoken.id);
         inserted->type = type; // update the type (int, real, char, array, or func); note that arrays/funcs won't be labeled yet
         inserted->line = curtoken.line; // update the line declared
-        inserted->addr = dp; // update the address
-        printf("inserted the declared symbol '%s' (addr: %d)\n", inserted->name, inserted->addr);
+        /* update the address (globals: in the data array; locals: in the frame of the procedure) */
+        inserted->addr = inserted->scope > 0 ? frame_size : (int) dp;
+        if (TRACE(TRACE_IR)) {
+            printf("inserted the declared symbol '%s' (%s: %d)\n", inserted->name, inserted->scope > 0 ? "offset" : "addr", inserted->addr);
+        }
         /* update the size of the object (if it's an array, size will later be multiplied by length) */
         if (type == TK_INT || type == TK_REAL) {
             inserted->size = 4;
@@ -578,24 +423,32 @@ Node* declarator(int type)
                 gettoken();
                 match(TK_RBRAC);
             }
-            printf("...which is an array of %d * %d = %d bytes\n", inserted->size / inserted->arrlength, inserted->arrlength, inserted->size);
+            if (TRACE(TRACE_IR)) {
+                printf("...which is an array of %d * %d = %d bytes\n", inserted->size / inserted->arrlength, inserted->arrlength, inserted->size);
+            }
+        }
+        /* increment data counter (or the size of the frame) */
+        if (inserted->scope > 0) {
+            frame_size += inserted->size;
+        }
+        else {
+            dp += inserted->size;
         }
-        dp += inserted->size; /* increment data counter */
     }
     /* deal with something like 'int (x);' */
     else if (curtoken.type == TK_LPAREN) {
             gettoken();
-            declarator(type);
+            inserted = declarator(type);
             match(TK_RPAREN);
     }
     return inserted;
 }
 
-int initializer(Node* entry)
+int initializer(Node* entry, Expr** values)
 {
     int inits = 0; /* number of values to initialize (non-array: 1, array: n, where 1 <= n <= size) */
     int capacity = entry->arrlength; /* we'll need to test the object's capacity against the number of inits */
-    int l_type, r_type; /* we'll need to test the type of the object we're initializing against the type of each init */
+    int l_type; /* we'll need to test the type of the object we're initializing against the type of each init */
     if (entry->type == TK_ARR) {
         l_type = entry->elt_type;
     }
@@ -610,32 +463,19 @@ int initializer(Node* entry)
         or 'int x[2] = {3, 4, 5}', i.e., whenever capacity < inits. */
         do {
             gettoken();
-            r_type = O(); /* leave a value on the stack */
-            if (l_type == TK_INT || l_type == TK_CHAR) {
-                if (r_type == TK_REAL) {
-                    printf("conv to int\n");
-                    gen_op(op_conv_to_int);
-                }
-            }
-            else if (l_type == TK_REAL) {
-                if (r_type == TK_INT || r_type == TK_CHAR) {
-                    printf("conv to real\n");
-                    gen_op(op_conv_to_float);
-                }
-            }
-            if (r_type != TK_INT && r_type != TK_CHAR && r_type != TK_REAL) {
+            Expr* value = O();
+            if (value->type != TK_INT && value->type != TK_CHAR && value->type != TK_REAL) {
                 printf("error: invalid assignment to '%s' in line %i\n", entry->name, entry->line);
                 exit(EXIT_FAILURE);
             }
-            inits++;
-            if (capacity < inits) {
+            if (capacity <= inits) {
+                /* drop the value (give a warning, but don't halt) */
                 printf("warning: excess elements in initializer (in line %d, column %d)\n", curtoken.line, curtoken.column);
-                printf("delete\n"); /* delete value on stack (give a warning, but don't halt) */
-                gen_op(op_remove);
-                inits--;
+            }
+            else {
+                values[inits++] = ast_conv(value, l_type);
             }
         } while (curtoken.type == TK_COMMA);
-        /* now all initialization values (up to capacity) are left on the stack */
         match(TK_RCURL);
     }
     else {
@@ -644,38 +484,27 @@ int initializer(Node* entry)
             printf("invalid array initializer (line %d, column %d)\n", curtoken.line, curtoken.column);
             exit(EXIT_FAILURE);
         }
-        r_type = O(); /* leave a value on the stack */
-        if (l_type == TK_INT || l_type == TK_CHAR) {
-            if (r_type == TK_REAL) {
-                printf("conv to int\n");
-                gen_op(op_conv_to_int);
-            }
-        }
-        else if (l_type == TK_REAL) {
-            if (r_type == TK_INT || r_type == TK_CHAR) {
-                printf("conv to real\n");
-                gen_op(op_conv_to_float);
-            }
-        }
-        if (r_type != TK_INT && r_type != TK_CHAR && r_type != TK_REAL) {
+        Expr* value = O();
+        if (value->type != TK_INT && value->type != TK_CHAR && value->type != TK_REAL) {
             printf("error: invalid assignment to '%s' in line %i\n", entry->name, entry->line);
             exit(EXIT_FAILURE);
         }
-        inits = 1;
+        values[inits++] = ast_conv(value, l_type);
     }
-    return inits; /* return the number of items left on stack */
+    return inits; /* return the number of values */
 }
 
-void assignment(void)
+Stmt* assignment(void)
 {
+    Stmt* s = ast_stmt(ST_ASSIGN, curtoken.line);
     if (curtoken.type == TK_ID) {
-        Type l_type, r_type;
+        Type l_type;
         token id_tok = curtoken; /* save info about the identifier */
         gettoken();
 
-        Node* entry = search_symtabs(&symtabs, id_tok.text);
+        Node* entry = search_id(id_tok.id);
         if (entry == NULL) {
-            printf("'%s' undeclared (line %i, col %i)\n", id_tok.text, id_tok.line, id_tok.column);
+            printf("'%s' undeclared (line %i, col %i)\n", name_of(id_tok.id), id_tok.line, id_tok.column);
             exit(EXIT_FAILURE);
         }
         /* deal with an array element such as A[1+i]*/
@@ -685,45 +514,20 @@ void assignment(void)
                 printf("error: expected expression before ']' (line %i, col %i)\n", curtoken.line, curtoken.column);
                 exit(EXIT_FAILURE);
             }
-            Type t = O(); /* leave the index on stack */
-            printf("pushi %i\n", entry->size / entry->arrlength); /* leave elt size on the stack */
-            gen_op(op_pushi);
-            gen_int(entry->size / entry->arrlength);
-            printf("mul\n");
-            gen_op(op_mul); /* multiply the index and the elt size to get the offset (relative address) */
-            printf("pushi %i\n", entry->addr); /* push the addr of the array on the stack */
-            gen_op(op_pushi);
-            gen_addr(entry->addr);
-            printf("add\n");
-            gen_op(op_add); /* the absolute addr of the array element is now on stack */
+            Expr* index = O();
             match(TK_RBRAC);
             if (entry->type != TK_ARR) {
-                printf("error: '%s' is not an array (line %i, col %i)\n", id_tok.text, id_tok.line, id_tok.column);
+                printf("error: '%s' is not an array (line %i, col %i)\n", name_of(id_tok.id), id_tok.line, id_tok.column);
                 exit(EXIT_FAILURE);
             }
-            if (t != TK_INT && t != TK_CHAR) {
+            if (index->type != TK_INT && index->type != TK_CHAR) {
                 printf("error: array subscript is not an integer\n");
                 exit(EXIT_FAILURE);
             }
             l_type = entry->elt_type;
+            s->target = ast_elem(entry->addr, entry->scope > 0, entry->size / entry->arrlength, index, l_type);
             match(TK_ASSIGN);
-            r_type = O(); /* value of assignment is left on stack, atop the array addr */
-            if (l_type == TK_INT || l_type == TK_CHAR) {
-                if (r_type == TK_REAL) {
-                    printf("conv to int\n");
-                    gen_op(op_conv_to_int);
-                }
-                printf("put\n");
-                gen_op(op_put);
-            }
-            else if (l_type == TK_REAL) {
-                if (r_type == TK_INT || r_type == TK_CHAR) {
-                    printf("conv to real\n");
-                    gen_op(op_conv_to_float);
-                }
-                printf("fput\n");
-                gen_op(op_fput);
-            }
+            s->expr = ast_conv(O(), l_type);
         }
         else if (curtoken.type == TK_ASSIGN) {
             int err_line = curtoken.line;
@@ -735,36 +539,13 @@ void assignment(void)
             }
             if (l_type == TK_INT || l_type == TK_REAL || l_type == TK_CHAR) {
                 gettoken();
-                r_type = O();
-                if (l_type == TK_INT || l_type == TK_CHAR) {
-                    if (r_type == TK_REAL) {
-                        printf("conv to int\n");
-                        gen_op(op_conv_to_int);
-                    }
-                }
-                else if (l_type == TK_REAL) {
-                    if (r_type == TK_INT || r_type == TK_CHAR) {
-                        printf("conv to real\n");
-                        gen_op(op_conv_to_float);
-                    }
-                }
-                else {
-                    printf("error: invalid assignment in line %i, col %i\n", err_line, err_column);
-                    exit(EXIT_FAILURE);
-                }
-                if (r_type != TK_INT && r_type != TK_CHAR && r_type != TK_REAL) {
+                Expr* value = O();
+                if (value->type != TK_INT && value->type != TK_CHAR && value->type != TK_REAL) {
                     printf("error: invalid right operand in assignment to '%s' in line %i\n", entry->name, entry->line);
                     exit(EXIT_FAILURE);
                 }
-                if (l_type == TK_REAL) {
-                    printf("fpop '%s' (addr: %i)\n", entry->name, entry->addr);
-                    gen_op(op_fpop);
-                }
-                else {
-                    printf("pop '%s' (addr: %i)\n", entry->name, entry->addr);
-                    gen_op(op_pop);
-                }
-                gen_addr(entry->addr);
+                s->target = ast_var(entry->addr, entry->scope > 0, l_type);
+                s->expr = ast_conv(value, l_type);
             }
             else {
                 printf("error: invalid left operand in assignment (line %i, col %i)\n", err_line, err_column);
@@ -775,72 +556,78 @@ void assignment(void)
     else {
         error();
     }
+    return s;
 }
 
-void assignment_statement(void)
+Stmt* assignment_statement(void)
 {
     /* process zero or more comma-separated assignments terminated by a semicolon */
+    StmtList list = {NULL, NULL};
     if (curtoken.type == TK_SEMICOLON) {
         match(TK_SEMICOLON);
     }
     else {
-        assignment();
+        add_stmt(&list, assignment());
         while (curtoken.type == TK_COMMA) {
             gettoken();
-            assignment();
+            add_stmt(&list, assignment());
         }
         match(TK_SEMICOLON);
     }
+    Stmt* block = ast_stmt(ST_BLOCK, curtoken.line);
+    block->body = list.first;
+    return block;
 }
 
-void compound_statement(void)
+Stmt* compound_statement(void)
 {
+    Stmt* block = ast_stmt(ST_BLOCK, curtoken.line);
+    StmtList list = {NULL, NULL};
     match(TK_LCURL);
-    begin_scope(); /* open a new scope  (new symtab) */
-    while (curtoken.type == TK_int || curtoken.type == TK_float || curtoken.type == TK_char) {
-        declaration();
-    }
+    begin_scope(); /* open a new scope */
     while (curtoken.type != TK_RCURL) {
         if (curtoken.type == TK_int || curtoken.type == TK_float || curtoken.type == TK_char) {
-            declaration();
+            add_stmt(&list, declaration());
         }
         else {
-            statement();
+            add_stmt(&list, statement());
         }
     }
     match(TK_RCURL);
-    end_scope(); /* close the scope (delete the symtab) */
+    end_scope(); /* close the scope (undo its declarations) */
+    block->body = list.first;
+    return block;
 }
 
-void statement(void)
+Stmt* statement(void)
 {
     if (curtoken.type == TK_ID || curtoken.type == TK_SEMICOLON) {
         if (curtoken.type == TK_ID) {
-            Node * entry = search_symtabs(&symtabs, curtoken.text);
-            if (entry->type == TK_FUNC) {
-                procedure_call();
+            Node * entry = search_id(curtoken.id);
+            if (entry != NULL && entry->type == TK_FUNC) {
+                return procedure_call();
             }
             else {
-                assignment_statement();
+                return assignment_statement();
             }
         }
         else {
             /* let assignment_statement() deal with a semicolon (empty declaration/statement) */
-            assignment_statement(); /* <assignment-statement> ::= {<assignment-list>}? ; */
+            return assignment_statement(); /* <assignment-statement> ::= {<assignment-list>}? ; */
         }
     }
     else if (curtoken.type == TK_LCURL) {
-        compound_statement(); /* <compound-statement> ::= { {<declaration>}* {<statement>}* } */
+        return compound_statement(); /* <compound-statement> ::= { {<declaration>}* {<statement>}* } */
     }
     else if (curtoken.type == TK_if || curtoken.type == TK_switch) {
-        selection_statement(); /* <selection-statement> ::= <if-statement> | <switch-statement> ; */
+        return selection_statement(); /* <selection-statement> ::= <if-statement> | <switch-statement> ; */
     }
     else if (curtoken.type == TK_while || curtoken.type == TK_do || curtoken.type == TK_for) {
-        iteration_statement(); /* <iteration-statement> ::= <while-loop> | <do-while> */
+        return iteration_statement(); /* <iteration-statement> ::= <while-loop> | <do-while> */
     }
     else if (curtoken.type == TK_case || curtoken.type == TK_default) {
         if (inside_switch) {
-            labeled_statement();
+            return labeled_statement();
         }
         else {
             printf("case/default label not inside switch\n");
@@ -848,36 +635,40 @@ void statement(void)
         }
     }
     else if (curtoken.type == TK_return) {
-        jump_statement();
+        return jump_statement();
     }
     else if (curtoken.type == TK_print) {
-        print_statement();
+        return print_statement();
     }
     else {
         error();
     }
+    return NULL;
 }
 
-void selection_statement(void)
+Stmt* selection_statement(void)
 {
     if (curtoken.type == TK_if) {
-        if_statement();
+        return if_statement();
     }
     else if (curtoken.type == TK_switch) {
-        switch_statement();
+        return switch_statement();
     }
     else {
         error();
     }
+    return NULL;
 }
 
-void if_statement(void)
+Stmt* if_statement(void)
 {
+    Stmt* s = ast_stmt(ST_IF, curtoken.line);
     int err_line = curtoken.line;
     int err_column = curtoken.column;
     match(TK_if);
     match(TK_LPAREN);
-    Type t = O(); /* leave value of condition expression on stack */
+    s->expr = O(); /* the condition */
+    Type t = s->expr->type;
     if (t == TK_INT || t == TK_CHAR || t == TK_REAL) {
         match(TK_RPAREN);
     }
@@ -885,57 +676,40 @@ void if_statement(void)
         printf("error: the condition expression of the if must be of numeric type (line %i, col %i)\n", err_line, err_column);
         exit(EXIT_FAILURE);
     }
-    /* insert a jfalse operation (for jumping to the second set of instructions if cond is false) here,
-    but we don't know the jump size yet */
-    int hole = ip; /* store the location of the jfalse instruction */
-    printf("jfalse <arg>\n");
-    gen_op(op_jfalse);
-    gen_addr(0);
-
-    statement(); /* generate a first set of instructions in case the condition is true */ 
-    /* if there is an else, generate a second set of instructions in case the condition is false */
+    s->body = statement(); /* the statement in case the condition is true */
+    /* if there is an else, get the statement in case the condition is false */
     if (curtoken.type == TK_else) {
         gettoken();
-        /* create a second jump here in case the condition is true: we'll want to skip the second set of
-        instructions after performing the first one */
-        int hole2 = ip;
-        printf("jmp <arg>\n");
-        gen_op(op_jmp);
-        gen_addr(0);
-        /* we can update the first jump size in code[hole+1] (jump to current ip <=> jump by ip-hole) */ 
-        gen_addr_rel(ip-hole, hole+1); printf("jfalse arg computed: %i\n", ip-hole);  
-        statement();
-        /* we can update the size of the second jump at code[hole2+1] */
-        gen_addr_rel(ip-hole2, hole2+1); printf("jmp arg computed: %i\n", ip-hole2);
-    }
-    else { 
-        gen_addr_rel(ip-hole, hole+1); printf("jfalse arg computed: %i\n", ip-hole); 
+        s->else_body = statement();
     }
+    return s;
 }
 
-void iteration_statement(void)
+Stmt* iteration_statement(void)
 {
     if (curtoken.type == TK_while) {
-        while_loop();
+        return while_loop();
     }
     else if (curtoken.type == TK_do) {
-        do_while();
+        return do_while();
     }
     else {
         error();
     }
+    return NULL;
 }
 
-void do_while(void)
+Stmt* do_while(void)
 {
+    Stmt* s = ast_stmt(ST_DO, curtoken.line);
     match(TK_do);
-    int start = ip; /* save the start of the instructions corresponding to the <statement> */
-    statement();
+    s->body = statement();
     match(TK_while);
     match(TK_LPAREN);
     int err_line = curtoken.line;
     int err_column = curtoken.column;
-    Type t = O();
+    s->expr = O();
+    Type t = s->expr->type;
     if (t == TK_INT || t == TK_CHAR || t == TK_REAL) {
         match(TK_RPAREN);
     }
@@ -943,22 +717,19 @@ void do_while(void)
         printf("error: the condition expression of the do...while must be of numeric type (line %i, col %i)\n", err_line, err_column);
         exit(EXIT_FAILURE);
     }
-    /* jump in the negative direction to the start */
-    printf("jtrue %i\n", start-ip);
-    gen_op(op_jtrue); /* note that this increases ip by 1 */
-    gen_addr(start-(ip-1));
     match(TK_SEMICOLON);
+    return s;
 }
 
-void while_loop(void)
+Stmt* while_loop(void)
 {
+    Stmt* s = ast_stmt(ST_WHILE, curtoken.line);
     match(TK_while);
     match(TK_LPAREN);
     int err_line = curtoken.line;
     int err_column = curtoken.column;
-    /* mark the instruction to jump back to after each iteration (to check the condition again) */
-    int start = ip;
-    Type t = O(); /* leave value of condition expression on stack */
+    s->expr = O(); /* the condition, checked before each iteration */
+    Type t = s->expr->type;
     if (t == TK_INT || t == TK_CHAR || t == TK_REAL) {
         match(TK_RPAREN);
     }
@@ -966,254 +737,157 @@ void while_loop(void)
         printf("error: the condition expression of the while-loop must be of numeric type (line %i, col %i)\n", err_line, err_column);
         exit(EXIT_FAILURE);
     }
-    /* jump past <statement> if condition is false */
-    int hole = ip; /* we don't know the jump size yet */
-    printf("jfalse <arg>\n");
-    gen_op(op_jfalse);
-    gen_addr(0);
-    statement();
-    /* jump to the beginning */
-    printf("jmp %i\n", start-ip);
-    gen_op(op_jmp); /* note that this increases ip by 1 */
-    gen_addr(start-(ip-1));
-    /* fix hole after jfalse instruction */
-    printf("jfalse arg computed: %i\n", ip-hole);
-    gen_addr_rel(ip-hole, hole+1);
+    s->body = statement();
+    return s;
 }
 
-void switch_statement(void)
+Stmt* switch_statement(void)
 {
+    Stmt* s = ast_stmt(ST_SWITCH, curtoken.line);
     inside_switch = 1;
     match(TK_switch);
     match(TK_LPAREN);
-    Type t = O(); /* push expr on stack */
+    s->expr = O();
     match(TK_RPAREN);
-    if (t != TK_INT && t != TK_CHAR) {
+    if (s->expr->type != TK_INT && s->expr->type != TK_CHAR) {
         printf("error: switch expr not an integer\n");
         exit(EXIT_FAILURE);
     }
-    int hole = ip;
-    printf("pushi <end-of-switch-addr>\n");
-    gen_op(op_pushi);
-    gen_addr(0); /* leave switch-exit address on stack */
-    printf("exch\n");
-    gen_op(op_exch); /* move expr back to top of stack */
-    switch_body();
-    printf("remove\n");
-    gen_op(op_remove); /* pop expr from stack */
-    gen_op(op_remove); /* pop retaddr from stack */
-    gen_addr_rel(ip, hole+1); /* end switch */
+    /* the switch value is kept in a local variable of its own, to be compared with each case label */
+    s->addr = frame_size;
+    frame_size += 4;
+    s->body = switch_body();
     inside_switch = 0;
+    return s;
 }
 
-void switch_body(void)
+Stmt* switch_body(void)
 {
+    StmtList cases = {NULL, NULL};
     match(TK_LCURL);
-    begin_scope(); 
+    begin_scope();
     while (curtoken.type == TK_case || curtoken.type == TK_default) {
-        if (curtoken.type == TK_case) {
-            gettoken(); 
-            printf("dup\n");
-            gen_op(op_dup);
-            Type t = O();
-            match(TK_COLON);
-            if (t != TK_INT && t != TK_CHAR) {
-                printf("error: case label not an integer\n");
-                exit(EXIT_FAILURE);
-            }
-            printf("eq\n");
-            gen_op(op_eq);
-            /* jump past statement if dup != label */
-            int hole = ip;
-            printf("jfalse <end-of-case-addr>\n");
-            gen_op(op_jfalse);
-            gen_addr(0);
-            statement();
-            /* remove the switch val from stack and jump to end of switch */
-            printf("remove\n");
-            gen_op(op_remove);
-            printf("exit switch\n");
-            gen_op(op_return);
-            gen_addr_rel(ip-hole, hole+1); 
-        }
-        else if (curtoken.type == TK_default) {
-            gettoken();
-            match(TK_COLON);
-            statement();
-            printf("remove\n");
-            gen_op(op_remove);
-            printf("exit switch\n");
-            gen_op(op_return);
-        }
+        add_stmt(&cases, labeled_statement());
     }
     match(TK_RCURL);
-    end_scope(); /* close the scope (delete the symtab) */
+    end_scope(); /* close the scope (undo its declarations) */
+    return cases.first;
 }
 
-void labeled_statement(void)
+Stmt* labeled_statement(void)
 {
-    Type t;
+    Stmt* s;
     if (curtoken.type == TK_case) {
+        s = ast_stmt(ST_CASE, curtoken.line);
         gettoken();
-        printf("dup\n");
-        gen_op(op_dup); /* leave a copy of the switch value on stack */
-        Type t = O();
+        s->expr = O();
         match(TK_COLON);
-        if (t != TK_INT && t != TK_CHAR) {
+        if (s->expr->type != TK_INT && s->expr->type != TK_CHAR) {
             printf("error: case label not an integer\n");
             exit(EXIT_FAILURE);
         }
-        printf("eq\n");
-        gen_op(op_eq);
-        /* jump past statement if dup != label */
-        int hole = ip;
-        printf("jfalse <arg>\n");
-        gen_op(op_jfalse);
-        gen_addr(0);
-        statement();
-        printf("remove\n");
-        gen_op(op_remove);
-        printf("exit switch\n");
-        gen_op(op_return); /* exit the switch */
-        gen_addr_rel(ip-hole, hole+1); /* jump to here */
-    }
-    else if (curtoken.type == TK_default) {
-        gettoken();
-        match(TK_COLON);
-        statement();
-        printf("remove\n");
-        gen_op(op_remove);
+        s->body = statement(); /* run if the label matches, and then leave the switch */
     }
     else {
+        s = ast_stmt(ST_DEFAULT, curtoken.line);
+        match(TK_default);
+        match(TK_COLON);
+        s->body = statement();
     }
+    return s;
 }
 
-void jump_statement(void)
+Stmt* jump_statement(void)
 {
-    if (curtoken.type == TK_return) {
-        printf("return\n");
-        gen_op(op_return);
-    }
+    Stmt* s = ast_stmt(ST_RETURN, curtoken.line);
+    match(TK_return);
     match(TK_SEMICOLON);
+    return s;
 }
 
-void procedure_definition(void)
+Proc* procedure_definition(void)
 {
-    /* leave a jmp instr to skip calling the procedure until a real call is made */
-    int hole = ip;
-    printf("jmp <arg>\n");
-    gen_op(op_jmp);
-    gen_addr(0);
-
-    /* output instructions for the procedure */
+    Proc* proc = arena_alloc(&ast_arena, sizeof (Proc));
     match(TK_void);
     if (curtoken.type == TK_ID) {
-        Node* entry = install_id(symtabs.table[symtabs.top], curtoken.text); /* may give a redeclaration error */
+        Node* entry = install_id(curtoken.id); /* may give a redeclaration error */
         entry->type = TK_FUNC;
         entry->line = curtoken.line;
+        proc->entry = entry;
+        /* append the procedure to the program before its body, where it may be called (recursively) */
+        *procs_tail = proc;
+        procs_tail = &proc->next;
         gettoken();
         match(TK_LPAREN);
         int num_of_params = 0;
-        /* process entry into procedure */
-        /* a modification of compound_statement() is what follows.
-        begin a new scope (symtab) *before* the brace in order to declare any params within the procedure scope */
+        /* begin a new scope *before* the brace in order to declare any params within the procedure scope */
         begin_scope();
-        entry->addr = ip; /* save the entry addr */
+        frame_size = 0;
         int type;
         while (curtoken.type == TK_int || curtoken.type == TK_float || curtoken.type == TK_char) {
             if (curtoken.type == TK_int) {
-                type = entry->params[num_of_params++] = TK_INT;
+                type = entry->params[num_of_params] = TK_INT;
             }
             else if (curtoken.type == TK_float) {
-                type = entry->params[num_of_params++] = TK_REAL;
+                type = entry->params[num_of_params] = TK_REAL;
             }
             else {
-                type = entry->params[num_of_params++] = TK_CHAR;
+                type = entry->params[num_of_params] = TK_CHAR;
             }
             gettoken();
-            Node* entry2 = install_id(symtabs.table[symtabs.top], curtoken.text);
+            Node* entry2 = install_id(curtoken.id);
             entry2->type = type;
             entry2->size = 4;
-            entry2->addr = dp;
+            entry2->addr = frame_size;
             entry2->line = curtoken.line;
             entry2->arrlength = 1;
-            dp += entry2->size;
-            /* when a proc is called, the args (converted to right type) are left on the stack,
-            so we must retrieve them first */
-            printf("inserted the declared symbol '%s' (addr: %d)\n", entry2->name, entry2->addr);
-            if (type == TK_INT || type == TK_CHAR) {
-                printf("pop '%s' (addr: %i)\n", entry2->name, entry2->addr);
-                gen_op(op_pop);
-                gen_addr(entry2->addr);
-            }
-            else {
-                printf("fpop '%s' (addr: %i)\n", entry2->name, entry2->addr);
-                gen_op(op_fpop);
-                gen_addr(entry2->addr);
+            frame_size += entry2->size;
+            if (TRACE(TRACE_IR)) {
+                printf("inserted the declared symbol '%s' (offset: %d)\n", entry2->name, entry2->addr);
             }
+            /* when a proc is called, the args (converted to the right type) become the first slots of its frame */
+            proc->param_types[num_of_params] = type;
+            proc->param_addrs[num_of_params] = entry2->addr;
+            num_of_params++;
             gettoken();
             if (curtoken.type == TK_COMMA) {
                 gettoken();
             }
         }
         entry->num_of_params = num_of_params;
+        proc->num_of_params = num_of_params;
         /* process the body (compound statement) */
         match(TK_RPAREN);
+        proc->body = ast_stmt(ST_BLOCK, curtoken.line);
+        StmtList list = {NULL, NULL};
         match(TK_LCURL);
-        while (curtoken.type == TK_int || curtoken.type == TK_float || curtoken.type == TK_char) {
-            declaration();
-        }
         while (curtoken.type != TK_RCURL) {
             if (curtoken.type == TK_int || curtoken.type == TK_float || curtoken.type == TK_char) {
-                declaration();
+                add_stmt(&list, declaration());
             }
             else {
-                statement();
+                add_stmt(&list, statement());
             }
         }
         match(TK_RCURL);
         end_scope();
-        /* let return be the last instr */
-        printf("return\n");
-        gen_op(op_return);
-        /* we can update the hole now, which is at code[hole+1] */
-        /* note that if no instructions are generated for the procedure, ip-hole = 0 */
-        gen_addr_rel(ip-hole, hole+1); printf("jmp arg computed: %i\n", ip-hole);
-    }
-    else {
-        error();
-    }
-}
-
-void conv(Type t1, Type t2)
-{
-    if (t1 == TK_INT || t1 == TK_CHAR) {
-        if (t2 == TK_REAL) {
-            printf("conv to int\n");
-            gen_op(op_conv_to_int);
-        }
-    }
-    else if (t1 == TK_REAL) {
-        if (t2 == TK_INT || t2 == TK_CHAR) {
-            printf("conv to float\n");
-            gen_op(op_conv_to_float);
-        }
+        proc->body->body = list.first;
+        proc->frame_size = frame_size;
+        /* (the procedure returns at the end of its body, too) */
     }
     else {
         error();
     }
+    return proc;
 }
 
-void procedure_call(void)
+Stmt* procedure_call(void)
 {
-    /* Before placing the set of instructions corresponding to a proc definition in the code array, place a jump operation in the code array.
-    Update the initially-unknown argument to the jump instruction so that the jump skips to the instruction right after the last instruction in the proc.
-    The return keyword creates a return instruction, but append an op_return to the end of the procedure instructions regardless.
-    An op_call should begin executing the proc instructions by going to the particular ip value (check the addr field of the func's entry in the symtab).
-    The input to the op_return is left on the stack beforehand. (op_return removes from the stack and returns to the original ip). */
-
+    /* The args are converted to the types of the params; each call then leaves its args on the stack
+    and jumps to the procedure (see codegen.h). */
+    Stmt* s = ast_stmt(ST_CALL, curtoken.line);
     if (curtoken.type == TK_ID) {
-        Node* entry = search_symtabs(&symtabs, curtoken.text);
+        Node* entry = search_id(curtoken.id);
         gettoken();
         match(TK_LPAREN);
         if (entry == NULL) {
@@ -1224,19 +898,25 @@ void procedure_call(void)
             printf("error: expected '%s' to be a procedure in line %i\n", entry->name, entry->line);
             exit(EXIT_FAILURE);
         }
+        for (Proc* p = program.procs; p != NULL; p = p->next) {
+            if (p->entry == entry) {
+                s->proc = p;
+            }
+        }
         int num_of_params = entry->num_of_params;
-        // somehow push the args to stack (after passing them through the conv func) backward...
-        // check for same nmber of args as well.
+        s->args = arena_alloc(&ast_arena, (num_of_params + 1) * sizeof (Expr*));
         int count = 0;
-        Type t;
         while (curtoken.type != TK_RPAREN) {
-            t = O();
-            conv(entry->params[count], t); /* convert the arg on stack appropriately */
-            count++;
-            if (count > num_of_params) {
+            Expr* arg = O();
+            if (count >= num_of_params) {
                 printf("error: too many arguments to function '%s' called in line %i\n", entry->name, entry->line);
                 exit(EXIT_FAILURE);
             }
+            if (arg->type != TK_INT && arg->type != TK_CHAR && arg->type != TK_REAL) {
+                error();
+            }
+            s->args[count] = ast_conv(arg, entry->params[count]); /* convert the arg appropriately */
+            count++;
             if (curtoken.type == TK_COMMA) {
                 gettoken();
             }
@@ -1245,156 +925,110 @@ void procedure_call(void)
             printf("error: too few arguments to function '%s' called in line %i\n", entry->name, entry->line);
             exit(EXIT_FAILURE);
         }
-        /* 
-        for function call 'func(a,b,c);' the stack before reversal should look like
-
-        retaddr
-        c
-        b
-        a
-
-        so that after reverse(count+1), it will look like
-
-        a
-        b
-        c
-        retaddr
-
-        This means that when the function is called, we take the 3 parameters from stack in the correct order
-        and not in reverse order.
-        
-        When it returns, retaddr will be at the top of the stack.
-
-        Note that the return address pushed cannot be the ip at the time the push instruction is generated
-        because the machine has to skip past 15 instructions (including the push instruction):
-
-        | pushi <retaddr> | reverse <n> | call <procaddr> |
-        0                 5             10                15
-        */
-        int ret_addr = ip + 15;
-        printf("pushi retaddr %i\n", ret_addr);
-        gen_op(op_pushi);
-        gen_addr(ret_addr);
-        printf("reverse %i\n", count+1);
-        gen_op(op_reverse);
-        gen_int(count+1);
+        s->num_of_args = count;
         match(TK_RPAREN);
         match(TK_SEMICOLON);
-        printf("call '%s' (addr: %i)\n", entry->name, entry->addr);
-        gen_op(op_call);
-        gen_addr(entry->addr);
     }
     else {
         error();
     }
+    return s;
 }
 
-void print_statement(void)
+Stmt* print_statement(void)
 {
-    Type t;
+    Stmt* s;
+    int line = curtoken.line;
     match(TK_print);
     if (curtoken.type == TK_STR) {
-        /* push an array of characters onto the stack (in backward order) */
-        int length = strlen(curtoken.s);
-        for (int i = length-1; i >= 0; i--) {
-            printf("pushi '%c'\n", curtoken.s[i]);
-            gen_op(op_pushi);
-            gen_int(curtoken.s[i]);
-        }
+        s = ast_stmt(ST_PRINT_STR, line);
+        s->str = name_of(curtoken.id);
         gettoken();
-        for (int i = 0; i < length; i++) {
-            printf("op_printchar\n");
-            gen_op(op_printchar);
-        }
-        printf("op_println\n");
-        gen_op(op_println);
     }
     else {
-        t = O();
-        if (t == TK_INT) {
-            printf("op_printint\n");
-            gen_op(op_printint);
-            printf("op_println\n");
-            gen_op(op_println);
-        }
-        else if (t == TK_REAL) {
-            printf("op_printfloat\n");
-            gen_op(op_printfloat);
-            printf("op_println\n");
-            gen_op(op_println);
-        }
-        else if (t == TK_CHAR) {
-            printf("op_printchar\n");
-            gen_op(op_printchar);
-            printf("op_println\n");
-            gen_op(op_println);
-        }
-        else {
+        s = ast_stmt(ST_PRINT, line);
+        s->expr = O();
+        Type t = s->expr->type;
+        if (t != TK_INT && t != TK_REAL && t != TK_CHAR) {
             printf("error: invalid type operand to print\n");
             exit(EXIT_FAILURE);
         }
     }
     match(TK_SEMICOLON);
+    return s;
 }
 
 void begin_scope(void)
 {
-    push_symtab(create_table(), &symtabs);
+    push_scope();
 }
 
 void end_scope(void)
 {
-    remove_symtab(&symtabs);
+    pop_scope();
 }
 
 void start(void)
 {
-    Node* mainproc = search_symtabs(&symtabs, "main"); /* find entry in symtab */
+    Node* mainproc = search_id(intern("main", 4)); /* find entry in symtab */
     if (mainproc == NULL) {
         printf("error: undefined reference to function 'main'\n");
         exit(EXIT_FAILURE);
     }
-    else {
-        int ret_addr = ip + 10;
-        printf("pushi retaddr %i\n", ret_addr);
-        gen_op(op_pushi);
-        gen_addr(ret_addr);
-
-        printf("call 'main' (addr: %i)\n", mainproc->addr);
-        gen_op(op_call);
-        gen_addr(mainproc->addr);
+    for (Proc* p = program.procs; p != NULL; p = p->next) {
+        if (p->entry == mainproc) {
+            program.main = p;
+        }
+    }
+    if (program.main == NULL) {
+        printf("error: 'main' is not a procedure\n");
+        exit(EXIT_FAILURE);
     }
 }
 
 void parse(void)
 {
-    code = malloc(100000);
-    FILE* fp = read_file(sourcefile);
-    toks = scan(); /* get tokens from tokenizer */
-    print_tokens(toks); /* print the tokens */
-    printf("\n");
+    intern_reset(); /* (the names of a compilation before this one aren't needed anymore) */
+    if (buf == NULL) {
+        read_file(sourcefile); /* (unless it was read already, to look it up in the compile cache) */
+    }
+    if (TRACE(TRACE_TOKENS)) {
+        print_tokens(); /* print the tokens (tokenizing the whole source once more) */
+        printf("\n");
+    }
+    open_token_stream(); /* the parser gets the tokens from the tokenizer as it goes */
 
-    /* initialize the stack of symbol tables */
-    symtabs.top = -1;
-    List* tab = create_table();
-    push_symtab(tab, &symtabs);
+    /* initialize the symbol table (in the global scope) */
+    symtab_init();
 
     /* move to the first token */
-    while (toks[0].type == TK_EOL) {
-        toks++;
+    while (peek_token(0)->type == TK_EOL) {
+        pop_token();
     }
-    curtoken = toks[0];
+    curtoken = *peek_token(0);
 
+    /* build the syntax tree */
     G();
+    free_source(); /* (the names in the tokens were interned: the source isn't needed anymore) */
 
-    /* append instructions to call main */
+    /* find main, which is called once the globals are initialized */
     start();
 
-    /* append halt instr */
-    printf("halt\n");
-    gen_op(op_halt);
+    /* lower the tree to the IR, and generate the code array (and the register code) from it */
+    ir_lower(&program);
+    if (TRACE(TRACE_IR)) {
+        ir_print();
+    }
+    codegen();
+    reg_codegen();
 
-    for (int i = 0; i < ip; i++) {
-        printf("%i\n", code[i]);
+    optimize();
+    compute_stack_need();
+
+    if (TRACE(TRACE_BYTES)) {
+        for (int i = 0; i < ip; i++) {
+            printf("%i\n", code[i]);
+        }
     }
+    arena_reset(&ast_arena); /* (the blocks are kept for the next compilation) */
 }
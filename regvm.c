@@ -0,0 +1,554 @@
+#include "regvm.h"
+#include "codegen.h"
+#include "parser.h"
+
+int* reg_code;                 /* register code array */
+unsigned int reg_code_size;    /* number of words written to reg_code */
+unsigned int reg_code_capacity;
+unsigned int reg_data_size;    /* bytes in the register file */
+unsigned int* reg_proc_starts; /* where each function starts */
+const char** reg_proc_names;
+int num_of_reg_procs;
+
+const char* rop_names[NUM_ROPS] = {
+    "mov",
+    "add", "fadd", "sub", "fsub", "mul", "fmul", "div", "fdiv", "mod", "shl",
+    "and", "or", "eq", "neq", "less", "leq", "greater", "geq",
+    "iand", "ior", "ieq", "ineq", "ilt", "ile", "igt", "ige",
+    "neg", "fneg", "conv_to_float", "conv_to_int",
+    "load_elem", "store_elem",
+    "jmp",
+    "jtrue", "jfalse", "ijtrue", "ijfalse",
+    "jlt", "jle", "jgt", "jge", "jeq", "jne",
+    "call", "return",
+    "save", "restore", "clear",
+    "printint", "printfloat", "printchar", "println",
+    "halt",
+};
+
+/* The constant pool: the bits of each constant of the program, at dp + 4 * (its index) in the register file */
+int* consts;
+int num_of_consts;
+int consts_capacity;
+/* and a hash table of the constants (open addressing, hashed by multiplication): the index of the constant in each
+slot, or -1; it's doubled when it gets half full, so that finding a constant takes the same time however many there are */
+int* const_slots;
+unsigned int num_of_const_slots; /* (a power of 2) */
+unsigned int const_slot_shift;   /* 32 - log2(num_of_const_slots) */
+
+/* The temps of the function being generated (see reg_gen_block()) */
+int* temp_loc;         /* temp_loc[t]: the register that holds t (for an elt address: the register of the index) */
+int* temp_base;        /* temp_base[t], temp_size[t]: for an elt address, the addr of the array and the elt size */
+int* temp_size;        /* (0 for any other temp) */
+int* temp_top;         /* temp_top[t]: number of temp registers in use while t is live (including its own, if it has one) */
+int* live;             /* the live temps, in the order of their definitions (the IR uses them like a stack) */
+int num_of_live;
+unsigned int temps_base; /* address of the first temp register (after the variables, the constants and the frames) */
+int max_temp_regs;     /* number of temp registers needed so far */
+
+/* Jumps and calls to blocks that haven't been placed yet */
+typedef struct {
+    unsigned int loc;  /* location of the target in the register code array */
+    Block* target;
+} RegFixup;
+
+RegFixup* reg_fixups;
+int num_of_reg_fixups;
+int reg_fixups_capacity;
+
+int rop_size(unsigned char op)
+{
+    if (op == rop_mov || (op >= rop_neg && op <= rop_conv_to_int) || (op >= rop_jtrue && op <= rop_ijfalse)) {
+        return 3;
+    }
+    else if (op >= rop_add && op <= rop_ige) {
+        return 4;
+    }
+    else if (op == rop_load_elem || op == rop_store_elem) {
+        return 5;
+    }
+    else if (op >= rop_jlt && op <= rop_jne) {
+        return 4;
+    }
+    else if (op >= rop_save && op <= rop_clear) {
+        return 3;
+    }
+    else if (op == rop_jmp || op == rop_call || (op >= rop_printint && op <= rop_printchar)) {
+        return 2;
+    }
+    else {
+        return 1; /* return, println, halt */
+    }
+}
+
+/* the register op that does the same as a stack op (of IR_UNARY, IR_BINARY or IR_PRINT) */
+unsigned char reg_op(unsigned char op)
+{
+    if (op >= op_add && op <= op_shl) {
+        return rop_add + (op - op_add);
+    }
+    else if (op >= op_and && op <= op_geq) {
+        return rop_and + (op - op_and);
+    }
+    else if (op >= op_iand && op <= op_ige) {
+        return rop_iand + (op - op_iand);
+    }
+    else if (op == op_neg || op == op_fneg) {
+        return rop_neg + (op - op_neg);
+    }
+    else if (op == op_conv_to_float || op == op_conv_to_int) {
+        return rop_conv_to_float + (op - op_conv_to_float);
+    }
+    else {
+        return rop_printint + (op - op_printint);
+    }
+}
+
+/* the compare-and-branch op that jumps if an int comparison is true (or false, if negate is set),
+or -1 if the op is not an int comparison */
+int reg_compare_jump(unsigned char op, int negate)
+{
+    switch (op) {
+        case op_ilt:  return negate ? rop_jge : rop_jlt;
+        case op_ile:  return negate ? rop_jgt : rop_jle;
+        case op_igt:  return negate ? rop_jle : rop_jgt;
+        case op_ige:  return negate ? rop_jlt : rop_jge;
+        case op_ieq:  return negate ? rop_jne : rop_jeq;
+        case op_ineq: return negate ? rop_jeq : rop_jne;
+        default:      return -1;
+    }
+}
+
+void reg_emit(int word)
+{
+    if (reg_code_size == reg_code_capacity) {
+        reg_code_capacity = reg_code_capacity ? 2 * reg_code_capacity : 1024;
+        reg_code = realloc(reg_code, reg_code_capacity * sizeof (int));
+        if (reg_code == NULL) {
+            printf("realloc() failed for register code array\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    reg_code[reg_code_size++] = word;
+}
+
+/* write the location of a block (to be filled in once all the blocks are placed) */
+void reg_emit_target(Block* target)
+{
+    if (num_of_reg_fixups == reg_fixups_capacity) {
+        reg_fixups_capacity = reg_fixups_capacity ? 2 * reg_fixups_capacity : 64;
+        reg_fixups = realloc(reg_fixups, reg_fixups_capacity * sizeof (RegFixup));
+        if (reg_fixups == NULL) {
+            printf("realloc() failed\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    reg_fixups[num_of_reg_fixups].loc = reg_code_size;
+    reg_fixups[num_of_reg_fixups].target = target;
+    num_of_reg_fixups++;
+    reg_emit(0);
+}
+
+/* the slot of the constant of given bits: the one it's in, or else the empty one where it would go */
+unsigned int find_const_slot(int bits)
+{
+    unsigned int s = ((unsigned int) bits * 2654435769u) >> const_slot_shift;
+    while (const_slots[s] != -1 && consts[const_slots[s]] != bits) {
+        s = (s + 1) & (num_of_const_slots - 1);
+    }
+    return s;
+}
+
+/* make the hash table of the constants twice as large (or create it), and put every constant back in it */
+void grow_const_slots(void)
+{
+    num_of_const_slots = num_of_const_slots == 0 ? 256 : 2 * num_of_const_slots;
+    const_slot_shift = num_of_const_slots == 256 ? 24 : const_slot_shift - 1;
+    free(const_slots);
+    const_slots = malloc(num_of_const_slots * sizeof (int));
+    if (const_slots == NULL) {
+        printf("malloc() failed\n");
+        exit(EXIT_FAILURE);
+    }
+    memset(const_slots, 0xFF, num_of_const_slots * sizeof (int));
+    for (int k = 0; k < num_of_consts; k++) {
+        const_slots[find_const_slot(consts[k])] = k;
+    }
+}
+
+/* the register of a constant (given its bits) */
+int const_reg(int bits)
+{
+    int k = const_slots[find_const_slot(bits)];
+    if (k == -1) {
+        printf("internal error: constant %i is not in the pool\n", bits);
+        exit(EXIT_FAILURE);
+    }
+    return dp + 4 * k;
+}
+
+/* put every constant of the IR in the pool (once) */
+void collect_consts(void)
+{
+    num_of_consts = 0;
+    if (num_of_const_slots == 0) {
+        grow_const_slots();
+    }
+    else {
+        /* empty the table of the previous compilation (keeping its memory) */
+        memset(const_slots, 0xFF, num_of_const_slots * sizeof (int));
+    }
+    for (int f = 0; f < num_of_ir_funcs; f++) {
+        IRFunc* func = ir_funcs[f];
+        for (int i = 0; i < func->num_of_blocks; i++) {
+            Block* block = func->blocks[i];
+            for (int j = 0; j < block->num_of_instrs; j++) {
+                if (block->instrs[j].kind != IR_CONST) {
+                    continue;
+                }
+                int bits = block->instrs[j].imm;
+                unsigned int s = find_const_slot(bits);
+                if (const_slots[s] != -1) {
+                    continue;
+                }
+                if (num_of_consts == consts_capacity) {
+                    consts_capacity = consts_capacity ? 2 * consts_capacity : 64;
+                    consts = realloc(consts, consts_capacity * sizeof (int));
+                    if (consts == NULL) {
+                        printf("realloc() failed\n");
+                        exit(EXIT_FAILURE);
+                    }
+                }
+                consts[num_of_consts] = bits;
+                const_slots[s] = num_of_consts++;
+                if (2 * (unsigned int) num_of_consts > num_of_const_slots) {
+                    grow_const_slots();
+                }
+            }
+        }
+    }
+}
+
+/* number of temp registers in use */
+int top_of_temps(void)
+{
+    return num_of_live > 0 ? temp_top[live[num_of_live - 1]] : 0;
+}
+
+/* a new temp register (after the ones in use) */
+int new_temp_reg(void)
+{
+    int k = top_of_temps();
+    if (k + 1 > max_temp_regs) {
+        max_temp_regs = k + 1;
+    }
+    return k;
+}
+
+/* define a temp that is held in a register (top: the number of temp registers in use while it is live) */
+void define(int t, int reg, int top)
+{
+    temp_loc[t] = reg;
+    temp_base[t] = temp_size[t] = 0;
+    temp_top[t] = top;
+    live[num_of_live++] = t;
+}
+
+/* define a temp that is computed into a new temp register, and return the register */
+int define_in_temp_reg(int t)
+{
+    int k = new_temp_reg();
+    define(t, temps_base + 4 * k, k + 1);
+    return temps_base + 4 * k;
+}
+
+/* the temp is used: it must be the last live one */
+int use(int t)
+{
+    if (num_of_live == 0 || live[num_of_live - 1] != t) {
+        printf("internal error: t%i is not the last live temp\n", t);
+        exit(EXIT_FAILURE);
+    }
+    num_of_live--;
+    return temp_loc[t];
+}
+
+/* the register of the variable (or array) of an IR_LOAD, IR_STORE, IR_ELEM_ADDR or IR_PARAM of a function */
+int var_reg(IRFunc* func, IRInstr* instr)
+{
+    return instr->local ? func->home + instr->imm : instr->imm;
+}
+
+/* the register that the value of an instruction goes to: the variable it is stored into right away, if any
+(in which case the store is skipped), or a new temp register */
+int dest(IRFunc* func, IRInstr* instr, IRInstr* next, int* skip)
+{
+    if (next != NULL && next->kind == IR_STORE && next->a == instr->dst) {
+        *skip = 1;
+        return var_reg(func, next);
+    }
+    return define_in_temp_reg(instr->dst);
+}
+
+/* the addresses of the parameters of a function (in the order of the args) */
+int param_addr(IRFunc* func, int i)
+{
+    return var_reg(func, &func->blocks[0]->instrs[i]); /* the IR_PARAMs come first */
+}
+
+void reg_gen_block(IRFunc* func, Block* block)
+{
+    Block* next_block = block->id + 1 < func->num_of_blocks ? func->blocks[block->id + 1] : NULL;
+    if (block->id == 0 && func->frame_size > 4 * func->num_of_params) {
+        /* the locals start out as 0 on every call (the params have been copied in by the call) */
+        reg_emit(rop_clear);
+        reg_emit(func->home + 4 * func->num_of_params);
+        reg_emit(func->frame_size - 4 * func->num_of_params);
+    }
+    for (int j = 0; j < block->num_of_instrs; j++) {
+        IRInstr* instr = &block->instrs[j];
+        IRInstr* next = j + 1 < block->num_of_instrs ? &block->instrs[j + 1] : NULL;
+        int real = instr->type == TK_REAL;
+        int skip = 0; /* skip the next instruction (it has been fused with this one)? */
+        int a, b, d, top;
+        switch (instr->kind) {
+            case IR_CONST:
+                /* no op: the constant is read from the pool */
+                define(instr->dst, const_reg(instr->imm), top_of_temps());
+                break;
+            case IR_LOAD:
+                /* no op: the variable is read directly */
+                define(instr->dst, var_reg(func, instr), top_of_temps());
+                break;
+            case IR_STORE:
+                a = use(instr->a);
+                if (a != var_reg(func, instr)) {
+                    reg_emit(rop_mov);
+                    reg_emit(var_reg(func, instr));
+                    reg_emit(a);
+                }
+                break;
+            case IR_PARAM:
+                /* no op: the call has copied the arg into the parameter */
+                break;
+            case IR_ELEM_ADDR:
+                /* no op: the get or put that uses the addr computes it (and the index stays in its register until then) */
+                top = temp_top[instr->a];
+                a = use(instr->a);
+                define(instr->dst, a, top);
+                temp_base[instr->dst] = var_reg(func, instr);
+                temp_size[instr->dst] = instr->imm2;
+                break;
+            case IR_GET: {
+                int elt = instr->a;
+                a = use(elt);
+                d = dest(func, instr, next, &skip);
+                reg_emit(rop_load_elem);
+                reg_emit(d);
+                reg_emit(a);
+                reg_emit(temp_base[elt]);
+                reg_emit(temp_size[elt]);
+                break;
+            }
+            case IR_PUT: {
+                int elt = instr->a;
+                b = use(instr->b);
+                a = use(elt);
+                reg_emit(rop_store_elem);
+                reg_emit(a);
+                reg_emit(temp_base[elt]);
+                reg_emit(temp_size[elt]);
+                reg_emit(b);
+                break;
+            }
+            case IR_UNARY:
+                a = use(instr->a);
+                d = dest(func, instr, next, &skip);
+                reg_emit(reg_op(instr->op));
+                reg_emit(d);
+                reg_emit(a);
+                break;
+            case IR_BINARY:
+                b = use(instr->b);
+                a = use(instr->a);
+                if (next != NULL && next->kind == IR_BRANCH && next->a == instr->dst && reg_compare_jump(instr->op, 0) >= 0) {
+                    /* compare and branch */
+                    skip = 1;
+                    if (next->target == next_block) {
+                        reg_emit(reg_compare_jump(instr->op, 1));
+                        reg_emit(a);
+                        reg_emit(b);
+                        reg_emit_target(next->target2);
+                    }
+                    else {
+                        reg_emit(reg_compare_jump(instr->op, 0));
+                        reg_emit(a);
+                        reg_emit(b);
+                        reg_emit_target(next->target);
+                        if (next->target2 != next_block) {
+                            reg_emit(rop_jmp);
+                            reg_emit_target(next->target2);
+                        }
+                    }
+                    break;
+                }
+                d = dest(func, instr, next, &skip);
+                reg_emit(reg_op(instr->op));
+                reg_emit(d);
+                reg_emit(a);
+                reg_emit(b);
+                break;
+            case IR_PRINT:
+                a = use(instr->a);
+                reg_emit(reg_op(instr->op));
+                reg_emit(a);
+                break;
+            case IR_PRINTLN:
+                reg_emit(rop_println);
+                break;
+            case IR_CALL: {
+                int n = instr->num_of_args;
+                int* regs = malloc((n + 1) * sizeof (int));
+                if (regs == NULL) {
+                    printf("malloc() failed\n");
+                    exit(EXIT_FAILURE);
+                }
+                top = top_of_temps(); /* (the registers of the args are in use until they have all been copied) */
+                for (int i = n - 1; i >= 0; i--) {
+                    regs[i] = use(instr->args[i]);
+                }
+                /* a recursive call would overwrite the frame of the caller (the args are still read from it) */
+                if (instr->imm && func->frame_size > 0) {
+                    reg_emit(rop_save);
+                    reg_emit(func->home);
+                    reg_emit(func->frame_size);
+                }
+                /* an arg that is read from a parameter that an earlier arg is copied into must be saved first */
+                for (int i = 0; i < n; i++) {
+                    for (int k = 0; k < i; k++) {
+                        if (regs[i] == param_addr(instr->func, k) && regs[i] != regs[k]) {
+                            if (top + 1 > max_temp_regs) {
+                                max_temp_regs = top + 1;
+                            }
+                            reg_emit(rop_mov);
+                            reg_emit(temps_base + 4 * top);
+                            reg_emit(regs[i]);
+                            regs[i] = temps_base + 4 * top;
+                            top++;
+                            break;
+                        }
+                    }
+                }
+                for (int i = 0; i < n; i++) {
+                    if (regs[i] != param_addr(instr->func, i)) {
+                        reg_emit(rop_mov);
+                        reg_emit(param_addr(instr->func, i));
+                        reg_emit(regs[i]);
+                    }
+                }
+                free(regs);
+                reg_emit(rop_call);
+                reg_emit_target(instr->func->blocks[0]);
+                if (instr->imm && func->frame_size > 0) {
+                    reg_emit(rop_restore);
+                    reg_emit(func->home);
+                    reg_emit(func->frame_size);
+                }
+                break;
+            }
+            case IR_JUMP:
+                if (instr->target != next_block) {
+                    reg_emit(rop_jmp);
+                    reg_emit_target(instr->target);
+                }
+                break;
+            case IR_BRANCH:
+                a = use(instr->a);
+                if (instr->target == next_block) {
+                    reg_emit(real ? rop_jfalse : rop_ijfalse);
+                    reg_emit(a);
+                    reg_emit_target(instr->target2);
+                }
+                else {
+                    reg_emit(real ? rop_jtrue : rop_ijtrue);
+                    reg_emit(a);
+                    reg_emit_target(instr->target);
+                    if (instr->target2 != next_block) {
+                        reg_emit(rop_jmp);
+                        reg_emit_target(instr->target2);
+                    }
+                }
+                break;
+            case IR_RETURN:
+                reg_emit(rop_return);
+                break;
+            case IR_HALT:
+                reg_emit(rop_halt);
+                break;
+        }
+        j += skip;
+    }
+    if (num_of_live != 0) {
+        printf("internal error: temps left live at the end of a block\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+void reg_codegen(void)
+{
+    collect_consts();
+    /* the frames (homes) of the procedures, after the constants */
+    temps_base = dp + 4 * num_of_consts;
+    for (int f = 0; f < num_of_ir_funcs; f++) {
+        ir_funcs[f]->home = temps_base;
+        temps_base += ir_funcs[f]->frame_size;
+    }
+    max_temp_regs = 0;
+    reg_code_size = 0;
+    num_of_reg_fixups = 0;
+    reg_proc_starts = malloc(num_of_ir_funcs * sizeof (unsigned int));
+    reg_proc_names = malloc(num_of_ir_funcs * sizeof (char*));
+    if (reg_proc_starts == NULL || reg_proc_names == NULL) {
+        printf("malloc() failed\n");
+        exit(EXIT_FAILURE);
+    }
+    num_of_reg_procs = num_of_ir_funcs;
+    for (int f = 0; f < num_of_ir_funcs; f++) {
+        IRFunc* func = ir_funcs[f];
+        reg_proc_starts[f] = reg_code_size;
+        reg_proc_names[f] = func->name;
+        int n = func->num_of_temps + 1;
+        temp_loc = malloc(n * sizeof (int));
+        temp_base = malloc(n * sizeof (int));
+        temp_size = malloc(n * sizeof (int));
+        temp_top = malloc(n * sizeof (int));
+        live = malloc(n * sizeof (int));
+        if (temp_loc == NULL || temp_base == NULL || temp_size == NULL || temp_top == NULL || live == NULL) {
+            printf("malloc() failed\n");
+            exit(EXIT_FAILURE);
+        }
+        for (int i = 0; i < func->num_of_blocks; i++) {
+            Block* block = func->blocks[i];
+            block->reg_loc = reg_code_size;
+            num_of_live = 0;
+            reg_gen_block(func, block);
+        }
+        free(temp_loc);
+        free(temp_base);
+        free(temp_size);
+        free(temp_top);
+        free(live);
+    }
+    for (int i = 0; i < num_of_reg_fixups; i++) {
+        reg_code[reg_fixups[i].loc] = reg_fixups[i].target->reg_loc;
+    }
+    free(reg_fixups);
+    reg_fixups = NULL;
+    reg_fixups_capacity = 0;
+    reg_data_size = temps_base + 4 * max_temp_regs;
+}
+
+void reg_init_data(unsigned char* data)
+{
+    memcpy(data + dp, consts, num_of_consts * sizeof (int));
+}
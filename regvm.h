@@ -0,0 +1,77 @@
+#ifndef REGVM_H
+#define REGVM_H
+
+#include "ir.h"
+
+/*
+Backend for the register VM (see vm.c, --engine=register): generates a register code array from the IR (see ir.h).
+
+The stack VM spends most of its ops moving values between the data array and the operand stack
+(push, pop, exch...). The register VM has no operand stack: every operand of an op is a register,
+i.e., the address of a 4-byte slot of its data array (the register file), which holds
+    the variables      at the same addresses as in the data array of the stack VM (from 0 to dp),
+    the constants      used by the program (each one once), in a pool filled in before the program runs,
+    the frames         of the procedures: the params and locals of each one, at a fixed address (its home),
+    the temps          of the IR that can't be read directly from a variable or a constant (reused from block to block).
+So a load, a constant or a conversion of a constant costs no op at all, and
+    x = y * (z + 1);
+becomes
+    add  @t0, @z, @K1
+    mul  @x, @y, @t0
+instead of push y; push z; pushi 1; add; mul; pop x.
+
+An op and each of its arguments take 1 word of the register code array; branch targets are absolute locations in it.
+An int comparison that is only tested by a branch is fused with it (e.g., jlt a b target),
+and a value that is only stored into a variable is computed directly into it.
+
+A call copies the args into the parameters of the procedure (the callee's IR_PARAMs then need no op) and pushes the
+return address onto a return stack of its own; the procedure starts by clearing its locals (after the params).
+Since every call of a procedure uses the same home, a recursive call saves the frame of the caller on a save stack
+before it copies the args, and restores it once the callee has returned:
+    save @f, 12; mov @f+0, @t0; call f; restore @f, 12
+(a procedure can only call itself recursively, since it can't call the ones defined after it).
+*/
+
+#define SAVE_STACK_SIZE (1 << 20) /* bytes of the frames saved by recursive calls */
+/* return addresses of the register VM: enough for a recursion whose frames (a word each, at least) fill the save stack */
+#define RETURN_STACK_SIZE (SAVE_STACK_SIZE / 4)
+
+enum {
+    rop_mov,                                                     /* mov d a: d = a */
+    rop_add, rop_fadd, rop_sub, rop_fsub, rop_mul, rop_fmul, rop_div, rop_fdiv, rop_mod, rop_shl, /* add d a b: d = a + b */
+    rop_and, rop_or, rop_eq, rop_neq, rop_less, rop_leq, rop_greater, rop_geq, /* of two floats (the result is an int) */
+    rop_iand, rop_ior, rop_ieq, rop_ineq, rop_ilt, rop_ile, rop_igt, rop_ige, /* of two ints */
+    rop_neg, rop_fneg, rop_conv_to_float, rop_conv_to_int,      /* neg d a: d = -a */
+    rop_load_elem, rop_store_elem,                               /* load_elem d i base size: d = the elt at base + i * size;
+                                                                    store_elem i base size a: the elt at base + i * size = a */
+    rop_jmp,                                                     /* jmp target */
+    rop_jtrue, rop_jfalse, rop_ijtrue, rop_ijfalse,              /* ijtrue a target: jump if the int a is true */
+    rop_jlt, rop_jle, rop_jgt, rop_jge, rop_jeq, rop_jne,        /* jlt a b target: jump if the int a < the int b */
+    rop_call, rop_return,                                        /* call target */
+    rop_save, rop_restore, rop_clear,                            /* save base size: push the size bytes of registers at base
+                                                                    onto the save stack (restore: pop them back; clear: zero them) */
+    rop_printint, rop_printfloat, rop_printchar, rop_println,    /* printint a */
+    rop_halt,
+    NUM_ROPS
+};
+
+extern const char* rop_names[NUM_ROPS]; /* rop_names[op]: the name of a register op */
+
+extern int* reg_code;                 /* register code array */
+extern unsigned int reg_code_size;    /* number of words in reg_code */
+extern unsigned int reg_data_size;    /* number of bytes in the register file (variables, constants and temps) */
+extern unsigned int* reg_proc_starts; /* reg_proc_starts[k]: where the k-th function of the IR starts in reg_code
+                                         (0 for the code that runs first, then the procedures in order) */
+extern const char** reg_proc_names;
+extern int num_of_reg_procs;
+
+int rop_size(unsigned char); /* number of words taken by a register op and its arguments */
+
+/* save and restore the registers of a frame (given their address and size) on the save stack (see vm.c) */
+void save_frame(unsigned char*, unsigned int);
+void restore_frame(unsigned char*, unsigned int);
+
+void reg_codegen(void); /* generate the register code array from the IR in ir_funcs */
+void reg_init_data(unsigned char*); /* fill in the constants of a register file (of reg_data_size bytes) */
+
+#endif
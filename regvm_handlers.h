@@ -0,0 +1,330 @@
+/*
+Instruction handlers of the register VM (see regvm.h).
+
+Like vm_handlers.h, this file is not a regular header: it is included by vm.c inside the register
+interpreter loops, which define CASE(op) and NEXT, and keep ip pointing one past the op being executed
+(i.e., at its first argument). REG(n) is the register (4-byte slot of the data array) whose address is the n-th argument.
+Every transfer of control goes through JUMP_TO(loc) (jumps and branches), CALL_TO(loc) or RETURN_TO(loc),
+which the including function also defines (as ip = loc, unless it watches them, like the JIT engine does).
+*/
+
+CASE(rop_mov) {
+    REG(0) = REG(1);
+    ip += 2;
+    NEXT;
+}
+CASE(rop_add) {
+    REG(0).i = REG(1).i + REG(2).i;
+    ip += 3;
+    NEXT;
+}
+CASE(rop_fadd) {
+    REG(0).f = REG(1).f + REG(2).f;
+    ip += 3;
+    NEXT;
+}
+CASE(rop_sub) {
+    REG(0).i = REG(1).i - REG(2).i;
+    ip += 3;
+    NEXT;
+}
+CASE(rop_fsub) {
+    REG(0).f = REG(1).f - REG(2).f;
+    ip += 3;
+    NEXT;
+}
+CASE(rop_mul) {
+    REG(0).i = REG(1).i * REG(2).i;
+    ip += 3;
+    NEXT;
+}
+CASE(rop_fmul) {
+    REG(0).f = REG(1).f * REG(2).f;
+    ip += 3;
+    NEXT;
+}
+CASE(rop_div) {
+    if (REG(2).i == 0) {
+        printf("Error: division by zero\n");
+        exit(EXIT_FAILURE);
+    }
+    REG(0).i = REG(1).i / REG(2).i;
+    ip += 3;
+    NEXT;
+}
+CASE(rop_fdiv) {
+    if (REG(2).f == 0) {
+        printf("Error: division by zero\n");
+        exit(EXIT_FAILURE);
+    }
+    REG(0).f = REG(1).f / REG(2).f;
+    ip += 3;
+    NEXT;
+}
+CASE(rop_mod) {
+    REG(0).i = REG(1).i % REG(2).i;
+    ip += 3;
+    NEXT;
+}
+CASE(rop_shl) {
+    REG(0).i = (int) ((unsigned int) REG(1).i << REG(2).i);
+    ip += 3;
+    NEXT;
+}
+/* comparisons of two floats */
+CASE(rop_and) {
+    REG(0).i = REG(1).f && REG(2).f;
+    ip += 3;
+    NEXT;
+}
+CASE(rop_or) {
+    REG(0).i = REG(1).f || REG(2).f;
+    ip += 3;
+    NEXT;
+}
+CASE(rop_eq) {
+    REG(0).i = REG(1).f == REG(2).f;
+    ip += 3;
+    NEXT;
+}
+CASE(rop_neq) {
+    REG(0).i = REG(1).f != REG(2).f;
+    ip += 3;
+    NEXT;
+}
+CASE(rop_less) {
+    REG(0).i = REG(1).f < REG(2).f;
+    ip += 3;
+    NEXT;
+}
+CASE(rop_leq) {
+    REG(0).i = REG(1).f <= REG(2).f;
+    ip += 3;
+    NEXT;
+}
+CASE(rop_greater) {
+    REG(0).i = REG(1).f > REG(2).f;
+    ip += 3;
+    NEXT;
+}
+CASE(rop_geq) {
+    REG(0).i = REG(1).f >= REG(2).f;
+    ip += 3;
+    NEXT;
+}
+/* comparisons of two ints */
+CASE(rop_iand) {
+    REG(0).i = REG(1).i && REG(2).i;
+    ip += 3;
+    NEXT;
+}
+CASE(rop_ior) {
+    REG(0).i = REG(1).i || REG(2).i;
+    ip += 3;
+    NEXT;
+}
+CASE(rop_ieq) {
+    REG(0).i = REG(1).i == REG(2).i;
+    ip += 3;
+    NEXT;
+}
+CASE(rop_ineq) {
+    REG(0).i = REG(1).i != REG(2).i;
+    ip += 3;
+    NEXT;
+}
+CASE(rop_ilt) {
+    REG(0).i = REG(1).i < REG(2).i;
+    ip += 3;
+    NEXT;
+}
+CASE(rop_ile) {
+    REG(0).i = REG(1).i <= REG(2).i;
+    ip += 3;
+    NEXT;
+}
+CASE(rop_igt) {
+    REG(0).i = REG(1).i > REG(2).i;
+    ip += 3;
+    NEXT;
+}
+CASE(rop_ige) {
+    REG(0).i = REG(1).i >= REG(2).i;
+    ip += 3;
+    NEXT;
+}
+CASE(rop_neg) {
+    REG(0).i = -REG(1).i;
+    ip += 2;
+    NEXT;
+}
+CASE(rop_fneg) {
+    REG(0).f = -REG(1).f;
+    ip += 2;
+    NEXT;
+}
+CASE(rop_conv_to_float) {
+    REG(0).f = REG(1).i;
+    ip += 2;
+    NEXT;
+}
+CASE(rop_conv_to_int) {
+    REG(0).i = REG(1).f;
+    ip += 2;
+    NEXT;
+}
+CASE(rop_load_elem) { /* args: destination, index, addr of the array, elt size */
+    REG(0) = DATA(ARGN(2).i + REG(1).i * ARGN(3).i);
+    ip += 4;
+    NEXT;
+}
+CASE(rop_store_elem) { /* args: index, addr of the array, elt size, value */
+    DATA(ARGN(1).i + REG(0).i * ARGN(2).i) = REG(3);
+    ip += 4;
+    NEXT;
+}
+CASE(rop_jmp) {
+    JUMP_TO(ARGN(0).i);
+    NEXT;
+}
+CASE(rop_jtrue) {
+    if (REG(0).f) {
+        JUMP_TO(ARGN(1).i);
+    }
+    else {
+        ip += 2;
+    }
+    NEXT;
+}
+CASE(rop_jfalse) {
+    if (!REG(0).f) {
+        JUMP_TO(ARGN(1).i);
+    }
+    else {
+        ip += 2;
+    }
+    NEXT;
+}
+CASE(rop_ijtrue) {
+    if (REG(0).i) {
+        JUMP_TO(ARGN(1).i);
+    }
+    else {
+        ip += 2;
+    }
+    NEXT;
+}
+CASE(rop_ijfalse) {
+    if (!REG(0).i) {
+        JUMP_TO(ARGN(1).i);
+    }
+    else {
+        ip += 2;
+    }
+    NEXT;
+}
+CASE(rop_jlt) {
+    if (REG(0).i < REG(1).i) {
+        JUMP_TO(ARGN(2).i);
+    }
+    else {
+        ip += 3;
+    }
+    NEXT;
+}
+CASE(rop_jle) {
+    if (REG(0).i <= REG(1).i) {
+        JUMP_TO(ARGN(2).i);
+    }
+    else {
+        ip += 3;
+    }
+    NEXT;
+}
+CASE(rop_jgt) {
+    if (REG(0).i > REG(1).i) {
+        JUMP_TO(ARGN(2).i);
+    }
+    else {
+        ip += 3;
+    }
+    NEXT;
+}
+CASE(rop_jge) {
+    if (REG(0).i >= REG(1).i) {
+        JUMP_TO(ARGN(2).i);
+    }
+    else {
+        ip += 3;
+    }
+    NEXT;
+}
+CASE(rop_jeq) {
+    if (REG(0).i == REG(1).i) {
+        JUMP_TO(ARGN(2).i);
+    }
+    else {
+        ip += 3;
+    }
+    NEXT;
+}
+CASE(rop_jne) {
+    if (REG(0).i != REG(1).i) {
+        JUMP_TO(ARGN(2).i);
+    }
+    else {
+        ip += 3;
+    }
+    NEXT;
+}
+CASE(rop_call) { /* push the return address onto the return stack and jump to the procedure */
+    if (rsp == rlimit) {
+        too_many_calls(RETURN_STACK_SIZE);
+    }
+    *rsp++ = ip + 1;
+    CALL_TO(ARGN(0).i);
+    NEXT;
+}
+CASE(rop_return) {
+    rsp--;
+    RETURN_TO(*rsp);
+    NEXT;
+}
+CASE(rop_save) { /* save the registers of a frame (args: base, size) before a recursive call */
+    save_frame(data + ARGN(0).i, (unsigned int) ARGN(1).i);
+    ip += 2;
+    NEXT;
+}
+CASE(rop_restore) {
+    restore_frame(data + ARGN(0).i, (unsigned int) ARGN(1).i);
+    ip += 2;
+    NEXT;
+}
+CASE(rop_clear) {
+    memset(data + ARGN(0).i, 0, ARGN(1).i);
+    ip += 2;
+    NEXT;
+}
+CASE(rop_printint) {
+    output_int(REG(0).i);
+    ip++;
+    NEXT;
+}
+CASE(rop_printfloat) {
+    output_float(REG(0).f);
+    ip++;
+    NEXT;
+}
+CASE(rop_printchar) {
+    OUTPUT_CHAR(REG(0).i);
+    ip++;
+    NEXT;
+}
+CASE(rop_println) {
+    output_newline();
+    NEXT;
+}
+CASE(rop_halt) {
+    output_flush();
+    return;
+}
@@ -4,78 +4,33 @@
 
 void stack_init(Stack* stack, int size)
 {
-    item_t *items = malloc(size * sizeof (item_t)); /* allocate space for the stack's items */
+    slot_t *items = malloc(size * sizeof (slot_t)); /* allocate space for the stack's items */
     if (items == NULL) {
         printf("malloc() failed to create stack\n");
         exit(EXIT_FAILURE);
     }
     (*stack).items = items;
+    (*stack).limit = items + size - 1;
     (*stack).capacity = size;
-    (*stack).top = -1;
 }
 
 void stack_free(Stack* stack)
 {
     free((*stack).items); /* free the stack's items */
     (*stack).items = NULL;
-    (*stack).top = -1;
+    (*stack).limit = NULL;
 }
 
-int stack_is_empty(Stack* stack)
-{
-    return (*stack).top < 0;
-}
-
-int stack_is_full(Stack* stack)
-{
-    return (*stack).top == (*stack).capacity - 1;
-}
-
-void push(Stack* stack, item_t item)
-{
-    if (stack_is_full(stack)) {
-        printf("Runtime stack is past its capacity (probably a bug)\n");
-        exit(EXIT_FAILURE);
-    }
-    (*stack).items[++((*stack).top)] = item;
-}
-
-item_t pop(Stack* stack)
-{
-    if (stack_is_empty(stack)) {
-        printf("pop() failed (stack is empty)\n");
-        exit(EXIT_FAILURE);
-    }
-    return (*stack).items[(*stack).top--];
-}
-
-void item_print(item_t item)
-{
-    switch (item.type) {
-        case INT:
-            printf("INT: %d\n", item.i);
-            break;
-        case REAL:
-            printf("FLOAT: %f\n", item.f);
-            break;
-        case CHAR:
-            printf("CHAR: %c\n", item.i);
-            break;
-        case STR:
-            printf("STR: %s\n", item.s);
-            break;
-    }
-}
-
-void stack_print(Stack* stack)
+void stack_print(Stack* stack, slot_t* sp, slot_t tos)
 {
     printf("Printing stack contents:\n");
-    if (!stack_is_empty(stack)) {
-        for (int i = (*stack).top; i >= 0; i--) {
-            item_print((*stack).items[i]);
-        }
-    }
-    else {
+    if (sp == (*stack).items) {
         printf("<EMPTY>\n");
+        return;
+    }
+    /* items are untagged, so show both interpretations of each one */
+    printf("%d / %f\n", tos.i, tos.f);
+    for (slot_t* p = sp; p > (*stack).items; p--) {
+        printf("%d / %f\n", (*p).i, (*p).f);
     }
 }
@@ -1,26 +1,30 @@
 #ifndef STACK_H
 #define STACK_H
 
-#define INT     0
-#define REAL    1
-#define CHAR    2
-#define STR     3
+/*
+The operand stack of the virtual machine.
 
-typedef struct item_t item_t;
+Items are untagged 32-bit slots: the parser knows statically whether a value is an int (or char) or a float,
+and picks the matching op (e.g., add or fadd), so the stack never has to record an item's type.
+
+While a program runs, the top item is kept in a local variable of the interpreter (tos) and sp points to the
+item below it, so most ops read and write the stack without going through memory. items[0] is never a real item:
+it receives the (meaningless) top of an empty stack when the first item is pushed.
+Overflow is not checked on every push: the parser computes how many items each straight-line run of code can push
+(see stack_need in parser.h), and the interpreter checks that once, whenever it branches.
+*/
+
+typedef union slot_t slot_t;
 typedef struct Stack Stack;
 
-struct item_t {
-    char type;
-    union {
-        int i;
-        float f;
-        char* s;
-    };
+union slot_t {
+    int i;
+    float f;
 };
 
 struct Stack {
-    item_t *items;
-    int top; /* -1 if empty (otherwise between 0 and capacity-1) */
+    slot_t *items;
+    slot_t *limit; /* the last usable slot */
     int capacity;
 };
 
@@ -30,22 +34,7 @@ void stack_init(Stack*, int);
 /* Remove all of a stack's items */
 void stack_free(Stack*);
 
-/* Test if a stack is empty */
-int stack_is_empty(Stack*);
-
-/* Test if a stack is full */
-int stack_is_full(Stack*);
-
-/* Push item onto stack */
-void push(Stack*, item_t);
-
-/* Remove top item from stack */
-item_t pop(Stack*);
-
-/* Print an item */
-void item_print(item_t);
-
-/* Print a stack */
-void stack_print(Stack*);
+/* Print a stack, given its current top (tos) and the position of the item below it (sp) */
+void stack_print(Stack*, slot_t*, slot_t);
 
-#endif
\ No newline at end of file
+#endif
@@ -1,137 +1,177 @@
 #include "symtab.h"
+#include "intern.h"
+#include "arena.h"
 
-#define TABLE_SIZE 27
+#define SYMBOL_NONE 0xFFFFFFFFu /* the id of an empty slot */
 
-int h(char* id)
+typedef struct {
+    unsigned int id;   /* the interned name (or SYMBOL_NONE) */
+    unsigned int hash; /* the hash of id */
+    Node* node;        /* its innermost declaration in scope (NULL if it's out of every scope) */
+} Slot;
+
+Slot* slots = NULL;
+unsigned int num_of_slots = 0;   /* (a power of 2) */
+unsigned int slot_shift = 32;    /* 32 - log2(num_of_slots) */
+unsigned int num_of_names_declared = 0; /* number of slots in use */
+
+Node** undo_log = NULL;          /* the declarations made in the scopes that are open, in order */
+unsigned int undo_log_size = 0;
+unsigned int undo_log_capacity = 0;
+typedef struct {
+    unsigned int undo_log_size; /* the length of the undo log when the scope was opened */
+    ArenaMark nodes;            /* and the state of the arena of nodes */
+} ScopeMark;
+
+ScopeMark* scope_marks = NULL; /* scope_marks[k]: when scope k + 1 was opened */
+int scope_depth = 0;           /* the innermost scope (0: the globals) */
+int scope_marks_capacity = 0;
+
+Arena symtab_arena = {NULL, NULL, 1 << 16}; /* the nodes: a region for each scope, released when it's closed */
+
+/* Fibonacci hashing: the ids are consecutive, and multiplying spreads them over the whole table */
+unsigned int hash_id(unsigned int id)
 {
-    if (id[0] == '_') {
-        return 26;
-    }
-    else {
-        return tolower(id[0]) - 'a';
-    }
+    return id * 2654435769u;
 }
 
-List* create_table(void)
+void grow_slots(void)
 {
-    List* table = malloc(TABLE_SIZE * sizeof (List));
-    if (table == NULL) {
+    Slot* old = slots;
+    unsigned int old_size = num_of_slots;
+    num_of_slots = num_of_slots == 0 ? 256 : 2 * num_of_slots;
+    slot_shift = num_of_slots == 256 ? 24 : slot_shift - 1;
+    slots = malloc(num_of_slots * sizeof (Slot));
+    if (slots == NULL) {
         printf("malloc() failed\n");
         exit(EXIT_FAILURE);
     }
-    /* initialize the table's lists to NULL */
-    for (int i = 0; i < TABLE_SIZE; i++) {
-        table[i].head = NULL;
+    for (unsigned int i = 0; i < num_of_slots; i++) {
+        slots[i].id = SYMBOL_NONE;
     }
-    return table;
-}
-
-void free_table(List* table)
-{
-    for (int i = 0; i < TABLE_SIZE; i++) {
-        Node* head = table[i].head;
-        Node* copy;
-        while (head != NULL) {
-            copy = head;
-            head = (*head).next;
-            free(copy);
+    /* move every name to its slot in the new table (and update the nodes that point to their slot) */
+    for (unsigned int i = 0; i < old_size; i++) {
+        if (old[i].id != SYMBOL_NONE) {
+            unsigned int s = old[i].hash >> slot_shift; /* (the top bits of the hash, which are the best mixed) */
+            while (slots[s].id != SYMBOL_NONE) {
+                s = (s + 1) & (num_of_slots - 1);
+            }
+            slots[s] = old[i];
+            for (Node* node = slots[s].node; node != NULL; node = node->shadowed) {
+                node->slot = s;
+            }
         }
     }
-    free(table);
+    free(old);
 }
 
-Node* search_id(List* table, char* id)
+void symtab_init(void)
 {
-    /* get the appropriate list */
-    List l = table[h(id)];
-    /* search the list */
-    Node* head = l.head;
-    int result;
-    while (head != NULL) {
-        result = strcmp(id, (*head).name);
-        if (result == 0) {
-            return head;
-        }
-        else {
-            head = (*head).next;
+    if (num_of_slots == 0) {
+        grow_slots();
+    }
+    else {
+        /* empty the table of the previous compilation (keeping its memory) */
+        arena_reset(&symtab_arena);
+        for (unsigned int i = 0; i < num_of_slots; i++) {
+            slots[i].id = SYMBOL_NONE;
         }
     }
-    return NULL;
+    num_of_names_declared = 0;
+    undo_log_size = 0;
+    scope_depth = 0;
 }
 
-Node* install_id(List* table, char* id)
+/* the slot of an id: the one it's in, or else the empty one where it would go */
+unsigned int find_slot(unsigned int id, unsigned int hash)
 {
-    /* check if the id exists */
-    Node* node = search_id(table, id);
-    /* if it doesn't exist, insert it */
-    if (node == NULL) {
-        /* create a new node and put it in the front of the list */
-        node = malloc(sizeof (Node));
-        if (node == NULL) {
-            printf("malloc() failed\n");
-            exit(EXIT_FAILURE);
-        }
-        char* id_copy = malloc(strlen(id) + 1);
-        (*node).name = strcpy(id_copy, id);
-        (*node).next = table[h(id)].head;
-        table[h(id)].head = node;
-    }
-    else {
-        printf("Error: '%s' already declared\n", id);
-        exit(EXIT_FAILURE);
+    unsigned int s = hash >> slot_shift;
+    while (slots[s].id != id && slots[s].id != SYMBOL_NONE) {
+        s = (s + 1) & (num_of_slots - 1);
     }
-    return node;
+    return s;
 }
 
-void print_table(List* table)
+Node* search_id(unsigned int id)
 {
-    for (int i = 0; i < TABLE_SIZE; i++) {
-        Node* head = table[i].head;
-        char c = i + 'a';
-        if (i == 26) {
-            c = '_';
-        }
-        printf("%c -> ", c);
-        while (head != NULL) {
-            printf("%s -> ", (*head).name);
-            head = (*head).next;
-        }
-        printf("\n");
-    }
-    printf("\n");
+    Slot* slot = &slots[find_slot(id, hash_id(id))];
+    return slot->id == id ? slot->node : NULL;
 }
 
-void push_symtab(List* table, SymbolTableStack* stack)
+Node* install_id(unsigned int id)
 {
-    if ((*stack).top >= STACK_SIZE) {
-        printf("Too many symbol tables on the symbol table stack (max: 100)\n");
+    unsigned int hash = hash_id(id);
+    unsigned int s = find_slot(id, hash);
+    if (slots[s].id == id && slots[s].node != NULL && slots[s].node->scope == scope_depth) {
+        printf("Error: '%s' already declared\n", name_of(id));
         exit(EXIT_FAILURE);
     }
-    else {
-        (*stack).table[++((*stack).top)] = table;
+    if (slots[s].id == SYMBOL_NONE) {
+        /* a name never declared before */
+        if (2 * (num_of_names_declared + 1) > num_of_slots) {
+            grow_slots();
+            s = find_slot(id, hash);
+        }
+        slots[s] = (Slot) {id, hash, NULL};
+        num_of_names_declared++;
+    }
+    /* create a new node (in the region of the scope), which shadows the one in the slot */
+    Node* node = arena_alloc(&symtab_arena, sizeof (Node));
+    node->id = id;
+    node->name = name_of(id); /* (interned names are never freed) */
+    node->scope = scope_depth;
+    node->shadowed = slots[s].node;
+    node->slot = s;
+    slots[s].node = node;
+    /* log it, to undo it when the scope is closed */
+    if (undo_log_size == undo_log_capacity) {
+        undo_log_capacity = undo_log_capacity == 0 ? 256 : 2 * undo_log_capacity;
+        Node** temp = realloc(undo_log, undo_log_capacity * sizeof (Node*));
+        if (temp == NULL) {
+            printf("realloc() failed\n");
+            exit(EXIT_FAILURE);
+        }
+        undo_log = temp;
     }
+    undo_log[undo_log_size++] = node;
+    return node;
 }
 
-void remove_symtab(SymbolTableStack* stack)
+void push_scope(void)
 {
-    free_table((*stack).table[(*stack).top--]);
+    if (scope_depth == scope_marks_capacity) {
+        scope_marks_capacity = scope_marks_capacity == 0 ? 64 : 2 * scope_marks_capacity;
+        ScopeMark* temp = realloc(scope_marks, scope_marks_capacity * sizeof (ScopeMark));
+        if (temp == NULL) {
+            printf("realloc() failed\n");
+            exit(EXIT_FAILURE);
+        }
+        scope_marks = temp;
+    }
+    scope_marks[scope_depth++] = (ScopeMark) {undo_log_size, arena_mark(&symtab_arena)};
 }
 
-Node* search_symtabs(SymbolTableStack* stack, char* id)
+void pop_scope(void)
 {
-    int i = (*stack).top;
-    Node* node = NULL;
-    while (i >= 0 && node == NULL) {
-        node = search_id((*stack).table[i], id);
-        i--;
+    ScopeMark mark = scope_marks[--scope_depth];
+    while (undo_log_size > mark.undo_log_size) {
+        Node* node = undo_log[--undo_log_size];
+        slots[node->slot].node = node->shadowed;
     }
-    return node;
+    /* the nodes of the scope are freed all at once (the memory is used again by the next scope) */
+    arena_release(&symtab_arena, mark.nodes);
 }
 
-void print_stack(SymbolTableStack stack)
+void print_symtab(void)
 {
-    for (int i = stack.top; i >= 0; i--) {
-        print_table(stack.table[i]);
+    for (unsigned int s = 0; s < num_of_slots; s++) {
+        if (slots[s].id != SYMBOL_NONE && slots[s].node != NULL) {
+            printf("%u -> ", s);
+            for (Node* node = slots[s].node; node != NULL; node = node->shadowed) {
+                printf("%s (scope %i) -> ", node->name, node->scope);
+            }
+            printf("\n");
+        }
     }
+    printf("\n");
 }
-
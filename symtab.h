@@ -7,17 +7,24 @@
 #include <ctype.h>
 
 /*
-Implementation of a symbol table, i.e., an array (hash table) of linked lists.
-Each record stores information about a unique symbol (identifier) that occurs in the program
-(each scope in the program?).
-Symbols with the same starting character are stored together, i.e., hash to the same value.
-
-(key -> value)
-a -> symbols that start with 'a'
-b -> symbols that start with 'b'
-...
-z -> symbols that start with 'z'
-_ -> symbols that start with '_'
+Implementation of a symbol table, i.e., a hash table of the symbols (identifiers) that occur in the program,
+with every scope in a single table.
+Symbols are known by the id of their interned name (see intern.h), so they are compared as ints rather than strings.
+The table is open addressing (linear probing) over the ids, hashed by multiplication (the hash of each id is kept
+in its slot, so the table can be grown without computing it again), and it's doubled when it gets half full.
+
+Each slot holds the innermost declaration of its name that is in scope. Declaring a name again in an inner scope
+"shadows" the outer declaration, which the new one points to, and the declaration is written to the undo log:
+    * when a new scope is created, the length of the log is pushed (a mark),
+    * when a scope is closed, the declarations made since its mark are undone, last first: the slot of each
+      of them gets back the declaration it shadowed.
+So opening and closing a scope costs nothing but its own declarations (no table is allocated or freed), and a
+lookup is a single probe sequence, whatever the number of scopes.
+The nodes are allocated from an arena (see arena.h), in a region for each scope: closing the scope releases
+its nodes at once (so a node of a closed scope must not be used anymore; the procedures are global, and stay).
+
+(slot -> value)
+hash(id) -> (id, hash, the innermost declaration of id -> the declaration it shadows -> ...)
 
 Identifiers in general might be
 - programs (maybe not if we don't allow '#' through the tokenizer)
@@ -28,10 +35,6 @@ Identifiers in general might be
 - instruction labels
 - constants too?
 
-* when a new scope is created, we can push a new symbol table onto a stack of symbol tables, and store local data on the topmost table
-* when a scope is closed, we pop the top symbol table off
-* 
-
 Information stored includes
 - the type of identifier
 - the type of variable/object (char, string, int, float, etc.)
@@ -39,23 +42,14 @@ Information stored includes
 including intermediate ones generated by the compiler itself)
 - size of the id (how many bytes? e.g., int: 4, float: 4)
 - dimensions/length of the object (e.g., a 2D array of n*m elements?)
-- 
+-
 */
 
-#define STACK_SIZE 100
-
 typedef struct Node Node;
-typedef struct List List;
-typedef struct SymbolTableStack SymbolTableStack;
-
-/* Stack of symbol tables */
-struct SymbolTableStack {
-    List* table[STACK_SIZE];
-    int top;
-};
 
 struct Node {
-    char* name; /* name of the symbol */
+    unsigned int id; /* the interned name of the symbol */
+    const char* name; /* its text */
     char type; /* type of the symbol: int, real, char, array, or func */
     char elt_type; /* element type (for arrays) or return type (for functions) */
     int size; /* number of bytes that should be allocated */
@@ -64,42 +58,27 @@ struct Node {
     char params[12]; /* list of parameter types (for functions) */
     int num_of_params;
     int arrlength; /* length (1 for non-arrays, n for arrays) */
-/*    union {*/
-/*        int i;*/
-/*        float f;*/
-/*        char *s;*/
-/*    };*/
-    Node *next;
+    int scope; /* depth of the scope it was declared in (0: the globals) */
+    Node* shadowed; /* the declaration of the same name in an outer scope that this one hides (or NULL) */
+    unsigned int slot; /* its slot in the table */
 };
 
-struct List {
-    Node* head;
-};
-
-int h(char*);
-
-/* Create a symbol table */
-List* create_table(void);
-
-void free_table(List*);
-
-/* Return a pointer to a symbol's node if it exists in the symbol table (or NULL if it doesn't) */
-Node* search_id(List*, char*);
-
-/* Place the id in the symbol table if it doesn't exist, and return a pointer to the node */
-Node* install_id(List*, char*);
+/* Start the table with no symbol, in the global scope (for each compilation: the memory of the last one is used again) */
+void symtab_init(void);
 
-void print_table(List*);
+/* Open a new scope (for the parameters and the block of a procedure, or the block of a statement) */
+void push_scope(void);
 
-/* Add a symbol table to the top of the stack */
-void push_symtab(List*, SymbolTableStack*);
+/* Close the innermost scope: its symbols can't be found anymore (the outer ones they shadowed can, again) */
+void pop_scope(void);
 
-/* Remove the topmost symbol table from stack */
-void remove_symtab(SymbolTableStack*);
+/* Return a pointer to (the innermost declaration of) a symbol if it's in scope (or NULL if it isn't) */
+Node* search_id(unsigned int);
 
-/* Return a pointer to (the first occurrence of) a symbol if it exists in the symtab stack (or return NULL if it doesn't) */
-Node* search_symtabs(SymbolTableStack*, char*);
+/* Place the id in the innermost scope if it isn't declared there already, and return a pointer to the node */
+Node* install_id(unsigned int);
 
-void print_stack(SymbolTableStack);
+/* Print the symbols in scope (and, after each one, the ones it shadows) */
+void print_symtab(void);
 
-#endif
\ No newline at end of file
+#endif
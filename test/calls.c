@@ -0,0 +1,96 @@
+/* A call moves its args into the first slots of the frame of the procedure, in order, converted to the types
+   of the params; procedures call each other with several args of each type, and return to the right place.
+   Expected output:
+123
+3.500000
+2
+x
+4
+b
+1.000000
+1
+10
+457
+457
+15
+2.500000
+4
+y
+350
+*/
+int total;
+
+/* (prints the three digits abc) */
+void show3(int a, int b, int c)
+{
+    print a * 100 + b * 10 + c;
+}
+
+/* the int arg is converted to the float param */
+void mixed(float f, int i, char c)
+{
+    print f;
+    print i;
+    print c;
+}
+
+/* args in another order, and expressions of the params */
+void rotate(int a, char c, float f, int b)
+{
+    print a + b;
+    print c;
+    print f;
+    print b;
+    total = a + b * 2 + 4;
+}
+
+void sum4(int a, int b, int c, int d)
+{
+    total = a + b + c + d;
+}
+
+/* calls nested three deep, each one with the params of the caller in another order */
+void sort3(int a, int b, int c)
+{
+    if (a > b) {
+        sort3(b, a, c);
+        return;
+    }
+    if (b > c) {
+        sort3(a, c, b);
+        return;
+    }
+    show3(a, b, c);
+}
+
+void outer(int a, int b, int c)
+{
+    sort3(c, b, a);
+    sort3(a, b, c);
+    sum4(a, b, c, a - b - c + 1);
+    print total;
+}
+
+void chain(int depth, float f, int step)
+{
+    if (depth > 0) {
+        chain(depth - 1, f, step);
+        total = total + step;
+        return;
+    }
+    mixed(f, step + 3, 'y');
+    total = 0;
+}
+
+void main()
+{
+    int i = 1;
+    show3(i, i + 1, i + 2);
+    mixed(3.5, 2, 'x');
+    rotate(3, 'b', 1, 1);
+    sum4(1, 2, 3, 4);
+    print total;
+    outer(7, 5, 4);
+    chain(350, 2.5, 1);
+    print total;
+}
@@ -0,0 +1,15 @@
+/* A division by a constant zero is not folded: the program compiles, and runs until it gets to it.
+   Expected output:
+1
+2
+Error: division by zero
+*/
+void main()
+{
+    int i = 1;
+
+    print i;
+    print i + 1;
+    print (i + 2) / (3 - 3);
+    print i + 3;
+}
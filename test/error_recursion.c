@@ -0,0 +1,19 @@
+/* A recursion that never ends runs out of call depth, and stops with an error (on every engine).
+   Expected output:
+1
+Error: too many nested calls (call depth limit 262144)
+*/
+int calls;
+
+void forever()
+{
+    calls = calls + 1;
+    forever();
+}
+
+void main()
+{
+    print 1;
+    forever();
+    print calls;
+}
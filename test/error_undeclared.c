@@ -0,0 +1,12 @@
+/* A statement that starts with an undeclared identifier is a compile error (nothing runs).
+   Expected output:
+'y' undeclared (line 11, col 5)
+*/
+void main()
+{
+    int x = 1;
+
+    print x;
+    x = x + 1;
+    y = x;
+}
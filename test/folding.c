@@ -0,0 +1,71 @@
+/* Constant subexpressions are computed by the compiler, with the same results as the ops would give
+   (ints wrap around, an int and a float make a float), and identities such as x * 1, x + 0 and x * 4
+   are simplified. INT_MIN / -1 and a division by zero are left to run time (see error_divzero.c).
+   Expected output:
+-15
+24
+3.000000
+-1.500000
+-2147483648
+-2147483648
+-2147483647
+0
+1
+-2147483641
+-12
+-12
+12
+-3
+-3
+357913941
+5.000000
+0
+6
+18
+*/
+int min;
+
+void main()
+{
+    int i = -3, j, a[10];
+    float f;
+
+    print (1 + 2) * -5;
+    print 7 % 3 + 100 / 7 - (2 < 3) + (4 == 4) * 10;
+    f = 1.5 * 2 + 1 / 2;
+    print f;
+    print -(2.5 - 1);
+
+    /* ints wrap around like the ops */
+    min = -2147483647 - 1;
+    print min;
+    print (-2147483647 - 1) * -1;
+    print 2147483647 * -1;
+    print (2147483647 + 1) / 2 - min / 2;
+    if (min == -2147483647 - 1) print 1; else print 0;
+    j = 7;
+    j = j - (-2147483647 - 1);
+    print j;
+    /* INT_MIN / -1 would overflow: it is compiled, but never run */
+    if (min > 0) print (-2147483647 - 1) / -1;
+    if (min > 0) print 1 / 0;
+
+    /* identities */
+    print i * 4;
+    print 4 * i + 0;
+    print i * 1 * -4;
+    print i / 1 - 0;
+    print 0 + i;
+    print 1073741824 * 2 * i / -6;
+    f = 2.5;
+    print f * 2 + 0;
+
+    /* constant indexes */
+    a[2] = i * 4 + 0;
+    a[3] = 4 * i;
+    print a[1 + 1] - a[12 / 4];
+    j = 2;
+    a[j * 1 + 0] = 6;
+    print a[2];
+    print a[4 / 2] * 3;
+}
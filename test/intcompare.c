@@ -0,0 +1,66 @@
+/* Comparisons of ints are done as ints, so ints that a float can't hold exactly (above 2^24) compare right.
+   Expected output:
+0
+1
+1
+0
+1
+0
+1
+1
+0
+1
+8
+3
+1
+0
+1
+1
+*/
+int big = 16777217;
+int max = 2147483647;
+
+void main()
+{
+    int a = 16777216;
+    int i;
+    char c = 'b';
+
+    /* 16777217 and 16777216 are the same float */
+    print big == a;
+    print big != a;
+    print big > a;
+    print big < a;
+    print a < big;
+    print max <= max - 1;
+    print max >= max - 1;
+    print max - 1 < max && big > a;
+    print big == a || max == max - 1;
+    print c > 'a';
+
+    /* loop conditions */
+    i = 0;
+    while (big - i > a - 7) {
+        i = i + 1;
+    }
+    print i;
+    do {
+        i = i - 1;
+    } while (a + i != a + 3);
+    print i;
+
+    /* if and switch */
+    if (big != a) {
+        print 1;
+    }
+    else {
+        print 0;
+    }
+    switch (big) {
+        case 16777216: print 2;
+        case 16777217: print 0;
+        default: print 3;
+    }
+    if (-big < -a) print 1; else print 0;
+    if (max + 1 < max) print 1; else print 0;
+}
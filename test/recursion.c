@@ -0,0 +1,124 @@
+/* Each call of a procedure has a frame of its own: its params and locals (arrays too) survive the calls
+   it makes to itself, and its locals start out as 0 on every call. Calls can nest as deep as their frames fit.
+   Expected output:
+1
+1
+2
+6
+24
+120
+720
+5040
+40320
+362880
+610
+0
+15
+18
+9.500000
+100
+200010000
+*/
+int result;
+int fresh;
+int total;
+
+/* a local that is read after the recursive call has overwritten the callee's frame */
+void fact(int k)
+{
+    int saved = k;
+    if (k <= 1) {
+        result = 1;
+    }
+    else {
+        fact(k - 1);
+        result = result * saved;
+    }
+}
+
+/* two recursive calls, with locals set between them */
+void fib(int k)
+{
+    int a, b;
+    if (k < 2) {
+        result = k;
+        return;
+    }
+    fib(k - 1);
+    a = result;
+    fib(k - 2);
+    b = result;
+    result = a + b;
+}
+
+/* a local array and a float param, at every depth */
+void deep(int k, float f)
+{
+    int local[3];
+    int x;
+    fresh = fresh + x;   /* (0 if the locals start out as 0) */
+    x = k;
+    local[0] = k;
+    local[2] = 2 * k;
+    if (k == 0) {
+        result = 0;
+        return;
+    }
+    deep(k - 1, f + 0.5);
+    if (local[0] + local[1] + local[2] == 3 * x) {
+        result = result + 1;
+    }
+}
+
+/* the sum of the digits of n, with the running sum as a param */
+void digits(int n, int sum)
+{
+    if (n == 0) {
+        result = sum;
+        return;
+    }
+    digits(n / 10, sum + n % 10);
+}
+
+void floats(int k, float f)
+{
+    if (k == 0) {
+        print f;
+        return;
+    }
+    floats(k - 1, f + 0.5);
+}
+
+/* 20000 calls deep: the depth is only limited by the space for the frames */
+void sumto(int k)
+{
+    int here[2];
+    here[1] = k;
+    if (k > 0) {
+        sumto(k - 1);
+    }
+    total = total + here[1];
+}
+
+void main()
+{
+    int i = 0;
+    while (i < 10) {
+        fact(i);
+        print result;
+        i = i + 1;
+    }
+    fib(15);
+    print result;
+    deep(100, 1.5);
+    print fresh;
+    digits(12345, 0);
+    print result;
+    digits(99, 0);
+    print result;
+    floats(16, 1.5);
+    deep(100, 0.0);
+    print result;
+    sumto(20000);
+    print total;
+}
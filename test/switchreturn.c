@@ -0,0 +1,47 @@
+/* A return inside a switch leaves the procedure (a case ends with a jump, not with the switch's own return),
+   and globals without an initializer start out as 0.
+   Expected output:
+0
+0.000000
+0
+a
+c
+b
+c
+3
+9
+*/
+int n;
+float x;
+int counts[4];
+
+void classify(int k)
+{
+    switch (k) {
+        case 0: print 'a';
+        case 1: {
+            print 'b';
+            return;
+        }
+        default: {
+            if (k > 2) {
+                print k;
+                return;
+            }
+        }
+    }
+    print 'c';
+}
+
+void main()
+{
+    int i = 0;
+    print n;
+    print x;
+    print counts[3];
+    while (i < 4) {
+        classify(i);
+        i = i + 1;
+    }
+    classify(9);
+}
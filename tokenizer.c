@@ -3,9 +3,25 @@
 #include <stdlib.h>
 #include <ctype.h>
 #include <string.h>
+#include "lexscan.h"
+#include "intern.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#define SOURCE_MMAP
+#endif
+
+#define SOURCE_CHUNK 65536 /* bytes read at a time from a pipe */
 
 char *source_fp = "test_input.c";
 char *buf;
+size_t buf_size;
+const char *buf_end;        /* the end of the source read so far (buf + buf_size) */
+char *stream_block = NULL;  /* the block a streamed source is read into (kept for the next source) */
+size_t buf_capacity = 0;    /* its size */
+FILE *source_stream = NULL; /* the pipe the rest of the source is read from, in streaming mode (NULL once it's all read) */
+int source_mapped = 0;      /* is buf the source file mapped in memory (rather than a block read from a pipe)? */
 
 const char *scanp; /* current scanning position */
 int line = 1;      /* current line number */
@@ -16,6 +32,12 @@ int curtype;              /* the main info: the current token's type */
 unsigned int curval;      /* the current token's value (for numerical constants) */
 size_t chars_scanned = 0; /* # of characters scanned so far */
 
+size_t token_start = 0;   /* the offset of the first char of the current token (what a streamed source must keep) */
+
+token token_ring[TOKEN_RING_SIZE]; /* the tokens lexed ahead of the parser */
+unsigned int ring_first = 0;       /* the index of the current token in the ring */
+unsigned int ring_count = 0;       /* the number of tokens in the ring */
+
 const char* keywords[33] = {
     "auto",     "break",  "case",    "char",   "const",    "continue",
     "default",  "do",     "double",  "else",   "enum",     "extern",
@@ -26,30 +48,50 @@ const char* keywords[33] = {
     "volatile", "while"
 };
 
-int find_keyword(char *word)
+/*
+Keywords are recognized with a perfect hash of the first char, the last char and the length of a word:
+the 33 keywords have 33 different hashes (from 0 to 63), so a word can only be the keyword in the slot of its hash,
+and a single compare tells whether it is. The table is filled by the compiler from the keywords themselves
+(the multipliers were found by trying small numbers until none of the keywords collided).
+*/
+#define KEYWORD_HASH(first, last, len) ((2 * (first) + 19 * ((last) + (len))) & 63)
+#define KEYWORD_SLOT(first, last, len, k) [KEYWORD_HASH(first, last, len)] = (k) + 1
+
+/* keyword_slots[hash]: the index of the keyword with this hash, plus one (0 if there is none) */
+const unsigned char keyword_slots[64] = {
+    KEYWORD_SLOT('a', 'o', 4, TK_auto),     KEYWORD_SLOT('b', 'k', 5, TK_break),    KEYWORD_SLOT('c', 'e', 4, TK_case),
+    KEYWORD_SLOT('c', 'r', 4, TK_char),     KEYWORD_SLOT('c', 't', 5, TK_const),    KEYWORD_SLOT('c', 'e', 8, TK_continue),
+    KEYWORD_SLOT('d', 't', 7, TK_default),  KEYWORD_SLOT('d', 'o', 2, TK_do),       KEYWORD_SLOT('d', 'e', 6, TK_double),
+    KEYWORD_SLOT('e', 'e', 4, TK_else),     KEYWORD_SLOT('e', 'm', 4, TK_enum),     KEYWORD_SLOT('e', 'n', 6, TK_extern),
+    KEYWORD_SLOT('f', 't', 5, TK_float),    KEYWORD_SLOT('f', 'r', 3, TK_for),      KEYWORD_SLOT('g', 'o', 4, TK_goto),
+    KEYWORD_SLOT('i', 'f', 2, TK_if),       KEYWORD_SLOT('i', 't', 3, TK_int),      KEYWORD_SLOT('l', 'g', 4, TK_long),
+    KEYWORD_SLOT('p', 't', 5, TK_print),    KEYWORD_SLOT('r', 'r', 8, TK_register), KEYWORD_SLOT('r', 'n', 6, TK_return),
+    KEYWORD_SLOT('s', 't', 5, TK_short),    KEYWORD_SLOT('s', 'd', 6, TK_signed),   KEYWORD_SLOT('s', 'f', 6, TK_sizeof),
+    KEYWORD_SLOT('s', 'c', 6, TK_static),   KEYWORD_SLOT('s', 't', 6, TK_struct),   KEYWORD_SLOT('s', 'h', 6, TK_switch),
+    KEYWORD_SLOT('t', 'f', 7, TK_typedef),  KEYWORD_SLOT('u', 'n', 5, TK_union),    KEYWORD_SLOT('u', 'd', 8, TK_unsigned),
+    KEYWORD_SLOT('v', 'd', 4, TK_void),     KEYWORD_SLOT('v', 'e', 8, TK_volatile), KEYWORD_SLOT('w', 'e', 5, TK_while)
+};
+
+int find_keyword(const char *word, int len)
 {
-    int mid, result;
-    int first = 0;
-    int last = 32;
-    while (first <= last) {
-        mid = (first + last) / 2;
-        result = strcmp(word, keywords[mid]);
-        if (result == 0) {
-            return mid;
-        }
-        else if (result < 0) {
-            last = mid - 1;
-        }
-        else {
-            first = mid + 1;
-        }
+    if (len > 8) {
+        return -1; /* (longer than any keyword) */
+    }
+    int k = keyword_slots[KEYWORD_HASH((unsigned char) word[0], (unsigned char) word[len - 1], len)] - 1;
+    if (k >= 0 && strncmp(word, keywords[k], len) == 0 && keywords[k][len] == '\0') {
+        return k;
     }
     return -1;
 }
 
 char next_char(void)
 {
-    ch = *scanp++;
+    if (scanp < buf_end || read_more()) {
+        ch = *scanp++;
+    }
+    else {
+        ch = '\0'; /* the end of the source */
+    }
     if (ch == '\n') {
         column = 0;
         line++;
@@ -67,7 +109,7 @@ void print_token(token t)
         printf("Token: (Keyword) %s\n", keywords[t.type]);
     }
     else if (t.type == TK_ID) {
-        printf("Token: (Identifier) %s\n", t.text);
+        printf("Token: (Identifier) %s\n", name_of(t.id));
     }
     else if (t.type == TK_INT) {
         printf("Token: (Integer) %d\n", t.i);
@@ -76,7 +118,7 @@ void print_token(token t)
         printf("Token: (Real) %f\n", t.f);
     }
     else if (t.type == TK_STR) {
-        printf("Token: (String) \"%s\"\n", t.s);
+        printf("Token: (String) \"%s\"\n", name_of(t.id));
     }
     else if (t.type == TK_CHAR) {
         printf("Token: (Character) '%c'\n", t.c);
@@ -181,14 +223,40 @@ void print_token(token t)
     }
 }
 
-void print_tokens(token* toks)
+void print_tokens(void)
+{
+    read_all(); /* (so that the source can be tokenized again, from its beginning) */
+    open_token_stream();
+    token t;
+    do {
+        t = *peek_token(0);
+        print_token(t);
+        pop_token();
+    } while (t.type != TK_EOF);
+}
+
+/* consume the chars from scanp up to q, none of which is a '\n', as next_char() would (but all at once) */
+void skip_to(const char *q)
 {
-    int i = 0;
-    while (toks[i].type != TK_EOF) {
-        print_token(toks[i]);
-        i++;
+    column += q - scanp;
+    chars_scanned += q - scanp;
+    scanp = q;
+}
+
+/* the same, for chars that may include '\n's */
+void skip_lines_to(const char *q)
+{
+    const char *last;
+    size_t lines = lex_count_lines(scanp, q, &last);
+    if (lines > 0) {
+        line += lines;
+        column = q - last;
     }
-    print_token(toks[i]);
+    else {
+        column += q - scanp;
+    }
+    chars_scanned += q - scanp;
+    scanp = q;
 }
 
 token next_token(void)
@@ -202,10 +270,12 @@ token next_token(void)
             next_char();
             return t;
         }
+        skip_to(lex_skip_blanks(scanp, buf_end)); /* (the rest of the blanks, a block at a time) */
         next_char();
     }
     int start_line = line;
     int start_column = column;
+    token_start = scanp > buf ? scanp - 1 - buf : 0;
     /* look for a number or period at the beginning of the token */
     if ('.' == ch || '0' <= ch && ch <= '9') {
         curval = 0;
@@ -215,7 +285,11 @@ token next_token(void)
         /* process zero or more digits */
         while ('0' <= ch && ch <= '9') {
             digits_in_front = 1;
-            curval = (ch - '0') + curval * 10;
+            const char *digits = scanp - 1; /* (the current char) */
+            skip_to(lex_skip_digits(scanp, buf_end));
+            for (const char *p = digits; p < scanp; p++) {
+                curval = (*p - '0') + curval * 10;
+            }
             next_char();
         }
         if ('.' == ch) {
@@ -235,8 +309,12 @@ token next_token(void)
             /* process zero or more digits */
             floatval = curval;
             while ('0' <= ch && ch <= '9') {
-                factor /= 10.0;
-                floatval = floatval + (float) (ch - '0') * factor;
+                const char *digits = scanp - 1;
+                skip_to(lex_skip_digits(scanp, buf_end));
+                for (const char *p = digits; p < scanp; p++) {
+                    factor /= 10.0;
+                    floatval = floatval + (float) (*p - '0') * factor;
+                }
                 next_char();
             }
             curtype = TK_REAL;
@@ -269,19 +347,8 @@ token next_token(void)
         int d = 0;
         while ('\0' != ch) {
             if (ch == '"') {
-                char *string_text = malloc(d+1);
-                if (!string_text) {
-                    printf("malloc() failed\n");
-                    exit(EXIT_FAILURE);
-                }
-                const char *temp = scanp;
-                temp--;
-                for (int i = 0; i < d; i++) {
-                    string_text[d-1-i] = *(--temp);
-                }
-                string_text[d] = '\0';
                 t = (token) {TK_STR, start_line, start_column};
-                t.s = string_text;
+                t.id = intern(scanp - 1 - d, d); /* (the d chars before the closing quote) */
                 next_char();
                 return t;
             }
@@ -328,16 +395,13 @@ token next_token(void)
         int count = 0;
         while (('a' <= ch && ch <= 'z') || ('A' <= ch && ch <= 'Z') ||
                ('0' <= ch && ch <= '9') || '_' == ch) {
-            t.text[count] = ch;
-            count++;
-            if (count > 31) {
-                printf("Error: identifier over 31 chars long at line %d, column %d\n", start_line, start_column);
-                exit(EXIT_FAILURE);
-            }
+            const char *word = scanp - 1;
+            skip_to(lex_skip_word(scanp, buf_end));
+            count += scanp - word;
             next_char();
         }
-        t.text[count] = '\0'; /* terminate the text with a null char */
-        int k = find_keyword(t.text);
+        const char *text = buf + token_start; /* (the word is never copied: only new names are, when they're interned) */
+        int k = find_keyword(text, count);
         if (k != -1) {
             /* keyword */
             curtype = k;
@@ -347,6 +411,7 @@ token next_token(void)
             /* not keyword */
             curtype = TK_ID;
             t.type = curtype;
+            t.id = intern(text, count);
         }
         return t; /* return the identifier/keyword */
     }
@@ -362,6 +427,8 @@ token next_token(void)
             else if ('/' == ch) {
                 /* ignore the comment: skip until EOF and EOL */
                 while ('\0' != ch && '\n' != ch) {
+                    skip_to(lex_find_eol(scanp, buf_end));
+                    token_start = scanp - buf; /* (what was skipped doesn't have to be kept) */
                     next_char();
                 }
                 return next_token();
@@ -377,6 +444,8 @@ token next_token(void)
                         }
                     }
                     else {
+                        skip_lines_to(lex_find_star(scanp, buf_end));
+                        token_start = scanp - buf;
                         next_char();
                     }
                 }
@@ -601,54 +670,149 @@ token next_token(void)
     return t;
 }
 
+int read_more(void)
+{
+    if (source_stream == NULL) {
+        return 0;
+    }
+    if (buf_size == buf_capacity && token_start >= buf_capacity / 2) {
+        /* the block is full, but mostly of chars that were tokenized already: only keep the current token */
+        memmove(buf, buf + token_start, buf_size - token_start);
+        buf_size -= token_start;
+        scanp -= token_start;
+        token_start = 0;
+    }
+    else if (buf_size == buf_capacity) {
+        /* the block is full: make it twice as large */
+        size_t offset = scanp - buf;
+        buf_capacity *= 2;
+        char *temp = realloc(buf, buf_capacity);
+        if (temp == NULL) {
+            printf("realloc() failed\n");
+            exit(EXIT_FAILURE);
+        }
+        buf = stream_block = temp;
+        scanp = buf + offset;
+    }
+    size_t wanted = buf_capacity - buf_size < SOURCE_CHUNK ? buf_capacity - buf_size : SOURCE_CHUNK;
+    size_t n = fread(buf + buf_size, 1, wanted, source_stream);
+    if (n == 0) {
+        if (ferror(source_stream)) {
+            printf("Error: can't read %s\n", source_fp);
+            exit(EXIT_FAILURE);
+        }
+        if (source_stream != stdin) {
+            fclose(source_stream);
+        }
+        source_stream = NULL;
+        return 0;
+    }
+    buf_size += n;
+    buf_end = buf + buf_size;
+    return 1;
+}
+
+void read_all(void)
+{
+    while (read_more()) {
+    }
+}
+
 FILE* read_file(char *source)
 {
     source_fp = source;
-    /* open the source file and read its contents into a buffer */
-    FILE *f = fopen(source_fp, "rb");
+    /* open the source file ("-" is the standard input) */
+    FILE *f = strcmp(source_fp, "-") == 0 ? stdin : fopen(source_fp, "rb");
     if (f == NULL) {
         printf("fopen() failed (does the file exist?)\n");
         exit(EXIT_FAILURE);
     }
-    /* computing the file size */
-    fseek(f, 0, SEEK_END);
-    long file_size = ftell(f);
-    fseek(f, 0, SEEK_SET); // or rewind(f);
-    /* creating and writing to a buffer */
-    buf = malloc(file_size + 1);
-    fread(buf, file_size, 1, f);
-    fclose(f);
-    buf[file_size] = '\0';
+    source_mapped = 0;
+#ifdef SOURCE_MMAP
+    /* a regular file is mapped in memory as it is: the kernel reads its pages as the tokenizer gets to them */
+    struct stat st;
+    if (fstat(fileno(f), &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 && ftell(f) == 0) {
+        void *p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(f), 0);
+        if (p != MAP_FAILED) {
+            madvise(p, st.st_size, MADV_SEQUENTIAL);
+            if (f != stdin) {
+                fclose(f); /* (the mapping stays) */
+            }
+            buf = p;
+            buf_size = st.st_size;
+            buf_end = buf + buf_size;
+            source_mapped = 1;
+            scanp = buf;
+            return NULL;
+        }
+    }
+#endif
+    /* anything else (a pipe, a terminal...) is streamed: read a chunk at a time, as the tokenizer needs it */
+    if (stream_block == NULL) {
+        buf_capacity = SOURCE_CHUNK;
+        stream_block = malloc(buf_capacity);
+        if (stream_block == NULL) {
+            printf("malloc() failed\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    buf = stream_block;
+    buf_size = 0;
+    buf_end = buf;
+    source_stream = f;
     /* set the pointer to the beginning of the buffer */
     scanp = buf;
     return f;
 }
 
-token* scan(void)
+void free_source(void)
 {
-    /* start scanning */
+#ifdef SOURCE_MMAP
+    if (source_mapped) {
+        munmap(buf, buf_size);
+        source_mapped = 0;
+    }
+#endif
+    /* (a streamed source leaves its block, which the next one is read into) */
+    buf = NULL;
+    buf_size = 0;
+}
+
+void open_token_stream(void)
+{
+    if (lex_isa < 0) {
+        lex_init();
+    }
+    scanp = buf;
+    line = 1;
+    column = 0;
+    chars_scanned = 0;
+    curtype = TK_EOL;
+    token_start = 0;
+    ring_first = 0;
+    ring_count = 0;
     next_char();
-    int count = 0;
-    size_t toks_size = 50000;
-    token* toks = malloc(toks_size * sizeof (token));
-    token tok;
-    while (curtype != TK_EOF) {
-        tok = next_token();
-        //print_token(tok); /* print the token */
-        toks[count] = tok; /* store the token in an array */
-        count++;
-        if (count > toks_size) {    /* reallocate if necessary */
-            toks_size += 500;
-            token* temp = realloc(toks, toks_size * sizeof (token));
-            if (temp == NULL) {
-                printf("realloc() failed\n");
-                exit(EXIT_FAILURE);
-            }
-            else {
-                toks = temp;
-            }
+}
+
+token* peek_token(unsigned int k)
+{
+    while (ring_count <= k) {
+        token* next = &token_ring[(ring_first + ring_count) & (TOKEN_RING_SIZE - 1)];
+        if (curtype == TK_EOF) {
+            *next = token_ring[(ring_first + ring_count - 1) & (TOKEN_RING_SIZE - 1)]; /* (EOF again) */
+        }
+        else {
+            *next = next_token();
         }
+        ring_count++;
+    }
+    return &token_ring[(ring_first + k) & (TOKEN_RING_SIZE - 1)];
+}
+
+void pop_token(void)
+{
+    if (peek_token(0)->type != TK_EOF) {
+        ring_first = (ring_first + 1) & (TOKEN_RING_SIZE - 1);
+        ring_count--;
     }
-    free(buf);
-    return toks;
 }
@@ -13,7 +13,7 @@ such as keywords, identifiers and operators.
 1. Keywords are just keywords: reserved words that are taken as-is in the source code text.
 2. An identifier is a letter or underscore followed by any combination of letters, digits and underscores
    and is terminated by whitespace or punctuation.
-   (Constraints in C: identifiers cannot be keywords, and are only up to 31 characters long)
+   (Constraints in C: identifiers cannot be keywords; here, they can be of any length)
 3. A number is a sequence of digits including an optional period in any position amongst those digits
    and is terminated by whitespace or punctuation.
    For example, .1, 1, 1. and 1.0 are all valid numbers.
@@ -34,7 +34,7 @@ EOF is a distinct character that marks the end of the source file.
 What's not supported as valid tokens:
 - hexadecimal and exponential numbers
 - numerical types other than (signed) int and float
-- restrictions on the size of numbers/strings (however, an error is thrown if identifiers are > 31 chars long)
+- restrictions on the size of numbers/strings/identifiers
 (i.e., it is assumed that the source program will not declare any numbers that won't compile)
 - escape characters in strings or chars, or line breaks: e.g., "hello\nworld" and '\n'
 (i.e., it is assumed that the source program will not escape or line-break strings)
@@ -65,21 +65,21 @@ typedef enum {
     TK_EOL, TK_EOF, TK_BADCHAR /* bad chars: ` @ $  */
 } TokenType;
 
+/* a token, unpacked from the token arrays (see below) */
 typedef struct {
     TokenType type;
     unsigned int line;
     unsigned int column;
     union {
-        int i;            /* value for integer constants */
-        float f;          /* value for floating-point constants */
-        char text[32];    /* text for identifiers */
-        char c;           /* characters */
-        char* s;          /* strings */
+        int i;              /* value for integer constants */
+        float f;            /* value for floating-point constants */
+        unsigned int id;    /* the interned name of identifiers, or text of strings (see intern.h) */
+        char c;             /* characters */
     };
 } token;
 
-/* return the index of the keyword in the keyword array or -1 if it doesn't exist */
-int find_keyword(char*);
+/* return the index of the keyword (of a given length) in the keyword array or -1 if it doesn't exist */
+int find_keyword(const char*, int);
 
 /* get the next character in the buffer */
 char next_char(void);
@@ -87,14 +87,51 @@ char next_char(void);
 /* print info about a given token (for testing purposes) */
 void print_token(token);
 
-/* Print complete output, i.e., an array of tokens (again, for testing purposes) */
-void print_tokens(token*);
+/* Print complete output, i.e., all the tokens (again, for testing purposes); the token stream then has to be opened again */
+void print_tokens(void);
 
 /* Return the next token which starts from the current scanning position */
 token next_token(void);
 
+/*
+The source is read by read_file() in one of two ways:
+    + a regular file is mapped in memory (mmap), with no copy: the kernel reads its pages lazily,
+    + anything else (a pipe, or the standard input, given as "-") is streamed: read_more() reads
+      a chunk at a time into a growing block of memory, when next_char() gets to the end of what was read so far
+      (the block is kept, and used again for the next source that is streamed).
+Either way, there is no '\0' after the source: next_char() returns '\0' when it gets to buf_end.
+*/
+extern char* buf;        /* the source read by read_file() so far */
+extern size_t buf_size;  /* its size in bytes */
+extern const char* buf_end;
+
+/* open a source file, map it or get ready to stream it; return the stream (NULL if the file is mapped) */
 FILE* read_file(char*);
 
-token* scan(void);
+/* read the next chunk of a streamed source and return 1, or return 0 at its end */
+int read_more(void);
+
+/* read the rest of a streamed source (e.g., to hash all of it) */
+void read_all(void);
+
+/* unmap the source, or let go of its block (once it's parsed) */
+void free_source(void);
+
+/*
+The token stream: the source is tokenized as the parser goes, rather than all at once into an array,
+so the tokens take the same (small) memory whatever the size of the source, and each token is parsed right after
+it's lexed, while its text is still in the cache. The tokens lexed ahead of the parser are kept in a ring buffer,
+which is the parser's lookahead: peek_token(k) is the token k places after the current one (k < TOKEN_RING_SIZE).
+The last token is TK_EOF, which is never popped.
+*/
+#define TOKEN_RING_SIZE 16 /* (a power of 2) */
+
+/* start tokenizing from the beginning of the source (which must be all read, to open the stream a second time) */
+void open_token_stream(void);
+
+token* peek_token(unsigned int);
+
+/* move to the next token */
+void pop_token(void);
 
 #endif
\ No newline at end of file
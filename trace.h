@@ -0,0 +1,28 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+/*
+Trace levels (--trace=<level>): how much the compiler prints about its work before the program's output.
+Each level prints everything the levels below it print:
+    off      nothing (only the output of the program itself)
+    tokens   the tokens the source was broken into
+    ir       the symbols declared and the IR of every procedure (see ir.h)
+    bytes    the code array, one word per line, and the sizes of the code and the data (the default)
+Every trace print is guarded by TRACE(level), a single comparison with a global that doesn't change once the
+program is compiled (so the branch is always predicted); built with -DNO_TRACE, the trace is compiled out.
+*/
+
+#define TRACE_OFF    0
+#define TRACE_TOKENS 1
+#define TRACE_IR     2
+#define TRACE_BYTES  3
+
+#ifdef NO_TRACE
+#define TRACE(level) 0
+#else
+#define TRACE(level) (trace_level >= (level))
+#endif
+
+extern int trace_level; /* TRACE_BYTES by default */
+
+#endif
@@ -1,25 +1,41 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#endif
 #include "stack.h"
 #include "parser.h"
+#include "codegen.h"
+#include "optimizer.h"
+#include "regvm.h"
+#include "jit.h"
+#include "aot.h"
+#include "image.h"
+#include "cache.h"
+#include "trace.h"
+#include "output.h"
+#include "lexscan.h"
 
 /*
-(1) Code array (byte array): written by the compiler and then executed during runtime
+(1) Code array (array of words): written by the compiler and then executed during runtime
 (2) Data array (byte array): compiler only allocates it (for reading/writing during runtime)
 (3) Stack: not used by compiler, but the compiler can estimate how much the stack needs (again, runtime only)
 
-e.g., int x, y; // x gets addr 0, y gets addr 4, and thus the data array should get 8 bytes.
+e.g., int x, y; // x gets addr 0, y gets addr 4, and thus the data array should get 8 bytes
+(followed by the frames of the procedures' params and locals, see codegen.h).
 
-Byte arrays are used to accommodate different types.
+The data array is addressed in bytes, but every variable (int, char or float) takes 4 bytes at a 4-byte aligned address,
+so that it can be read or written with a single load or store.
 
-An address is 4 bytes.
-An op is 1 byte.
+An op is 1 word.
+An argument (address, offset or value) is 1 word, stored in the machine's byte order.
 
 e.g., 
 int x, y, z; // x gets address 0, y gets address 4, z gets address 8
 x = y;
-| push (1 byte) | @y (4 bytes) | pop (1 byte) | @x (4 bytes)  <-- code array
+| push | @y | pop | @x |  <-- code array
 (push y; pop; assign the popped value to x)
 
 e.g.,
@@ -28,465 +44,660 @@ x = y + z;
 (push y; push z; add; pop the result of the add; assign that value to x)
 */
 
+#define ENGINE_SWITCH   0 /* decode every op with a switch */
+#define ENGINE_THREADED 1 /* jump directly from handler to handler through pre-decoded handler addresses */
+#define ENGINE_PROFILE  2 /* like ENGINE_SWITCH, but count how often each op follows each other op */
+#define ENGINE_REGISTER 3 /* run the register code (see regvm.h) instead, decoding every op with a switch */
+#define ENGINE_REGISTER_PROFILE 4 /* like ENGINE_REGISTER, but count how often each op is executed */
+#define ENGINE_JIT      5 /* like ENGINE_REGISTER, but compile the hot procedures into native code (see jit.h) */
+
 Stack stack;
 unsigned char* data;
+unsigned int code_size; /* number of words in the code array */
+unsigned long pair_count[NUM_OPS][NUM_OPS]; /* pair_count[a][b]: number of times op b was executed right after op a */
+unsigned long rop_count[NUM_ROPS]; /* rop_count[op]: number of times the register op was executed */
+unsigned int return_stack[RETURN_STACK_SIZE];
+
+/* a call in progress on the stack VM: where it returns to, and the frame of its caller (see codegen.h) */
+typedef struct {
+    unsigned int ret;
+    unsigned char* fp;
+} CallRecord;
+
+CallRecord call_stack[CALL_STACK_SIZE];
+
+/* the 4-byte item at a given address of the data array */
+#define DATA(addr) (*(slot_t*) (data + (addr)))
+/* the 4-byte item at a given offset of the frame of the running procedure (see codegen.h) */
+#define LOCAL(offset) (*(slot_t*) (fp + (offset)))
+/* the (first) argument of the op being executed (read as an int or as a float) */
+#define ARG        (((slot_t*) code)[ip])
+/* the n-th argument of the op being executed, starting from 0 */
+#define ARGN(n)    (((slot_t*) code)[ip+(n)])
+
+void stack_overflow(void)
+{
+    printf("Runtime stack is past its capacity (probably a bug)\n");
+    exit(EXIT_FAILURE);
+}
 
-/* Store an int in the first four bytes of a byte array */
-void store_int(unsigned char* bytes, int n)
+/* a call nested deeper than the call stack (or return stack) of the engine can hold */
+void too_many_calls(int limit)
 {
-    bytes[0] = (n >> 24) & 0xFF;
-    bytes[1] = (n >> 16) & 0xFF;
-    bytes[2] = (n >> 8)  & 0xFF;
-    bytes[3] = n         & 0xFF;
+    printf("Error: too many nested calls (call depth limit %i)\n", limit);
+    exit(EXIT_FAILURE);
 }
 
-/* Read an int from the first four bytes of a byte array */
-int get_int(unsigned char* bytes)
+/* a call whose frame doesn't fit in the space left for frames (or for the frames saved by recursive calls) */
+void frames_too_large(int size)
 {
-    return (bytes[0] << 24) + (bytes[1] << 16) + (bytes[2] << 8) + bytes[3];
+    printf("Error: too many nested calls (their frames take more than %i bytes)\n", size);
+    exit(EXIT_FAILURE);
 }
 
-/* Store a float in the first four bytes of a byte array */
-char* store_float(unsigned char* bytes, float f)
+/* the save stack of the register VM (see regvm.h) */
+unsigned char save_stack[SAVE_STACK_SIZE];
+unsigned int save_stack_used = 0;
+
+void save_frame(unsigned char* regs, unsigned int size)
 {
-    for (int i = 0; i < 4; i++) {
-        bytes[i] = *((unsigned char*) &f + i);
+    if (size > SAVE_STACK_SIZE - save_stack_used) {
+        frames_too_large(SAVE_STACK_SIZE);
     }
+    memcpy(save_stack + save_stack_used, regs, size);
+    save_stack_used += size;
+}
+
+void restore_frame(unsigned char* regs, unsigned int size)
+{
+    save_stack_used -= size;
+    memcpy(regs, save_stack + save_stack_used, size);
 }
 
-/* Read a float from the first four bytes of a byte array */
-float get_float(unsigned char* bytes)
+/* Operand stack access for the instruction handlers: the top item is kept in tos and sp points to the item below it */
+#define PUSH()        (*++sp = tos)   /* make room for a new top item (the caller then writes it to tos) */
+#define DROP()        (tos = *sp--)   /* remove the top item */
+/* make sure the code that starts at code[ip] can push as much as it needs (see stack_need in parser.h) */
+#define CHECK_STACK() if (sp + stack_need[ip] > limit) stack_overflow()
+
+/* The engines take their own copies of the arrays, of ip and of the stack limit (shadowing the globals),
+so that they can be kept in registers */
+void run_switch(int* code, unsigned char* data)
 {
-    float f;
-    for (int i = 0; i < 4; i++) {
-        *((unsigned char*) &f + i) = bytes[i];
+    unsigned int ip = entry_point;
+    slot_t* const limit = stack.limit;
+    slot_t* sp = stack.items;
+    slot_t tos;
+    tos.i = 0;
+    unsigned char* fp = data + dp; /* (the frames start after the globals) */
+    unsigned char* frame_end = fp;
+    unsigned char* const frame_limit = fp + FRAME_AREA_SIZE;
+    CallRecord* csp = call_stack;
+    CallRecord* const call_limit = call_stack + CALL_STACK_SIZE;
+    CHECK_STACK();
+    /* decode every op through a switch on the op byte */
+#define CASE(op) case op:
+#define NEXT     break
+    while (1) {
+/*        printf("--------------- ip: %i -----------\n" , ip);*/
+/*        stack_print(&stack, sp, tos);*/
+        switch(code[ip++]) {
+#include "vm_handlers.h"
+        }
     }
-    return f;
+#undef CASE
+#undef NEXT
 }
 
-/* reverse n items on the stack */
-void reverse(int n)
+void run_profile(int* code, unsigned char* data)
 {
-    item_t temp;
-    int end = stack.top;
-    int start = stack.top - n + 1;
-    while (start < end)
-    {
-        temp = stack.items[start]; /* save the original first elt */
-        stack.items[start] = stack.items[end]; /* move the last elt to the start */
-        stack.items[end] = temp; /* move the original first elt to the end */
-        start++;
-        end--;
+    unsigned int ip = entry_point;
+    slot_t* const limit = stack.limit;
+    slot_t* sp = stack.items;
+    slot_t tos;
+    tos.i = 0;
+    unsigned char* fp = data + dp; /* (the frames start after the globals) */
+    unsigned char* frame_end = fp;
+    unsigned char* const frame_limit = fp + FRAME_AREA_SIZE;
+    CallRecord* csp = call_stack;
+    CallRecord* const call_limit = call_stack + CALL_STACK_SIZE;
+    CHECK_STACK();
+    unsigned char prev = op_halt; /* the op executed before the current one */
+#define CASE(op) case op:
+#define NEXT     break
+    while (1) {
+        unsigned char op = code[ip++];
+        pair_count[prev][op]++;
+        prev = op;
+        switch(op) {
+#include "vm_handlers.h"
+        }
     }
+#undef CASE
+#undef NEXT
 }
 
-void main(int argc, char* argv[])
+/* print the number of ops executed and the pairs of consecutive ops that were executed most often */
+void print_profile(void)
 {
-    if (argc == 1) {
-        sourcefile = "test_input.c";
+    unsigned long total = 0;
+    for (int a = 0; a < NUM_OPS; a++) {
+        for (int b = 0; b < NUM_OPS; b++) {
+            total += pair_count[a][b];
+        }
     }
-    else if (argc == 2) {
-        sourcefile = argv[1];
+    fprintf(stderr, "%lu ops executed; most frequent pairs:\n", total);
+    for (int rank = 0; rank < 20; rank++) {
+        int best_a = 0, best_b = 0;
+        for (int a = 0; a < NUM_OPS; a++) {
+            for (int b = 0; b < NUM_OPS; b++) {
+                if (pair_count[a][b] > pair_count[best_a][best_b]) {
+                    best_a = a;
+                    best_b = b;
+                }
+            }
+        }
+        if (pair_count[best_a][best_b] == 0) {
+            break;
+        }
+        fprintf(stderr, "%10lu %5.1f%%  %s; %s\n", pair_count[best_a][best_b], 100.0 * pair_count[best_a][best_b] / total,
+                op_names[best_a], op_names[best_b]);
+        pair_count[best_a][best_b] = 0;
     }
-    else {
-        fprintf(stderr, "usage: <program> <input file>\n");
-        exit(EXIT_FAILURE);
+}
+
+/* Register access for the register VM: the register whose address is the n-th argument of the op being executed */
+#define REG(n) DATA(ARGN(n).i)
+
+#define JUMP_TO(loc)   ip = (loc)
+#define CALL_TO(loc)   ip = (loc)
+#define RETURN_TO(loc) ip = (loc)
+
+void run_register(int* code, unsigned char* data)
+{
+    unsigned int ip = 0;
+    unsigned int* rsp = return_stack;
+    unsigned int* const rlimit = return_stack + RETURN_STACK_SIZE;
+#define CASE(op) case op:
+#define NEXT     break
+    while (1) {
+        switch(code[ip++]) {
+#include "regvm_handlers.h"
+        }
     }
+#undef CASE
+#undef NEXT
+}
 
-    parse();
-    printf("\n");
-    printf("ip: %i, dp: %i\n\n", ip, dp);
-    data = malloc(dp);
-    if (data == NULL) {
-        printf("malloc() failed for data array\n");
-        exit(EXIT_FAILURE);
+void run_register_profile(int* code, unsigned char* data)
+{
+    unsigned int ip = 0;
+    unsigned int* rsp = return_stack;
+    unsigned int* const rlimit = return_stack + RETURN_STACK_SIZE;
+#define CASE(op) case op:
+#define NEXT     break
+    while (1) {
+        unsigned char op = code[ip++];
+        rop_count[op]++;
+        switch(op) {
+#include "regvm_handlers.h"
+        }
     }
-    ip = 0;
-    dp = 0;
-    stack_init(&stack, 400); /* initialize stack */
-    printf("\n;;;;;;;;;;;;;; BEGINNING OF OUTPUT ;;;;;;;;;;;;;;;;\n");
+#undef CASE
+#undef NEXT
+}
+
+#undef JUMP_TO
+#undef CALL_TO
+#undef RETURN_TO
+
+/* The register VM with the JIT: backedges (jumps backwards) and calls are counted at their targets (so that
+hot procedures get compiled), and any jump, call or return to a compiled op continues in native code */
+#define JUMP_TO(loc)   { ip = (loc); if (ip < op_loc) jit_count(ip); if (jit_native[ip] != NULL) goto native; }
+#define CALL_TO(loc)   { ip = (loc); jit_count(ip); if (jit_native[ip] != NULL) goto native; }
+#define RETURN_TO(loc) { ip = (loc); if (jit_native[ip] != NULL) goto native; }
+
+void run_jit(int* code, unsigned char* data)
+{
+    unsigned int ip = 0;
+    unsigned int op_loc; /* location of the op being executed */
+    unsigned int* rsp = return_stack;
+    unsigned int* const rlimit = return_stack + RETURN_STACK_SIZE;
+#define CASE(op) case op:
+#define NEXT     break
     while (1) {
-/*        printf("--------------- ip: %i -----------\n" , ip);*/
-/*        stack_print(&stack);*/
+        op_loc = ip;
         switch(code[ip++]) {
-            /* op_push is used for both ints (4 bytes) and chars (also 4 bytes) */
-            case op_push: { /* input a 4-byte address and push the integer value in that address to stack */
-                dp = get_int(code+ip); /* get the address of the variable */
-                ip += 4;
-                int val = get_int(data+dp); /* get the value from the data array */
-                /* push the value onto the stack */
-                item_t stack_item;
-                stack_item.i = val;
-                stack_item.type = INT;
-                push(&stack, stack_item);
-                break;
-            }
-            case op_fpush: {
-                dp = get_int(code+ip); /* get the address of the variable */
-                ip += 4;
-                float val = get_float(data+dp); /* get the value from the data array */
-                /* push the value onto the stack */
-                item_t stack_item;
-                stack_item.f = val;
-                stack_item.type = REAL;
-                push(&stack, stack_item);
-                break;
-            }
-            case op_pushi: {
-                int val = get_int(code+ip); /* get the value directly from the code array */
-                ip += 4;
-                /* push the value onto the stack */
-                item_t stack_item;
-                stack_item.i = val;
-                stack_item.type = INT;
-                push(&stack, stack_item);
-                break;
-            }
-            case op_fpushi: {
-                float val = get_float(code+ip);
-                ip += 4;
-                item_t stack_item;
-                stack_item.f = val;
-                stack_item.type = REAL;
-                push(&stack, stack_item);
-                break;
-            }
-            case op_pop: { /* pop <arg> assigns the top value to the address given by <arg> */
-                item_t popped_item = pop(&stack); 
-                dp = get_int(code+ip); /* get the address in which to store the value */
-                ip += 4;
-                store_int(data+dp, popped_item.i); /* store assignment (an integer) */
-                break;
-            }
-            case op_fpop: {
-                item_t popped_item = pop(&stack);
-                dp = get_int(code+ip);
-                ip += 4;
-                store_float(data+dp, popped_item.f); /* store assignment (a float) */
-                break;
-            }
-            case op_exch: {
-                item_t item1 = pop(&stack);
-                item_t item2 = pop(&stack);
-                push(&stack, item1);
-                push(&stack, item2);
-                break;
-            }
-            case op_remove: {
-                pop(&stack);
-                break;
-            }
-            case op_dup: {
-                item_t popped_item = pop(&stack);
-                push(&stack, popped_item);
-                push(&stack, popped_item);
-                break;
-            }
-            case op_add: {
-                item_t item1 = pop(&stack);
-                item_t item2 = pop(&stack);
-                item_t item3;
-                item3.i = item2.i + item1.i;
-                item3.type = INT;
-                push(&stack, item3);
-                break;
-            }
-            case op_fadd: {
-                item_t item1 = pop(&stack);
-                item_t item2 = pop(&stack);
-                item_t item3;
-                item3.f = item2.f + item1.f;
-                item3.type = REAL;
-                push(&stack, item3);
-                break;
-            }
-            case op_sub: {
-                item_t item1 = pop(&stack);
-                item_t item2 = pop(&stack);
-                item_t item3;
-                item3.i = item2.i - item1.i;
-                item3.type = INT;
-                push(&stack, item3);
-                break;
-            }
-            case op_fsub: {
-                item_t item1 = pop(&stack);
-                item_t item2 = pop(&stack);
-                item_t item3;
-                item3.f = item2.f - item1.f;
-                item3.type = REAL;
-                push(&stack, item3);
-                break;
-            }
-            case op_mul: {
-                item_t item1 = pop(&stack);
-                item_t item2 = pop(&stack);
-                item_t item3;
-                item3.i = item2.i * item1.i;
-                item3.type = INT;
-                push(&stack, item3);
-                break;
-            }
-            case op_fmul: {
-                item_t item1 = pop(&stack);
-                item_t item2 = pop(&stack);
-                item_t item3;
-                item3.f = item2.f * item1.f;
-                item3.type = REAL;
-                push(&stack, item3);
-                break;
-            }
-            case op_div: {
-                item_t item1 = pop(&stack);
-                item_t item2 = pop(&stack);
-                item_t item3;
-                /* check for division by zero */
-                if (item1.i == 0) {
-                    printf("Error: division by zero\n");
-                    exit(EXIT_FAILURE);
-                }
-                item3.i = item2.i / item1.i;
-                item3.type = INT;
-                push(&stack, item3);
-                break;
-            }
-            case op_fdiv: {
-                item_t item1 = pop(&stack);
-                item_t item2 = pop(&stack);
-                item_t item3;
-                if (item1.f == 0) {
-                    printf("Error: division by zero\n");
-                    exit(EXIT_FAILURE);
-                }
-                item3.f = item2.f / item1.f;
-                item3.type = REAL;
-                push(&stack, item3);
-                break;
-            }
-            case op_mod: {
-                item_t item1 = pop(&stack);
-                item_t item2 = pop(&stack);
-                item_t item3;
-                item3.i = item2.i % item1.i;
-                item3.type = INT;
-                push(&stack, item3);
-                break;
+#include "regvm_handlers.h"
+        }
+        continue;
+    native:
+        /* native code runs until it reaches an op that isn't compiled (which is then counted like a call) */
+        ip = jit_run(ip, data, &rsp);
+        if (ip == JIT_HALT) {
+            output_flush();
+            return;
+        }
+        jit_count(ip);
+        if (jit_native[ip] != NULL) {
+            goto native;
+        }
+    }
+#undef CASE
+#undef NEXT
+}
+
+#undef JUMP_TO
+#undef CALL_TO
+#undef RETURN_TO
+
+/* print the number of register ops executed and the ops that were executed most often */
+void print_register_profile(void)
+{
+    unsigned long total = 0;
+    for (int op = 0; op < NUM_ROPS; op++) {
+        total += rop_count[op];
+    }
+    fprintf(stderr, "%lu ops executed; most frequent ops:\n", total);
+    for (int rank = 0; rank < 20; rank++) {
+        int best = 0;
+        for (int op = 0; op < NUM_ROPS; op++) {
+            if (rop_count[op] > rop_count[best]) {
+                best = op;
             }
-            case op_neg: {
-                item_t item = pop(&stack);
-                item.i = -item.i;
-                push(&stack, item);
-                break;
+        }
+        if (rop_count[best] == 0) {
+            break;
+        }
+        fprintf(stderr, "%10lu %5.1f%%  %s\n", rop_count[best], 100.0 * rop_count[best] / total, rop_names[best]);
+        rop_count[best] = 0;
+    }
+}
+
+#ifdef __GNUC__
+void run_threaded(int* code, unsigned char* data)
+{
+    /* handler addresses, in the same order as the ops in parser.h */
+    static void* handlers[] = {
+        &&L_op_push, &&L_op_fpush, &&L_op_pushi, &&L_op_fpushi, &&L_op_pop, &&L_op_fpop,
+        &&L_op_neg, &&L_op_fneg, &&L_op_dup, &&L_op_exch, &&L_op_remove,
+        &&L_op_add, &&L_op_fadd, &&L_op_sub, &&L_op_fsub, &&L_op_mul, &&L_op_fmul, &&L_op_div, &&L_op_fdiv, &&L_op_mod, &&L_op_shl,
+        &&L_op_and, &&L_op_or, &&L_op_eq, &&L_op_neq, &&L_op_less, &&L_op_leq, &&L_op_greater, &&L_op_geq,
+        &&L_op_fand, &&L_op_for, &&L_op_feq, &&L_op_fneq, &&L_op_fless, &&L_op_fleq, &&L_op_fgreater, &&L_op_fgeq,
+        &&L_op_iand, &&L_op_ior, &&L_op_ieq, &&L_op_ineq, &&L_op_ilt, &&L_op_ile, &&L_op_igt, &&L_op_ige,
+        &&L_op_conv_to_float, &&L_op_conv_to_int,
+        &&L_op_jmp, &&L_op_jfalse, &&L_op_jtrue,
+        &&L_op_ijfalse, &&L_op_ijtrue,
+        &&L_op_call, &&L_op_return,
+        &&L_op_put, &&L_op_fput, &&L_op_get, &&L_op_fget,
+        &&L_op_printint, &&L_op_printfloat, &&L_op_printchar, &&L_op_println,
+        &&L_op_halt,
+        &&L_op_push_local, &&L_op_pop_local,
+        &&L_op_local_addr,
+        &&L_op_enter,
+        &&L_op_storei,
+        &&L_op_inc,
+        &&L_op_add_var, &&L_op_mul_var,
+        &&L_op_elem_addr, &&L_op_load_elem, &&L_op_fload_elem,
+        &&L_op_jlt, &&L_op_jle, &&L_op_jgt, &&L_op_jge, &&L_op_jeq, &&L_op_jne,
+        &&L_op_jlt_var_imm, &&L_op_jle_var_imm, &&L_op_jgt_var_imm, &&L_op_jge_var_imm,
+        &&L_op_storei_local, &&L_op_inc_local,
+        &&L_op_add_local, &&L_op_mul_local,
+        &&L_op_local_elem_addr, &&L_op_load_local_elem,
+        &&L_op_fload_local_elem,
+        &&L_op_jlt_local_imm, &&L_op_jle_local_imm,
+        &&L_op_jgt_local_imm, &&L_op_jge_local_imm,
+    };
+    _Static_assert(sizeof handlers / sizeof handlers[0] == NUM_OPS, "one handler per op");
+    /* threaded[i] is the handler of the op at code[i]: the code array is translated once (before the first run),
+    so that jump offsets and return addresses stay valid as indices into it */
+    static void** threaded = NULL;
+    if (threaded == NULL) {
+        threaded = malloc(code_size * sizeof (void*));
+        if (threaded == NULL) {
+            printf("malloc() failed for threaded code\n");
+            exit(EXIT_FAILURE);
+        }
+        for (unsigned int i = 0; i < code_size; i += op_size(code[i])) {
+            threaded[i] = handlers[code[i]];
+        }
+    }
+    void** const handler = threaded;
+    unsigned int ip = entry_point;
+    slot_t* const limit = stack.limit;
+    slot_t* sp = stack.items;
+    slot_t tos;
+    tos.i = 0;
+    unsigned char* fp = data + dp; /* (the frames start after the globals) */
+    unsigned char* frame_end = fp;
+    unsigned char* const frame_limit = fp + FRAME_AREA_SIZE;
+    CallRecord* csp = call_stack;
+    CallRecord* const call_limit = call_stack + CALL_STACK_SIZE;
+    CHECK_STACK();
+#define CASE(op) L_##op:
+#define NEXT     goto *handler[ip++]
+    NEXT;
+#include "vm_handlers.h"
+    /* the remaining float ops are never generated by the parser */
+L_op_fand: L_op_for: L_op_feq: L_op_fneq: L_op_fless: L_op_fleq: L_op_fgreater: L_op_fgeq:
+    printf("Error: invalid op %i at %i\n", code[ip-1], ip-1);
+    exit(EXIT_FAILURE);
+#undef CASE
+#undef NEXT
+}
+#endif
+
+/* write the program as a C file (see aot.h), and compile that into an executable if one is given
+(the C file is then <executable>.c, unless it is given too) */
+void compile_ahead_of_time(char* c_file, char* executable)
+{
+    char* path = c_file;
+    if (path == NULL) {
+        path = malloc(strlen(executable) + 3);
+        if (path == NULL) {
+            printf("malloc() failed\n");
+            exit(EXIT_FAILURE);
+        }
+        sprintf(path, "%s.c", executable);
+    }
+    FILE* out = fopen(path, "w");
+    if (out == NULL) {
+        printf("Error: can't write to %s\n", path);
+        exit(EXIT_FAILURE);
+    }
+    emit_c(out);
+    if (fclose(out) != 0) {
+        printf("Error: can't write to %s\n", path);
+        exit(EXIT_FAILURE);
+    }
+    printf("C program written to %s\n", path);
+    if (executable != NULL) {
+        /* with the system's C compiler ($CC, or cc) */
+        char* cc = getenv("CC") != NULL ? getenv("CC") : "cc";
+        char* command = malloc(strlen(cc) + strlen(executable) + strlen(path) + 32);
+        if (command == NULL) {
+            printf("malloc() failed\n");
+            exit(EXIT_FAILURE);
+        }
+        sprintf(command, "%s -O2 -o '%s' '%s'", cc, executable, path);
+        if (system(command) != 0) {
+            printf("Error: %s failed\n", command);
+            exit(EXIT_FAILURE);
+        }
+        printf("executable written to %s\n", executable);
+        free(command);
+    }
+    if (path != c_file) {
+        free(path);
+    }
+}
+
+void usage(void)
+{
+    fprintf(stderr, "usage: <program> [--engine=switch|threaded|register] [--jit] [--jit-threshold=<n>] [--emit-c=<file>] [--aot=<executable>] [--emit-image=<file>] [--run-image=<file>] [--cache=<dir>] [--trace=off|tokens|ir|bytes] [--scan=scalar|sse2|avx2] [--line-buffered] [--repeat=<n>] [--time] [--profile] [--no-super] [--no-peephole] [--stats] <input file>\n");
+    exit(EXIT_FAILURE);
+}
+
+void main(int argc, char* argv[])
+{
+    int engine = ENGINE_SWITCH;
+    int repeat = 1; /* number of times to run the program (for benchmarking) */
+    int timed = 0;  /* report the execution time on stderr? */
+    int profiled = 0; /* count the ops executed? */
+    char* c_file = NULL; /* translate the program into this C file instead of running it? */
+    char* executable = NULL; /* and then compile it into this executable? */
+    char* image_file = NULL; /* write the compiled program to this image instead of running it? */
+    char* run_image = NULL; /* run the program in this image instead of compiling a source file? */
+    char* cache_dir = NULL; /* look up the compiled program in this compile cache (and add it if it isn't there)? */
+    sourcefile = "test_input.c";
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--engine=switch") == 0) {
+            engine = ENGINE_SWITCH;
+        }
+        else if (strcmp(argv[i], "--engine=register") == 0) {
+            engine = ENGINE_REGISTER;
+        }
+        else if (strcmp(argv[i], "--jit") == 0) {
+            if (!jit_available) {
+                fprintf(stderr, "the JIT is not available on this machine\n");
+                exit(EXIT_FAILURE);
             }
-            case op_fneg: {
-                item_t item = pop(&stack);
-                item.f = -item.f;
-                push(&stack, item);
-                break;
+            engine = ENGINE_JIT;
+        }
+        else if (strncmp(argv[i], "--jit-threshold=", 16) == 0) {
+            if (atoi(argv[i] + 16) < 1) {
+                usage();
             }
-            case op_conv_to_float: {
-                item_t item = pop(&stack);
-                if (item.type == INT || item.type == CHAR) {
-                    item.f = item.i;
-                    item.type = REAL;
-                }
-                push(&stack, item);
-                break;
+            jit_threshold = atoi(argv[i] + 16);
+        }
+        else if (strcmp(argv[i], "--engine=threaded") == 0) {
+#ifdef __GNUC__
+            engine = ENGINE_THREADED;
+#else
+            fprintf(stderr, "the threaded engine is not available with this compiler\n");
+            exit(EXIT_FAILURE);
+#endif
+        }
+        else if (strncmp(argv[i], "--repeat=", 9) == 0) {
+            repeat = atoi(argv[i] + 9);
+            if (repeat < 1) {
+                usage();
             }
-            case op_conv_to_int: {
-                item_t item = pop(&stack);
-                if (item.type == REAL) {
-                    item.i = item.f;
-                    item.type = INT;
+        }
+        else if (strncmp(argv[i], "--emit-c=", 9) == 0 && argv[i][9] != '\0') {
+            c_file = argv[i] + 9;
+        }
+        else if (strncmp(argv[i], "--aot=", 6) == 0 && argv[i][6] != '\0') {
+            executable = argv[i] + 6;
+        }
+        else if (strncmp(argv[i], "--emit-image=", 13) == 0 && argv[i][13] != '\0') {
+            image_file = argv[i] + 13;
+        }
+        else if (strncmp(argv[i], "--run-image=", 12) == 0 && argv[i][12] != '\0') {
+            run_image = argv[i] + 12;
+        }
+        else if (strncmp(argv[i], "--cache=", 8) == 0 && argv[i][8] != '\0') {
+            cache_dir = argv[i] + 8;
+        }
+        else if (strncmp(argv[i], "--trace=", 8) == 0) {
+            const char* levels[] = { "off", "tokens", "ir", "bytes" };
+            trace_level = -1;
+            for (int level = TRACE_OFF; level <= TRACE_BYTES; level++) {
+                if (strcmp(argv[i] + 8, levels[level]) == 0) {
+                    trace_level = level;
                 }
-                push(&stack, item);
-                break;
             }
-            case op_jmp: {
-                /* current ip: one past the actual jmp instruction */
-                int start = ip-1;
-                int offset = get_int(code+ip);  //printf("jmp offset: %i\n", offset);
-                ip += offset-1;
-                break;
+            if (trace_level < 0) {
+                usage();
             }
-            case op_jtrue: {
-                /* current ip: one past the actual jmp instruction */
-                int start = ip-1;
-                int offset = get_int(code+ip); //printf("jtrue offset: %i\n", offset);
-                /* an item is on the stack that needs to be evaluated */
-                item_t item = pop(&stack);
-                if (item.f) {
-                    ip += offset-1; 
-                }
-                else {
-                    ip += 4;
-                }
-                break;
-            }
-            case op_jfalse: {
-                /* current ip: one past the actual jmp instruction */
-                int start = ip-1;
-                int offset = get_int(code+ip); //printf("jfalse offset: %i\n", offset);
-                /* an item is on the stack that needs to be evaluated */
-                item_t item = pop(&stack);
-                if (!item.f) {
-                    ip += offset-1; 
-                }
-                else {
-                    ip += 4;
+        }
+        else if (strncmp(argv[i], "--scan=", 7) == 0) {
+            lex_max_isa = -1;
+            for (int isa = LEX_SCALAR; isa <= LEX_AVX2; isa++) {
+                if (strcmp(argv[i] + 7, lex_isa_names[isa]) == 0) {
+                    lex_max_isa = isa;
                 }
-                break;
-            }
-            case op_and: {
-                item_t item1 = pop(&stack);
-                item_t item2 = pop(&stack);
-                item_t item3;
-                item3.i = item2.f && item1.f;
-                item3.type = INT;
-                push(&stack, item3);
-                break;
-            }
-            case op_or: {
-                item_t item1 = pop(&stack);
-                item_t item2 = pop(&stack);
-                item_t item3;
-                item3.i = item2.f || item1.f;
-                item3.type = INT;
-                push(&stack, item3);
-                break;
-            }
-            case op_eq: {
-                item_t item1 = pop(&stack);
-                item_t item2 = pop(&stack);
-                item_t item3;
-                item3.i = item2.f == item1.f;
-                item3.type = INT;
-                push(&stack, item3);
-                break;
-            }
-            case op_neq: {
-                item_t item1 = pop(&stack);
-                item_t item2 = pop(&stack);
-                item_t item3;
-                item3.i = item2.f != item1.f;
-                item3.type = INT;
-                push(&stack, item3);
-                break;
-            }
-            case op_less: {
-                item_t item1 = pop(&stack);
-                item_t item2 = pop(&stack);
-                item_t item3;
-                item3.i = item2.f < item1.f;
-                item3.type = INT;
-                push(&stack, item3);
-                break;
-            }
-            case op_leq: {
-                item_t item1 = pop(&stack);
-                item_t item2 = pop(&stack);
-                item_t item3;
-                item3.i = item2.f <= item1.f;
-                item3.type = INT;
-                push(&stack, item3);
-                break;
-            }
-            case op_greater: {
-                item_t item1 = pop(&stack);
-                item_t item2 = pop(&stack);
-                item_t item3;
-                item3.i = item2.f > item1.f;
-                item3.type = INT;
-                push(&stack, item3);
-                break;
-            }
-            case op_geq: {
-                item_t item1 = pop(&stack);
-                item_t item2 = pop(&stack);
-                item_t item3;
-                item3.i = item2.f >= item1.f;
-                item3.type = INT;
-                push(&stack, item3);
-                break;
-            }
-            case op_printint: {
-                item_t popped_item = pop(&stack);
-                printf("%i", popped_item.i);
-                break;
             }
-            case op_printfloat: {
-                item_t popped_item = pop(&stack);
-                printf("%f", popped_item.f);
-                break;
+            if (lex_max_isa < 0) {
+                usage();
             }
-            case op_printchar: {
-                item_t popped_item = pop(&stack);
-                printf("%c", popped_item.i);
-                break;
-            }
-            case op_println: {
+        }
+        else if (strcmp(argv[i], "--line-buffered") == 0) {
+            output_line_buffered = 1;
+        }
+        else if (strcmp(argv[i], "--time") == 0) {
+            timed = 1;
+        }
+        else if (strcmp(argv[i], "--profile") == 0) {
+            profiled = 1;
+        }
+        else if (strcmp(argv[i], "--no-super") == 0) {
+            use_superinstructions = 0;
+        }
+        else if (strcmp(argv[i], "--no-peephole") == 0) {
+            use_peephole = 0;
+        }
+        else if (strcmp(argv[i], "--stats") == 0) {
+            print_stats = 1;
+        }
+        else if (argv[i][0] == '-' && argv[i][1] == '-') {
+            usage();
+        }
+        else {
+            sourcefile = argv[i];
+        }
+    }
+
+    if (profiled) {
+        engine = engine == ENGINE_REGISTER || engine == ENGINE_JIT ? ENGINE_REGISTER_PROFILE : ENGINE_PROFILE;
+    }
+
+    int from_image = 0; /* is the code in an image (rather than compiled from the source)? */
+    if (run_image != NULL) {
+        /* no tokenizer, parser or symbol table: the code is already compiled */
+        load_image(run_image);
+        code_size = ip;
+        from_image = 1;
+    }
+    else if (cache_dir != NULL && image_file == NULL && c_file == NULL && executable == NULL) {
+        read_file(sourcefile);
+        unsigned long long key = cache_key();
+        from_image = cache_lookup(cache_dir, key);
+        if (!from_image) {
+            parse();
+            if (TRACE(TRACE_BYTES)) {
                 printf("\n");
-                break;
-            }
-            case op_reverse: { /* reverse top n items on stack */
-                int n = get_int(code+ip);
-                ip += 4;
-                reverse(n);
-                break;
-            }
-            case op_call: { /* takes one arg: the procedure address */
-                /* get instruction to top of procedure instructions */
-                int proc_ip = get_int(code+ip);
-                ip += 4;
-/*                item_t return_addr;*/
-/*                return_addr.i = ip;*/
-/*                push(&stack, return_addr);*/
-                /* start executing the procedure */
-                ip = proc_ip; 
-                break;
+                printf("ip: %i, dp: %i\n\n", ip, dp);
             }
-            case op_return: { /* takes one arg: the return address */
-                /* pop the return addr from stack */ 
-                item_t return_addr = pop(&stack);
-                ip = return_addr.i;
-                break;
-            }
-            case op_put: { /* pop a value and addr from stack; assign a value to the array elt at the addr */
-                item_t assignval = pop(&stack);
-                item_t addr = pop(&stack);
-                store_int(data + addr.i, assignval.i);
-                break;
-            }
-            case op_fput: {
-                item_t assignval = pop(&stack);
-                item_t addr = pop(&stack);
-                store_float(data + addr.i, assignval.f);
-                break;
-            }
-            case op_get: { /* pop an array elt's addr from stack and leave its value */
-                item_t popped = pop(&stack);
-                item_t val;
-                val.i = get_int(data+popped.i);
-                val.type = INT;
-                push(&stack, val);
-                break;
-            }
-            case op_fget: {
-                item_t popped = pop(&stack);
-                item_t val;
-                val.f = get_float(data+popped.i);
-                val.type = REAL;
-                push(&stack, val);
-                break;
+            cache_store(cache_dir, key);
+        }
+        code_size = ip;
+        if (print_stats) {
+            fprintf(stderr, "cache: %s for %s (key %016llx)\n", from_image ? "hit" : "miss", sourcefile, key);
+            cache_print_stats(cache_dir);
+        }
+    }
+    else {
+        parse();
+        code_size = ip;
+        if (TRACE(TRACE_BYTES)) {
+            printf("\n");
+            printf("ip: %i, dp: %i\n\n", ip, dp);
+        }
+        if (image_file != NULL) {
+            if (!write_image(image_file, 0)) {
+                printf("Error: can't write to %s\n", image_file);
+                exit(EXIT_FAILURE);
             }
-            case op_halt:
-                printf(";;;;;;;;;;;;;;;;; END OF OUTPUT ;;;;;;;;;;;;;;;;;;;\n");
-                exit(0);
+            printf("image written to %s\n", image_file);
+            exit(0);
+        }
+        if (c_file != NULL || executable != NULL) {
+            compile_ahead_of_time(c_file, executable);
+            exit(0);
+        }
+    }
+    int register_vm = engine == ENGINE_REGISTER || engine == ENGINE_REGISTER_PROFILE || engine == ENGINE_JIT;
+    /* the part of the data array that starts out with values of its own (the frames of the stack VM are cleared by enter) */
+    size_t initial_size = register_vm ? reg_data_size : dp;
+    /* variables start out as 0 (the memory freed by the compiler may be reused) */
+    data = calloc(register_vm ? reg_data_size : dp + FRAME_AREA_SIZE, 1);
+    if (data == NULL) {
+        printf("calloc() failed for data array\n");
+        exit(EXIT_FAILURE);
+    }
+    if (image_data != NULL) {
+        memcpy(data, image_data, initial_size);
+    }
+    else if (register_vm) {
+        if (TRACE(TRACE_BYTES)) {
+            printf("register code: %i words, register file: %i bytes\n\n", reg_code_size, reg_data_size);
+        }
+        reg_init_data(data);
+    }
+    /* each run of --repeat starts from the same data as the first one (a copy of it, taken before it's changed) */
+    unsigned char* initial_data = NULL;
+    if (repeat > 1) {
+        initial_data = malloc(initial_size + 1);
+        if (initial_data == NULL) {
+            printf("malloc() failed\n");
+            exit(EXIT_FAILURE);
         }
+        memcpy(initial_data, data, initial_size);
+    }
+    if (engine == ENGINE_JIT) {
+        jit_init(return_stack + RETURN_STACK_SIZE);
+    }
+    stack_init(&stack, 400); /* initialize stack */
+    /* (with --trace=off, the output of the program is all there is) */
+    if (TRACE(TRACE_TOKENS)) {
+        printf("\n;;;;;;;;;;;;;; BEGINNING OF OUTPUT ;;;;;;;;;;;;;;;;\n");
+    }
+#if defined(__unix__) || defined(__APPLE__)
+    if (isatty(STDOUT_FILENO)) {
+        output_line_buffered = 1; /* (someone is watching) */
+    }
+#endif
+    output_init();
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (int run = 0; run < repeat; run++) {
+        if (run > 0) {
+            memcpy(data, initial_data, initial_size);
+            save_stack_used = 0;
+        }
+        if (engine == ENGINE_SWITCH) {
+            run_switch(code, data);
+        }
+        else if (engine == ENGINE_PROFILE) {
+            run_profile(code, data);
+        }
+        else if (engine == ENGINE_REGISTER) {
+            run_register(reg_code, data);
+        }
+        else if (engine == ENGINE_REGISTER_PROFILE) {
+            run_register_profile(reg_code, data);
+        }
+        else if (engine == ENGINE_JIT) {
+            run_jit(reg_code, data);
+        }
+#ifdef __GNUC__
+        else {
+            run_threaded(code, data);
+        }
+#endif
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    if (TRACE(TRACE_TOKENS)) {
+        printf(";;;;;;;;;;;;;;;;; END OF OUTPUT ;;;;;;;;;;;;;;;;;;;\n");
+    }
+    if (timed) {
+        double ms = (t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) / 1e6;
+        fprintf(stderr, "%s engine: %i run(s) in %.3f ms (%.3f us per run)\n",
+                engine == ENGINE_THREADED ? "threaded" : engine == ENGINE_REGISTER ? "register" : engine == ENGINE_JIT ? "jit" : "switch", repeat, ms, ms * 1e3 / repeat);
+    }
+    if (engine == ENGINE_PROFILE) {
+        print_profile();
+    }
+    else if (engine == ENGINE_REGISTER_PROFILE) {
+        print_register_profile();
+    }
+    if (engine == ENGINE_JIT) {
+        if (print_stats) {
+            jit_print_stats();
+        }
+        jit_free();
     }
 
-    free(code);
+    if (from_image) {
+        unload_image();
+    }
+    else {
+        free(code);
+        free(reg_code);
+    }
     free(data);
+    free(initial_data);
     stack_free(&stack);
+    exit(0);
 }
-
@@ -0,0 +1,596 @@
+/*
+Instruction handlers of the virtual machine.
+
+This file is not a regular header: it is included (twice) by vm.c, once inside the switch-based
+interpreter loop and once inside the direct-threaded one, so that every op is only written once.
+The including function defines
+    CASE(op)  the entry point of the handler for op
+    NEXT      continue with the instruction at code[ip]
+and the operand stack registers tos (the top item) and sp (pointer to the item below it),
+the frame registers fp (the frame of the running procedure, see codegen.h), frame_end and frame_limit,
+and the return stack registers csp (pointer to the next free record) and call_limit,
+and keeps ip pointing one past the op being executed (i.e., at its argument, if it has one).
+*/
+
+/* op_push is used for both ints (4 bytes) and chars (also 4 bytes) */
+CASE(op_push) { /* input a 4-byte address and push the integer value in that address to stack */
+    int addr = ARG.i; /* get the address of the variable */
+    ip++;
+    PUSH();
+    tos.i = DATA(addr).i; /* get the value from the data array */
+    NEXT;
+}
+CASE(op_fpush) {
+    int addr = ARG.i;
+    ip++;
+    PUSH();
+    tos.f = DATA(addr).f;
+    NEXT;
+}
+CASE(op_pushi) {
+    PUSH();
+    tos.i = ARG.i; /* get the value directly from the code array */
+    ip++;
+    NEXT;
+}
+CASE(op_fpushi) {
+    PUSH();
+    tos.f = ARG.f;
+    ip++;
+    NEXT;
+}
+CASE(op_pop) { /* pop <arg> assigns the top value to the address given by <arg> */
+    int addr = ARG.i; /* get the address in which to store the value */
+    ip++;
+    DATA(addr).i = tos.i; /* store assignment (an integer) */
+    DROP();
+    NEXT;
+}
+CASE(op_fpop) {
+    int addr = ARG.i;
+    ip++;
+    DATA(addr).f = tos.f; /* store assignment (a float) */
+    DROP();
+    NEXT;
+}
+CASE(op_exch) {
+    slot_t item = tos;
+    tos = *sp;
+    *sp = item;
+    NEXT;
+}
+CASE(op_remove) {
+    DROP();
+    NEXT;
+}
+CASE(op_dup) {
+    PUSH(); /* tos stays the same */
+    NEXT;
+}
+CASE(op_add) {
+    tos.i = (*sp--).i + tos.i;
+    NEXT;
+}
+CASE(op_fadd) {
+    tos.f = (*sp--).f + tos.f;
+    NEXT;
+}
+CASE(op_sub) {
+    tos.i = (*sp--).i - tos.i;
+    NEXT;
+}
+CASE(op_fsub) {
+    tos.f = (*sp--).f - tos.f;
+    NEXT;
+}
+CASE(op_mul) {
+    tos.i = (*sp--).i * tos.i;
+    NEXT;
+}
+CASE(op_fmul) {
+    tos.f = (*sp--).f * tos.f;
+    NEXT;
+}
+CASE(op_div) {
+    /* check for division by zero */
+    if (tos.i == 0) {
+        printf("Error: division by zero\n");
+        exit(EXIT_FAILURE);
+    }
+    tos.i = (*sp--).i / tos.i;
+    NEXT;
+}
+CASE(op_fdiv) {
+    if (tos.f == 0) {
+        printf("Error: division by zero\n");
+        exit(EXIT_FAILURE);
+    }
+    tos.f = (*sp--).f / tos.f;
+    NEXT;
+}
+CASE(op_mod) {
+    tos.i = (*sp--).i % tos.i;
+    NEXT;
+}
+CASE(op_shl) { /* shift left (generated for multiplying by a power of 2, so it wraps around the same way) */
+    tos.i = (int) ((unsigned int) (*sp--).i << tos.i);
+    NEXT;
+}
+CASE(op_neg) {
+    tos.i = -tos.i;
+    NEXT;
+}
+CASE(op_fneg) {
+    tos.f = -tos.f;
+    NEXT;
+}
+CASE(op_conv_to_float) {
+    tos.f = tos.i;
+    NEXT;
+}
+CASE(op_conv_to_int) {
+    tos.i = tos.f;
+    NEXT;
+}
+CASE(op_jmp) {
+    /* current ip: one past the actual jmp instruction */
+    ip += ARG.i - 1;
+    CHECK_STACK();
+    NEXT;
+}
+CASE(op_jtrue) {
+    /* current ip: one past the actual jmp instruction */
+    int offset = ARG.i;
+    /* the item on top of the stack is the condition */
+    if (tos.f) {
+        ip += offset-1;
+    }
+    else {
+        ip++;
+    }
+    DROP();
+    CHECK_STACK();
+    NEXT;
+}
+CASE(op_jfalse) {
+    /* current ip: one past the actual jmp instruction */
+    int offset = ARG.i;
+    /* the item on top of the stack is the condition */
+    if (!tos.f) {
+        ip += offset-1;
+    }
+    else {
+        ip++;
+    }
+    DROP();
+    CHECK_STACK();
+    NEXT;
+}
+CASE(op_ijtrue) { /* same as jtrue, but the condition is an int */
+    int offset = ARG.i;
+    if (tos.i) {
+        ip += offset-1;
+    }
+    else {
+        ip++;
+    }
+    DROP();
+    CHECK_STACK();
+    NEXT;
+}
+CASE(op_ijfalse) {
+    int offset = ARG.i;
+    if (!tos.i) {
+        ip += offset-1;
+    }
+    else {
+        ip++;
+    }
+    DROP();
+    CHECK_STACK();
+    NEXT;
+}
+CASE(op_and) {
+    tos.i = (*sp--).f && tos.f;
+    NEXT;
+}
+CASE(op_or) {
+    tos.i = (*sp--).f || tos.f;
+    NEXT;
+}
+CASE(op_eq) {
+    tos.i = (*sp--).f == tos.f;
+    NEXT;
+}
+CASE(op_neq) {
+    tos.i = (*sp--).f != tos.f;
+    NEXT;
+}
+CASE(op_less) {
+    tos.i = (*sp--).f < tos.f;
+    NEXT;
+}
+CASE(op_leq) {
+    tos.i = (*sp--).f <= tos.f;
+    NEXT;
+}
+CASE(op_greater) {
+    tos.i = (*sp--).f > tos.f;
+    NEXT;
+}
+CASE(op_geq) {
+    tos.i = (*sp--).f >= tos.f;
+    NEXT;
+}
+/* comparisons of two ints */
+CASE(op_iand) {
+    tos.i = (*sp--).i && tos.i;
+    NEXT;
+}
+CASE(op_ior) {
+    tos.i = (*sp--).i || tos.i;
+    NEXT;
+}
+CASE(op_ieq) {
+    tos.i = (*sp--).i == tos.i;
+    NEXT;
+}
+CASE(op_ineq) {
+    tos.i = (*sp--).i != tos.i;
+    NEXT;
+}
+CASE(op_ilt) {
+    tos.i = (*sp--).i < tos.i;
+    NEXT;
+}
+CASE(op_ile) {
+    tos.i = (*sp--).i <= tos.i;
+    NEXT;
+}
+CASE(op_igt) {
+    tos.i = (*sp--).i > tos.i;
+    NEXT;
+}
+CASE(op_ige) {
+    tos.i = (*sp--).i >= tos.i;
+    NEXT;
+}
+CASE(op_printint) {
+    output_int(tos.i);
+    DROP();
+    NEXT;
+}
+CASE(op_printfloat) {
+    output_float(tos.f);
+    DROP();
+    NEXT;
+}
+CASE(op_printchar) {
+    OUTPUT_CHAR(tos.i);
+    DROP();
+    NEXT;
+}
+CASE(op_println) {
+    output_newline();
+    NEXT;
+}
+CASE(op_call) { /* args: the procedure address, the number of args (on top of the stack, the last one on top) */
+    int n = ARGN(1).i;
+    if (csp == call_limit) {
+        too_many_calls(CALL_STACK_SIZE);
+    }
+    if (4 * n > frame_limit - frame_end) {
+        frames_too_large(FRAME_AREA_SIZE);
+    }
+    /* push the return address and the frame of the caller onto the return stack */
+    csp->ret = ip + 2;
+    csp->fp = fp;
+    csp++;
+    /* the args become the first slots of a new frame, after the current one */
+    fp = frame_end;
+    if (n > 0) {
+        PUSH(); /* (the args must all be in memory) */
+        memcpy(fp, sp - n + 1, 4 * n);
+        sp -= n;
+        DROP();
+    }
+    frame_end = fp + 4 * n;
+    /* start executing the procedure */
+    ip = ARGN(0).i;
+    CHECK_STACK();
+    NEXT;
+}
+CASE(op_return) { /* pop the return address and the frame of the caller (the frame that ends is dropped) */
+    csp--;
+    ip = csp->ret;
+    frame_end = fp;
+    fp = csp->fp;
+    CHECK_STACK();
+    NEXT;
+}
+CASE(op_put) { /* pop a value and addr from stack; assign a value to the array elt at the addr */
+    DATA((*sp--).i).i = tos.i;
+    DROP();
+    NEXT;
+}
+CASE(op_fput) {
+    DATA((*sp--).i).f = tos.f;
+    DROP();
+    NEXT;
+}
+CASE(op_get) { /* replace an array elt's addr on top of the stack with its value */
+    tos.i = DATA(tos.i).i;
+    NEXT;
+}
+CASE(op_fget) {
+    tos.f = DATA(tos.i).f;
+    NEXT;
+}
+CASE(op_halt) {
+    output_flush();
+    return;
+}
+CASE(op_push_local) { /* push the value of the variable at an offset in the frame (the arg) */
+    int offset = ARG.i;
+    ip++;
+    PUSH();
+    tos = LOCAL(offset);
+    NEXT;
+}
+CASE(op_pop_local) {
+    int offset = ARG.i;
+    ip++;
+    LOCAL(offset) = tos;
+    DROP();
+    NEXT;
+}
+CASE(op_local_addr) { /* push the address of an offset in the frame (e.g., of a local array) */
+    PUSH();
+    tos.i = (int) (fp - data) + ARG.i;
+    ip++;
+    NEXT;
+}
+CASE(op_enter) { /* make the frame a given size (the arg): the call has put the args in it, the locals come after them */
+    int size = ARG.i;
+    ip++;
+    if (size > frame_limit - fp) {
+        frames_too_large(FRAME_AREA_SIZE);
+    }
+    memset(frame_end, 0, fp + size - frame_end); /* (locals start out as 0) */
+    frame_end = fp + size;
+    NEXT;
+}
+
+/* superinstructions */
+CASE(op_storei) { /* store a constant (the second arg) at an address (the first arg) */
+    DATA(ARGN(0).i) = ARGN(1);
+    ip += 2;
+    NEXT;
+}
+CASE(op_inc) { /* add a constant (the second arg) to the integer at an address (the first arg) */
+    DATA(ARGN(0).i).i += ARGN(1).i;
+    ip += 2;
+    NEXT;
+}
+CASE(op_add_var) { /* add the integer at an address to the top of the stack */
+    tos.i += DATA(ARG.i).i;
+    ip++;
+    NEXT;
+}
+CASE(op_mul_var) {
+    tos.i *= DATA(ARG.i).i;
+    ip++;
+    NEXT;
+}
+CASE(op_elem_addr) { /* replace the index on top of the stack with the address of the array elt (args: base addr, elt size) */
+    tos.i = ARGN(0).i + tos.i * ARGN(1).i;
+    ip += 2;
+    NEXT;
+}
+CASE(op_load_elem) { /* replace the index on top of the stack with the value of the array elt (args: base addr, elt size) */
+    tos.i = DATA(ARGN(0).i + tos.i * ARGN(1).i).i;
+    ip += 2;
+    NEXT;
+}
+CASE(op_fload_elem) {
+    tos.f = DATA(ARGN(0).i + tos.i * ARGN(1).i).f;
+    ip += 2;
+    NEXT;
+}
+/* compare the two ints on top of the stack (and remove them), and jump by the arg if the relation holds */
+CASE(op_jlt) {
+    int second = (*sp--).i;
+    int cond = second < tos.i;
+    DROP();
+    if (cond) {
+        ip += ARG.i - 1;
+    }
+    else {
+        ip++;
+    }
+    CHECK_STACK();
+    NEXT;
+}
+CASE(op_jle) {
+    int second = (*sp--).i;
+    int cond = second <= tos.i;
+    DROP();
+    if (cond) {
+        ip += ARG.i - 1;
+    }
+    else {
+        ip++;
+    }
+    CHECK_STACK();
+    NEXT;
+}
+CASE(op_jgt) {
+    int second = (*sp--).i;
+    int cond = second > tos.i;
+    DROP();
+    if (cond) {
+        ip += ARG.i - 1;
+    }
+    else {
+        ip++;
+    }
+    CHECK_STACK();
+    NEXT;
+}
+CASE(op_jge) {
+    int second = (*sp--).i;
+    int cond = second >= tos.i;
+    DROP();
+    if (cond) {
+        ip += ARG.i - 1;
+    }
+    else {
+        ip++;
+    }
+    CHECK_STACK();
+    NEXT;
+}
+CASE(op_jeq) {
+    int second = (*sp--).i;
+    int cond = second == tos.i;
+    DROP();
+    if (cond) {
+        ip += ARG.i - 1;
+    }
+    else {
+        ip++;
+    }
+    CHECK_STACK();
+    NEXT;
+}
+CASE(op_jne) {
+    int second = (*sp--).i;
+    int cond = second != tos.i;
+    DROP();
+    if (cond) {
+        ip += ARG.i - 1;
+    }
+    else {
+        ip++;
+    }
+    CHECK_STACK();
+    NEXT;
+}
+/* the superinstructions of locals: the same, at an offset in the frame */
+CASE(op_storei_local) {
+    LOCAL(ARGN(0).i) = ARGN(1);
+    ip += 2;
+    NEXT;
+}
+CASE(op_inc_local) {
+    LOCAL(ARGN(0).i).i += ARGN(1).i;
+    ip += 2;
+    NEXT;
+}
+CASE(op_add_local) {
+    tos.i += LOCAL(ARG.i).i;
+    ip++;
+    NEXT;
+}
+CASE(op_mul_local) {
+    tos.i *= LOCAL(ARG.i).i;
+    ip++;
+    NEXT;
+}
+CASE(op_local_elem_addr) {
+    tos.i = (int) (fp - data) + ARGN(0).i + tos.i * ARGN(1).i;
+    ip += 2;
+    NEXT;
+}
+CASE(op_load_local_elem) {
+    tos.i = LOCAL(ARGN(0).i + tos.i * ARGN(1).i).i;
+    ip += 2;
+    NEXT;
+}
+CASE(op_fload_local_elem) {
+    tos.f = LOCAL(ARGN(0).i + tos.i * ARGN(1).i).f;
+    ip += 2;
+    NEXT;
+}
+CASE(op_jlt_local_imm) {
+    if (LOCAL(ARGN(0).i).i < ARGN(1).i) {
+        ip += ARGN(2).i - 1;
+    }
+    else {
+        ip += 3;
+    }
+    CHECK_STACK();
+    NEXT;
+}
+CASE(op_jle_local_imm) {
+    if (LOCAL(ARGN(0).i).i <= ARGN(1).i) {
+        ip += ARGN(2).i - 1;
+    }
+    else {
+        ip += 3;
+    }
+    CHECK_STACK();
+    NEXT;
+}
+CASE(op_jgt_local_imm) {
+    if (LOCAL(ARGN(0).i).i > ARGN(1).i) {
+        ip += ARGN(2).i - 1;
+    }
+    else {
+        ip += 3;
+    }
+    CHECK_STACK();
+    NEXT;
+}
+CASE(op_jge_local_imm) {
+    if (LOCAL(ARGN(0).i).i >= ARGN(1).i) {
+        ip += ARGN(2).i - 1;
+    }
+    else {
+        ip += 3;
+    }
+    CHECK_STACK();
+    NEXT;
+}
+/* compare the int at an address (the first arg) to a constant (the second arg), and jump by the third arg if
+the relation holds */
+CASE(op_jlt_var_imm) {
+    if (DATA(ARGN(0).i).i < ARGN(1).i) {
+        ip += ARGN(2).i - 1;
+    }
+    else {
+        ip += 3;
+    }
+    CHECK_STACK();
+    NEXT;
+}
+CASE(op_jle_var_imm) {
+    if (DATA(ARGN(0).i).i <= ARGN(1).i) {
+        ip += ARGN(2).i - 1;
+    }
+    else {
+        ip += 3;
+    }
+    CHECK_STACK();
+    NEXT;
+}
+CASE(op_jgt_var_imm) {
+    if (DATA(ARGN(0).i).i > ARGN(1).i) {
+        ip += ARGN(2).i - 1;
+    }
+    else {
+        ip += 3;
+    }
+    CHECK_STACK();
+    NEXT;
+}
+CASE(op_jge_var_imm) {
+    if (DATA(ARGN(0).i).i >= ARGN(1).i) {
+        ip += ARGN(2).i - 1;
+    }
+    else {
+        ip += 3;
+    }
+    CHECK_STACK();
+    NEXT;
+}